@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# Test observer relays under load: run a dedicated server and two
+# relays chained behind it over loopback, then have the load generator
+# play a game on the server while drones watch it through the relays.
+#
+# usage: loadtest-relay.sh [-drones n] [-droprate n] [-duration n]
+#                          server-binary loadgen-binary
+#
+# The drones are shared out between the two relays (40 by default, so
+# 20 on each).  With -droprate, the load generator drops that
+# percentage of the packets it sends and receives (10 by default);
+# the links between the server and the relays are not lossy.  The
+# test fails if any drone sees a tic that differs from what the players
+# got, if a drone fails to connect or is disconnected, or if a drone
+# misses more than the last second of the game, which can be lost as
+# everyone leaves at the end.  The servers use ports $PORT to $PORT+2
+# (12340 by default).
+#
+
+usage() {
+	echo "usage: $0 [-drones n] [-droprate n] [-duration n]" \
+	     "server-binary loadgen-binary" >&2
+	exit 2
+}
+
+drones=40
+droprate=10
+duration=30
+port="${PORT:-12340}"
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-drones)   [ $# -ge 2 ] || usage; drones="$2"; shift 2 ;;
+	-droprate) [ $# -ge 2 ] || usage; droprate="$2"; shift 2 ;;
+	-duration) [ $# -ge 2 ] || usage; duration="$2"; shift 2 ;;
+	-*)        usage ;;
+	*)         break ;;
+	esac
+done
+
+[ $# -eq 2 ] || usage
+
+server="$1"
+loadgen="$2"
+
+logdir="$(mktemp -d "${TMPDIR:-/tmp}/loadtest-relay.XXXXXX")" || exit 1
+log="$logdir/loadgen.log"
+pids=
+
+trap 'kill $pids 2>/dev/null' EXIT INT TERM
+
+"$server" -privateserver -port "$port" > "$logdir/server.log" 2>&1 &
+pids="$pids $!"
+"$server" -relay "127.0.0.1:$port" -port "$((port + 1))" \
+	> "$logdir/relay1.log" 2>&1 &
+pids="$pids $!"
+"$server" -relay "127.0.0.1:$((port + 1))" -port "$((port + 2))" \
+	> "$logdir/relay2.log" 2>&1 &
+pids="$pids $!"
+
+# Give the servers a moment to open their ports.
+sleep 1
+
+"$loadgen" -connect "127.0.0.1:$port" -clients 1 -players 1 \
+           -drones "$drones" -droprate "$droprate" -duration "$duration" \
+           -relay "127.0.0.1:$((port + 1))" -relay "127.0.0.1:$((port + 2))" \
+	2>&1 | tee "$log"
+
+# "40 drones received 452-465 tics each, of the first game's 465"
+received="$(sed -n 's/.* received \([0-9]*\)-.* game.s \([0-9]*\)$/\1 \2/p' \
+            "$log")"
+set -- $received
+
+if [ $# -eq 2 ] && [ "$1" -gt 0 ] && [ "$1" -ge "$(($2 - 35))" ] \
+   && grep -q -e '^0 tics of the first game differed' "$log" \
+   && grep -q -e "^$((drones + 1)) connected, 0 rejected, 0 dropped" "$log"
+then
+	echo "OK; logs in $logdir"
+	exit 0
+fi
+
+echo "FAIL; logs in $logdir"
+exit 1
@@ -16,6 +16,8 @@
 //     Main loop code.
 //
 
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -117,24 +119,72 @@ static boolean local_playeringame[NET_MAXPLAYERS];
 
 static int player_class;
 
+// Busy-wait for this many microseconds before each tic, rather than
+// sleeping (-spinwait).
 
-// 35 fps clock adjusted by offsetms milliseconds
+static unsigned int spin_wait_us = 0;
 
-static int GetAdjustedTime(void)
+// Frame pacing statistics (-pacingstats): how late we woke up when
+// sleeping until a tic was due, and how far apart in time the tics
+// were run.
+
+#define PACING_LATE_BUCKETS 8
+
+static const unsigned int pacing_late_limits[PACING_LATE_BUCKETS - 1] =
 {
-    int time_ms;
+    50, 100, 250, 500, 1000, 2000, 5000,
+};
+
+static boolean pacing_stats = false;
+static unsigned int pacing_waits;
+static uint64_t pacing_late_total;
+static uint64_t pacing_late_max;
+static unsigned int pacing_late_hist[PACING_LATE_BUCKETS];
+
+static uint64_t pacing_last_tic;
+static unsigned int pacing_intervals;
+static double pacing_interval_total;
+static double pacing_interval_squares;
+static uint64_t pacing_interval_min;
+static uint64_t pacing_interval_max;
+
 
-    time_ms = I_GetTimeMS();
+// Offset to the timer for game sync, in microseconds
 
+static int64_t GetTimeOffsetUS(void)
+{
     if (new_sync)
     {
 	// Use the adjustments from net_client.c only if we are
 	// using the new sync mode.
 
-        time_ms += (offsetms / FRACUNIT);
+        return ((int64_t) offsetms * 1000) / FRACUNIT;
     }
 
-    return (time_ms * TICRATE) / 1000;
+    return 0;
+}
+
+// 35 fps clock adjusted by offsetms milliseconds
+
+static int GetAdjustedTime(void)
+{
+    int64_t time_us;
+
+    time_us = (int64_t) I_GetTimeUS() + GetTimeOffsetUS();
+
+    return (time_us * TICRATE) / 1000000;
+}
+
+// Time from I_GetTimeUS at which GetAdjustedTime reaches the given tic
+
+static uint64_t GetAdjustedTicTimeUS(int tic)
+{
+    int64_t time_us;
+
+    time_us = ((int64_t) tic * 1000000 + TICRATE - 1) / TICRATE
+            - GetTimeOffsetUS();
+
+    return time_us > 0 ? time_us : 0;
 }
 
 static boolean BuildNewTic(void)
@@ -246,6 +296,132 @@ void NetUpdate (void)
     }
 }
 
+// Sleep until the next tic is due to be built.  In a netgame, tics
+// can also arrive from the server at any time, so do not sleep for
+// longer than a millisecond.
+
+static void WaitForNextTic(void)
+{
+    uint64_t deadline;
+    uint64_t now;
+    uint64_t late;
+    boolean capped;
+    int i;
+
+    deadline = GetAdjustedTicTimeUS((lasttime + 1) * ticdup);
+    capped = false;
+
+    if (net_client_connected)
+    {
+        now = I_GetTimeUS();
+
+        if (deadline > now + 1000)
+        {
+            deadline = now + 1000;
+            capped = true;
+        }
+    }
+
+    I_SleepUntilUS(deadline, spin_wait_us);
+
+    if (pacing_stats && !capped)
+    {
+        late = I_GetTimeUS() - deadline;
+
+        for (i = 0; i < PACING_LATE_BUCKETS - 1; ++i)
+        {
+            if (late < pacing_late_limits[i])
+            {
+                break;
+            }
+        }
+
+        ++pacing_late_hist[i];
+        ++pacing_waits;
+        pacing_late_total += late;
+
+        if (late > pacing_late_max)
+        {
+            pacing_late_max = late;
+        }
+    }
+}
+
+// Record that the given number of game tics were just run.  When
+// several are run together, the time since the last ones is shared out
+// between them.
+
+static void RecordTicsRun(int tics)
+{
+    uint64_t now;
+    uint64_t elapsed;
+    uint64_t interval;
+
+    if (tics <= 0)
+    {
+        return;
+    }
+
+    now = I_GetTimeUS();
+
+    if (pacing_last_tic != 0)
+    {
+        elapsed = now - pacing_last_tic;
+        interval = elapsed / tics;
+
+        if (pacing_intervals == 0 || interval < pacing_interval_min)
+        {
+            pacing_interval_min = interval;
+        }
+
+        if (interval > pacing_interval_max)
+        {
+            pacing_interval_max = interval;
+        }
+
+        pacing_intervals += tics;
+        pacing_interval_total += elapsed;
+        pacing_interval_squares += (double) interval * interval * tics;
+    }
+
+    pacing_last_tic = now;
+}
+
+static void PrintPacingStats(void)
+{
+    double mean, deviation;
+    int i;
+
+    printf("Frame pacing, with tics every %.2f ms:\n", 1000.0 / TICRATE);
+
+    if (pacing_waits > 0)
+    {
+        printf("    Woke up %.3f ms late on average, %.3f ms at most, "
+               "in %u waits:\n      ",
+               pacing_late_total / 1000.0 / pacing_waits,
+               pacing_late_max / 1000.0, pacing_waits);
+
+        for (i = 0; i < PACING_LATE_BUCKETS - 1; ++i)
+        {
+            printf(" <%uus: %u", pacing_late_limits[i], pacing_late_hist[i]);
+        }
+
+        printf(" more: %u\n", pacing_late_hist[PACING_LATE_BUCKETS - 1]);
+    }
+
+    if (pacing_intervals > 0)
+    {
+        mean = pacing_interval_total / pacing_intervals;
+        deviation = sqrt(fabs(pacing_interval_squares / pacing_intervals
+                              - mean * mean));
+
+        printf("    Time per tic run: mean %.3f ms, deviation %.3f ms, "
+               "min %.3f ms, max %.3f ms\n",
+               mean / 1000.0, deviation / 1000.0,
+               pacing_interval_min / 1000.0, pacing_interval_max / 1000.0);
+    }
+}
+
 static void D_Disconnected(void)
 {
     // In drone mode, the game cannot continue once disconnected.
@@ -682,6 +858,7 @@ void TryRunTics (void)
     int realtics;
     int	availabletics;
     int	counts;
+    int tics_run;
 
     // get real tics
     entertic = I_GetTime() / ticdup;
@@ -753,18 +930,20 @@ void TryRunTics (void)
                 return;
             }
 
-            I_Sleep(1);
+            WaitForNextTic();
         }
     }
 
     // run the count * ticdup dics
+    tics_run = 0;
+
     while (counts--)
     {
         ticcmd_set_t *set;
 
         if (!PlayersInGame())
         {
-            return;
+            break;
         }
 
         set = &ticdata[(gametic / ticdup) % BACKUPTICS];
@@ -783,6 +962,7 @@ void TryRunTics (void)
 
             loop_interface->RunTic(set->cmds, set->ingame);
 	    gametic++;
+            ++tics_run;
 
 	    // modify command for duplicated tics
 
@@ -791,11 +971,48 @@ void TryRunTics (void)
 
 	NetUpdate ();	// check for new console commands
     }
+
+    if (pacing_stats)
+    {
+        RecordTicsRun(tics_run);
+    }
 }
 
 void D_RegisterLoopCallbacks(loop_interface_t *i)
 {
+    int p;
+
     loop_interface = i;
+
+    //!
+    // @arg <us>
+    // @category obscure
+    //
+    // Busy-wait for the last <us> microseconds before each tic is
+    // due, rather than sleeping, so that tics are run closer to on
+    // time on systems that wake up late from sleeping.  This uses
+    // more CPU time.
+    //
+
+    p = M_CheckParmWithArgs("-spinwait", 1);
+
+    if (p > 0)
+    {
+        spin_wait_us = atoi(myargv[p + 1]);
+    }
+
+    //!
+    // @category obscure
+    //
+    // On exit, print statistics of how evenly spaced in time the
+    // game tics were run.
+    //
+
+    if (M_ParmExists("-pacingstats") && !pacing_stats)
+    {
+        pacing_stats = true;
+        I_AtExit(PrintPacingStats, true);
+    }
 }
 
 // TODO: Move nonvanilla demo functions into a dedicated file.
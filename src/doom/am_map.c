@@ -18,6 +18,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
 
@@ -1028,6 +1029,26 @@ AM_drawFline
 
 #define PUTDOT(xx,yy,cc) fb[(yy)*f_w+(xx)]=(cc)
 
+    // Most walls are axis-aligned: fill horizontal and vertical lines
+    // directly.  These set the same pixels as the general case below.
+
+    if (fl->a.y == fl->b.y)
+    {
+	x = fl->a.x < fl->b.x ? fl->a.x : fl->b.x;
+	dx = fl->a.x < fl->b.x ? fl->b.x - fl->a.x : fl->a.x - fl->b.x;
+	memset(&fb[fl->a.y*f_w+x], color, dx + 1);
+	return;
+    }
+
+    if (fl->a.x == fl->b.x)
+    {
+	y = fl->a.y < fl->b.y ? fl->a.y : fl->b.y;
+	dy = fl->a.y < fl->b.y ? fl->b.y - fl->a.y : fl->a.y - fl->b.y;
+	for ( ; dy >= 0 ; y++, dy--)
+	    PUTDOT(fl->a.x, y, color);
+	return;
+    }
+
     dx = fl->b.x - fl->a.x;
     ax = 2 * (dx<0 ? -dx : dx);
     sx = dx<0 ? -1 : 1;
@@ -1135,6 +1156,89 @@ void AM_drawGrid(int color)
 
 }
 
+//
+// Finds the lines that may be in the window, from the
+// blockmap cells that overlap it, so that a zoomed in
+// view of a large map does not visit every line.
+// The lines are returned in order, so that overlapping
+// lines are drawn exactly as when all are visited.
+//
+static int*	visiblelines;
+static int*	visiblestamp;
+static int	visiblealloced;
+static int	visiblecount;
+
+static int AM_compareLines(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+static int AM_findVisibleLines(void)
+{
+    int		x1, x2, y1, y2;
+    int		x, y;
+    int		num;
+    short*	list;
+
+    if (numlines > visiblealloced)
+    {
+	if (visiblelines != NULL)
+	{
+	    Z_Free(visiblelines);
+	    Z_Free(visiblestamp);
+	}
+	visiblelines = Z_Malloc(numlines * sizeof(int), PU_STATIC, 0);
+	visiblestamp = Z_Malloc(numlines * sizeof(int), PU_STATIC, 0);
+	memset(visiblestamp, 0, numlines * sizeof(int));
+	visiblealloced = numlines;
+    }
+
+    x1 = (m_x - bmaporgx) >> MAPBLOCKSHIFT;
+    x2 = (m_x2 - bmaporgx) >> MAPBLOCKSHIFT;
+    y1 = (m_y - bmaporgy) >> MAPBLOCKSHIFT;
+    y2 = (m_y2 - bmaporgy) >> MAPBLOCKSHIFT;
+
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 >= bmapwidth) x2 = bmapwidth - 1;
+    if (y2 >= bmapheight) y2 = bmapheight - 1;
+
+    num = 0;
+
+    // The whole map is in view: the blockmap does not help.
+
+    if (x1 == 0 && y1 == 0 && x2 == bmapwidth - 1 && y2 == bmapheight - 1)
+    {
+	for (num=0 ; num<numlines ; num++)
+	    visiblelines[num] = num;
+	return num;
+    }
+
+    ++visiblecount;
+
+    for (y=y1 ; y<=y2 ; y++)
+    {
+	for (x=x1 ; x<=x2 ; x++)
+	{
+	    for (list = blockmaplump + blockmap[y*bmapwidth+x] ;
+		 *list != -1 ;
+		 list++)
+	    {
+		if (*list < 0 || *list >= numlines
+		 || visiblestamp[*list] == visiblecount)
+		    continue;
+
+		visiblestamp[*list] = visiblecount;
+		visiblelines[num++] = *list;
+	    }
+	}
+    }
+
+    qsort(visiblelines, num, sizeof(int), AM_compareLines);
+
+    return num;
+}
+
 //
 // Determines visible lines, draws them.
 // This is LineDef based, not LineSeg based.
@@ -1142,10 +1246,15 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
+    int j;
+    int num;
     static mline_t l;
 
-    for (i=0;i<numlines;i++)
+    num = AM_findVisibleLines();
+
+    for (j=0;j<num;j++)
     {
+	i = visiblelines[j];
 	l.a.x = lines[i].v1->x;
 	l.a.y = lines[i].v1->y;
 	l.b.x = lines[i].v2->x;
@@ -69,9 +69,12 @@
 #include "net_dedicated.h"
 #include "net_query.h"
 
+#include "p_reject.h"
 #include "p_setup.h"
 #include "r_local.h"
+#include "simbench.h"
 #include "statdump.h"
+#include "statehash.h"
 
 #include "d_main.h"
 
@@ -456,6 +459,12 @@ void D_RunFrame()
         }
     }
 
+    // Periodic zone memory summary, with -zoneprofile.
+    if (Z_ProfileDue()) {
+        Z_DumpProfile(stdout);
+        X_LogZoneProfile();
+    }
+
     // Update display, next frame, with current state if no profiling is on
     if (screenvisible && !nodrawers)
     {
@@ -947,6 +956,45 @@ static boolean D_AddFile(char *filename)
     return handle != NULL;
 }
 
+//
+// Load a demo given on the command line, and find the name of
+// the lump to play it back from.
+//
+static void D_AddDemoFile(const char *name, char *lumpname)
+{
+    char file[256];
+    char *uc_filename = strdup(name);
+    M_ForceUppercase(uc_filename);
+
+    // With Vanilla you have to specify the file without extension,
+    // but make that optional.
+    if (M_StringEndsWith(uc_filename, ".LMP"))
+    {
+        M_StringCopy(file, name, sizeof(file));
+    }
+    else
+    {
+        DEH_snprintf(file, sizeof(file), "%s.lmp", name);
+    }
+
+    free(uc_filename);
+
+    if (D_AddFile(file))
+    {
+        M_StringCopy(lumpname, lumpinfo[numlumps - 1]->name, 9);
+    }
+    else
+    {
+        // If file failed to load, still continue trying to play
+        // the demo in the same way as Vanilla Doom.  This makes
+        // tricks like "-playdemo demo1" possible.
+
+        M_StringCopy(lumpname, name, 9);
+    }
+
+    printf("Playing demo %s.\n", file);
+}
+
 // Copyright message banners
 // Some dehacked mods replace these.  These are only displayed if they are
 // replaced by dehacked.
@@ -1305,6 +1353,11 @@ static void LoadIwadDeh(void)
 
 static void G_CheckDemoStatusAtExit (void)
 {
+    // A demo that is still playing on the way out did not finish, and
+    // we may be here from I_Error (maybe a desync found by
+    // SH_Ticker), so there is nothing for SH_DemoFinished to check.
+    statehash = false;
+
     G_CheckDemoStatus();
 }
 
@@ -1313,7 +1366,7 @@ static void G_CheckDemoStatusAtExit (void)
 //
 void D_DoomMain (void)
 {
-    int p;
+    int p, i;
     char file[256];
     char demolumpname[9];
 
@@ -1699,37 +1752,27 @@ void D_DoomMain (void)
 
     if (p)
     {
-        char *uc_filename = strdup(myargv[p + 1]);
-        M_ForceUppercase(uc_filename);
+        D_AddDemoFile(myargv[p + 1], demolumpname);
+    }
 
-        // With Vanilla you have to specify the file without extension,
-        // but make that optional.
-        if (M_StringEndsWith(uc_filename, ".LMP"))
-        {
-            M_StringCopy(file, myargv[p + 1], sizeof(file));
-        }
-        else
-        {
-            DEH_snprintf(file, sizeof(file), "%s.lmp", myargv[p+1]);
-        }
+    //!
+    // @arg <file> <demo> [<demo> ...]
+    // @category demo
+    //
+    // Play back each of the given demos as fast as possible with
+    // rendering and sound disabled, timing the play simulation, and
+    // write the results to the given file as JSON ("-" for stdout).
+    //
 
-        free(uc_filename);
+    p = M_CheckParmWithArgs("-simbench", 2);
 
-        if (D_AddFile(file))
-        {
-            M_StringCopy(demolumpname, lumpinfo[numlumps - 1]->name,
-                         sizeof(demolumpname));
-        }
-        else
+    if (p)
+    {
+        for (i = p + 2; i < myargc && myargv[i][0] != '-'; ++i)
         {
-            // If file failed to load, still continue trying to play
-            // the demo in the same way as Vanilla Doom.  This makes
-            // tricks like "-playdemo demo1" possible.
-
-            M_StringCopy(demolumpname, myargv[p + 1], sizeof(demolumpname));
+            D_AddDemoFile(myargv[i], demolumpname);
+            SB_AddDemo(demolumpname);
         }
-
-        printf("Playing demo %s.\n", file);
     }
 
     I_AtExit(G_CheckDemoStatusAtExit, true);
@@ -1737,6 +1780,23 @@ void D_DoomMain (void)
     // Generate the WAD hash table.  Speed things up a bit.
     W_GenerateHashTable();
 
+    //!
+    // @arg <file>
+    // @category mod
+    //
+    // Write every loaded map whose REJECT lump is missing, short
+    // or zero-filled to a new PWAD, with a REJECT lump built from
+    // the sector connectivity, then exit.
+    //
+
+    p = M_CheckParmWithArgs("-buildreject", 1);
+
+    if (p)
+    {
+        P_BuildRejectWad(myargv[p + 1]);
+        exit(0);
+    }
+
     // Load DEHACKED lumps from WAD files - but only if we give the right
     // command line parameter.
 
@@ -1815,6 +1875,14 @@ void D_DoomMain (void)
     I_CheckIsScreensaver();
     I_InitTimer();
     I_InitJoystick();
+
+    // The play simulation benchmark never wants sound.
+    if (M_ParmExists("-simbench"))
+    {
+        nosfxparm = true;
+        nomusicparm = true;
+    }
+
     I_InitSound(doom);
     I_InitMusic();
 
@@ -2002,6 +2070,8 @@ void D_DoomMain (void)
         DEH_printf("External statistics registered.\n");
     }
 
+    SH_Init();
+
     //!
     // @arg <x>
     // @category demo
@@ -2033,6 +2103,13 @@ void D_DoomMain (void)
 	D_DoomLoop ();  // never returns
     }
 
+    p = M_CheckParmWithArgs("-simbench", 2);
+    if (p)
+    {
+	SB_Start (myargv[p + 1]);
+	D_DoomLoop ();  // never returns
+    }
+
     if (startloadgame >= 0)
     {
         M_StringCopy(file, P_SaveGameFile(startloadgame), sizeof(file));
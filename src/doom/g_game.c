@@ -52,7 +52,9 @@
 #include "hu_stuff.h"
 #include "st_stuff.h"
 #include "am_map.h"
+#include "simbench.h"
 #include "statdump.h"
+#include "statehash.h"
 
 // Needs access to LFB.
 #include "v_video.h"
@@ -1074,6 +1076,9 @@ void G_Ticker (void)
 	D_PageTicker ();
 	break;
     }
+
+    if (statehash)
+	SH_Ticker ();
 }
 
 
@@ -1568,6 +1573,8 @@ void G_DoCompleted (void)
     StatCopy(&wminfo);
 
     WI_Start (&wminfo);
+
+    P_PrefetchLevel (gameepisode, wminfo.next + 1);
 }
 
 
@@ -2305,6 +2312,7 @@ void G_DoPlayDemo (void)
     G_InitNew (skill, episode, map);
     precache = true;
     starttime = I_GetTime ();
+    SB_DemoStarted ();
 
     usergame = false;
     demoplayback = true;
@@ -2346,6 +2354,9 @@ boolean G_CheckDemoStatus (void)
 {
     int             endtime;
 
+    if (statehash && demoplayback)
+        SH_DemoFinished ();
+
     if (timingdemo)
     {
         float fps;
@@ -2376,7 +2387,9 @@ boolean G_CheckDemoStatus (void)
 	nomonsters = false;
 	consoleplayer = 0;
 
-        if (singledemo)
+        if (simbench)
+            SB_DemoFinished ();
+        else if (singledemo)
             I_Quit ();
         else
             D_AdvanceDemo ();
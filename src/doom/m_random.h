@@ -34,6 +34,9 @@ int P_Random (void);
 // Fix randoms for demos.
 void M_ClearRandom (void);
 
+// Position in the table used by P_Random; part of the game state.
+extern int prndindex;
+
 // Defined version of P_Random() - P_Random()
 int P_SubRandom (void);
 
@@ -1019,6 +1019,7 @@ void A_SkelMissile (mobj_t* actor)
 
     mo->x += mo->momx;
     mo->y += mo->momy;
+    P_UpdateThingMirror(mo);
     mo->tracer = actor->target;
 }
 
@@ -1204,7 +1205,7 @@ void A_VileChase (mobj_t* actor)
 		// Call PIT_VileCheck to check
 		// whether object is a corpse
 		// that canbe raised.
-		if (!P_BlockThingsIterator(bx,by,PIT_VileCheck))
+		if (!P_BlockThingsFlagIterator(bx,by,MF_CORPSE,PIT_VileCheck))
 		{
 		    // got one!
 		    temp = actor->target;
@@ -1219,6 +1220,7 @@ void A_VileChase (mobj_t* actor)
 		    P_SetMobjState (corpsehit,info->raisestate);
 		    corpsehit->height <<= 2;
 		    corpsehit->flags = info->flags;
+		    P_UpdateThingMirror(corpsehit);
 		    corpsehit->health = info->spawnhealth;
 		    corpsehit->target = NULL;
 
@@ -1343,6 +1345,7 @@ void A_VileAttack (mobj_t* actor)
     // move the fire between the vile and the player
     fire->x = actor->target->x - FixedMul (24*FRACUNIT, finecosine[an]);
     fire->y = actor->target->y - FixedMul (24*FRACUNIT, finesine[an]);
+    P_UpdateThingMirror(fire);
     P_RadiusAttack (fire, actor, 70 );
 }
 
@@ -1603,6 +1606,7 @@ void A_Fall (mobj_t *actor)
 {
     // actor is on ground, it can be walked over
     actor->flags &= ~MF_SOLID;
+    P_UpdateThingMirror(actor);
 
     // So change this if corpse objects
     // are meant to be obstacles.
@@ -51,6 +51,8 @@ T_MovePlane
 {
     boolean	flag;
     fixed_t	lastpos;
+
+    P_InvalidateSightMemo();
 	
     switch(floorOrCeiling)
     {
@@ -272,7 +274,7 @@ EV_DoFloor
 	
 	// new floor thinker
 	rtn = 1;
-	floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	floor = Z_PoolMalloc (sizeof(*floor), PU_LEVSPEC);
 	P_AddThinker (&floor->thinker);
 	sec->specialdata = floor;
 	floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -476,7 +478,7 @@ EV_BuildStairs
 	
 	// new floor thinker
 	rtn = 1;
-	floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	floor = Z_PoolMalloc (sizeof(*floor), PU_LEVSPEC);
 	P_AddThinker (&floor->thinker);
 	sec->specialdata = floor;
 	floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -535,7 +537,7 @@ EV_BuildStairs
 					
 		sec = tsec;
 		secnum = newsecnum;
-		floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+		floor = Z_PoolMalloc (sizeof(*floor), PU_LEVSPEC);
 
 		P_AddThinker (&floor->thinker);
 
@@ -696,6 +696,7 @@ P_KillMobj
 
     target->flags |= MF_CORPSE|MF_DROPOFF;
     target->height >>= 2;
+    P_UpdateThingMirror(target);
 
     if (source && source->player)
     {
@@ -720,6 +721,7 @@ P_KillMobj
 	    target->player->frags[target->player-players]++;
 
 	target->flags &= ~MF_SOLID;
+	P_UpdateThingMirror(target);
 	target->player->playerstate = PST_DEAD;
 	P_DropWeapon (target->player);
         X_LogPlayerDied(target->player, source);
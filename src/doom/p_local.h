@@ -175,6 +175,11 @@ void 	P_LineOpening (line_t* linedef);
 
 boolean P_BlockLinesIterator (int x, int y, boolean(*func)(line_t*) );
 boolean P_BlockThingsIterator (int x, int y, boolean(*func)(mobj_t*) );
+boolean P_BlockThingsFlagIterator (int x, int y, int flags,
+                                   boolean(*func)(mobj_t*) );
+boolean P_BlockThingsNearIterator (int x, int y, int flags,
+                                   fixed_t px, fixed_t py, fixed_t radius,
+                                   boolean(*func)(mobj_t*) );
 
 #define PT_ADDLINES		1
 #define PT_ADDTHINGS	2
@@ -194,6 +199,11 @@ P_PathTraverse
 void P_UnsetThingPosition (mobj_t* thing);
 void P_SetThingPosition (mobj_t* thing);
 
+void P_InitThingFilter (void);
+void P_InitThingMirror (void);
+void P_AddThingMirror (mobj_t* thing);
+void P_UpdateThingMirror (mobj_t* thing);
+
 
 //
 // P_MAP
@@ -227,6 +237,8 @@ boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void	P_SlideMove (mobj_t* mo);
 boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void	P_InitSightMemo (void);
+void	P_InvalidateSightMemo (void);
 void 	P_UseLines (player_t* player);
 
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
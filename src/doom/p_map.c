@@ -37,6 +37,7 @@
 #include "doomstat.h"
 #include "r_state.h"
 // Data.
+#include "simbench.h"
 #include "sounds.h"
 
 #include "x_events.h"
@@ -177,7 +178,9 @@ P_TeleportMove
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+	    if (!P_BlockThingsNearIterator(bx,by,MF_SHOOTABLE,
+					   tmx,tmy,tmthing->radius,
+					   PIT_StompThing))
 		return false;
 
     // the move is ok,
@@ -453,7 +456,10 @@ P_CheckPosition
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+	    if (!P_BlockThingsNearIterator(bx,by,
+					   MF_SOLID|MF_SPECIAL|MF_SHOOTABLE,
+					   tmx,tmy,tmthing->radius,
+					   PIT_CheckThing))
 		return false;
 
     // check lines
@@ -476,8 +482,8 @@ P_CheckPosition
 // Attempt to move to a new position,
 // crossing special lines unless MF_TELEPORT is set.
 //
-boolean
-P_TryMove
+static boolean
+P_DoTryMove
 ( mobj_t*	thing,
   fixed_t	x,
   fixed_t	y )
@@ -546,6 +552,24 @@ P_TryMove
     return true;
 }
 
+boolean
+P_TryMove
+( mobj_t*	thing,
+  fixed_t	x,
+  fixed_t	y )
+{
+    boolean	result;
+
+    if (!simbench)
+	return P_DoTryMove (thing, x, y);
+
+    SB_Enter (sb_trymove);
+    result = P_DoTryMove (thing, x, y);
+    SB_Leave (sb_trymove);
+
+    return result;
+}
+
 
 //
 // P_ThingHeightClip
@@ -1116,6 +1140,9 @@ P_LineAttack
     fixed_t	x2;
     fixed_t	y2;
 
+    if (simbench)
+	SB_Enter (sb_lineattack);
+
     angle >>= ANGLETOFINESHIFT;
     shootthing = t1;
     la_damage = damage;
@@ -1129,6 +1156,9 @@ P_LineAttack
 		     x2, y2,
 		     PT_ADDLINES|PT_ADDTHINGS,
 		     PTR_ShootTraverse );
+
+    if (simbench)
+	SB_Leave (sb_lineattack);
 }
 
 
@@ -1275,7 +1305,7 @@ P_RadiusAttack
 
     for (y=yl ; y<=yh ; y++)
 	for (x=xl ; x<=xh ; x++)
-	    P_BlockThingsIterator (x, y, PIT_RadiusAttack );
+	    P_BlockThingsFlagIterator (x, y, MF_SHOOTABLE, PIT_RadiusAttack );
 }
 
 
@@ -1320,6 +1350,7 @@ boolean PIT_ChangeSector (mobj_t*	thing)
 	    thing->flags &= ~MF_SOLID;
 	thing->height = 0;
 	thing->radius = 0;
+	P_UpdateThingMirror(thing);
 
 	// keep checking
 	return true;
@@ -23,10 +23,14 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 
 
+#include "i_system.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_misc.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "doomstat.h"
@@ -328,6 +332,265 @@ void P_LineOpening (line_t* linedef)
 }
 
 
+//
+// THING MIRROR
+// Dense copies of the fields the blockmap collision checks
+// look at, so that scanning a block does not have to touch
+// every mobj_t in it.  Of the flags, only the bits that the
+// filtered iterators test (MF_SOLID, MF_SPECIAL, MF_SHOOTABLE,
+// MF_CORPSE) are kept current: every place that changes one of
+// those on a live mobj calls P_UpdateThingMirror.
+//
+// A slot belongs to the memory a mobj lives in, not to the mobj:
+// a new mobj allocated where an old one was freed takes over the
+// old one's slot.  Vanilla can leave a block chain pointing at a
+// removed mobj (eg. after A_SkelMissile moves a missile without
+// relinking it), and walking the chain then reads whatever is in
+// that memory.  As long as it still holds a mobj, either the freed
+// one or a new one in its place, mirrornext follows it the same
+// way, because it shadows bnext write for write.  Memory reused
+// for anything else cannot be followed.
+//
+// The mirror is only kept, and the filtered iterators below only
+// use it, with -thingfilter; by default they walk the block chains
+// as vanilla does.  -checkthingfilter walks both and stops on any
+// difference.
+//
+// Heights are not mirrored.  Apart from the missile overhead test,
+// which needs z as well, the collision checks ignore height, and z
+// changes in too many places (P_ZMovement, sector movement) to be
+// kept current cheaply.
+//
+
+#define MIRRORINITSIZE	512
+
+static fixed_t*		mirrorx;
+static fixed_t*		mirrory;
+static fixed_t*		mirrorradius;
+static int*		mirrorflags;
+static int*		mirrornext;
+static mobj_t**		mirrormobj;
+static int*		mirrorheads;
+static int		mirrorused;
+static int		mirrorsize;
+
+// Open-addressed hash of mobj addresses to their slots.  Slots
+// are never released during a level, so there are no deletions.
+
+static int*		mirrorhash;
+static int		mirrorhashsize;
+
+static boolean		thingfilter;
+static boolean		thingfiltercheck;
+
+// The flags kept current in mirrorflags.
+
+#define MIRRORFLAGS	(MF_SOLID|MF_SPECIAL|MF_SHOOTABLE|MF_CORPSE)
+
+#define MIRRORINDEX(mo)	((mo) != NULL ? (mo)->mirror : -1)
+
+static void *P_GrowMirrorArray(void *old, size_t elemsize, int newsize)
+{
+    void *result;
+
+    result = Z_Malloc(elemsize * newsize, PU_LEVEL, 0);
+
+    if (old != NULL)
+    {
+        memcpy(result, old, elemsize * mirrorsize);
+        Z_Free(old);
+    }
+
+    return result;
+}
+
+static void P_GrowMirror(int newsize)
+{
+    mirrorx = P_GrowMirrorArray(mirrorx, sizeof(*mirrorx), newsize);
+    mirrory = P_GrowMirrorArray(mirrory, sizeof(*mirrory), newsize);
+    mirrorradius = P_GrowMirrorArray(mirrorradius, sizeof(*mirrorradius),
+                                     newsize);
+    mirrorflags = P_GrowMirrorArray(mirrorflags, sizeof(*mirrorflags),
+                                    newsize);
+    mirrornext = P_GrowMirrorArray(mirrornext, sizeof(*mirrornext), newsize);
+    mirrormobj = P_GrowMirrorArray(mirrormobj, sizeof(*mirrormobj), newsize);
+    mirrorsize = newsize;
+}
+
+static unsigned int P_MirrorHashKey(mobj_t* thing)
+{
+    return (unsigned int) (((uintptr_t) thing >> 4) * 2654435761u)
+         & (mirrorhashsize - 1);
+}
+
+// Find the slot for the memory at thing, or where to add it.
+
+static int* P_MirrorHashLookup(mobj_t* thing)
+{
+    unsigned int	i;
+
+    for (i = P_MirrorHashKey(thing) ;
+         mirrorhash[i] >= 0 && mirrormobj[mirrorhash[i]] != thing ;
+         i = (i + 1) & (mirrorhashsize - 1))
+    {
+    }
+
+    return &mirrorhash[i];
+}
+
+// Kept at most half full.
+
+static void P_RehashMirror(int newsize)
+{
+    int		i;
+
+    if (mirrorhash != NULL)
+    {
+        Z_Free(mirrorhash);
+    }
+
+    mirrorhashsize = newsize;
+    mirrorhash = Z_Malloc(newsize * sizeof(*mirrorhash), PU_LEVEL, 0);
+
+    for (i = 0; i < newsize; ++i)
+    {
+        mirrorhash[i] = -1;
+    }
+
+    for (i = 0; i < mirrorused; ++i)
+    {
+        *P_MirrorHashLookup(mirrormobj[i]) = i;
+    }
+}
+
+//
+// P_InitThingFilter
+//
+void P_InitThingFilter (void)
+{
+    //!
+    // @category obscure
+    //
+    // Skip things that a collision check would ignore by looking at
+    // a dense copy of their flags and positions, rather than reading
+    // each one.  Results are identical to vanilla.
+    //
+
+    thingfilter = M_CheckParm("-thingfilter") > 0;
+
+    //!
+    // @category obscure
+    //
+    // As -thingfilter, but also walk the things in each block the
+    // vanilla way, and exit with an error if the two ever differ.
+    //
+
+    thingfiltercheck = M_CheckParm("-checkthingfilter") > 0;
+
+    if (thingfiltercheck)
+    {
+        thingfilter = true;
+    }
+}
+
+//
+// P_InitThingMirror
+// Called whenever blocklinks is (re)allocated.  Everything
+// lives at PU_LEVEL and goes away with the level.
+//
+void P_InitThingMirror (void)
+{
+    int		count;
+    int		i;
+
+    if (!thingfilter)
+    {
+        return;
+    }
+
+    mirrorx = mirrory = mirrorradius = NULL;
+    mirrornext = mirrorflags = NULL;
+    mirrormobj = NULL;
+    mirrorhash = NULL;
+    mirrorsize = 0;
+    mirrorused = 0;
+
+    P_GrowMirror(MIRRORINITSIZE);
+    P_RehashMirror(MIRRORINITSIZE * 2);
+
+    count = bmapwidth * bmapheight;
+    mirrorheads = Z_Malloc(count * sizeof(*mirrorheads), PU_LEVEL, 0);
+
+    for (i = 0; i < count; ++i)
+    {
+        mirrorheads[i] = -1;
+    }
+}
+
+//
+// P_AddThingMirror
+// Gives a newly allocated mobj its slot: the slot of the last
+// mobj that lived at the same address, if there was one.  Must
+// be called before the first P_SetThingPosition.
+//
+void P_AddThingMirror (mobj_t* thing)
+{
+    int*	hash;
+    int		slot;
+
+    if (!thingfilter)
+    {
+        return;
+    }
+
+    hash = P_MirrorHashLookup(thing);
+
+    if (*hash >= 0)
+    {
+        slot = *hash;
+    }
+    else
+    {
+        if (mirrorused == mirrorsize)
+        {
+            P_GrowMirror(mirrorsize * 2);
+        }
+
+        slot = mirrorused++;
+        *hash = slot;
+
+        if (mirrorused * 2 > mirrorhashsize)
+        {
+            P_RehashMirror(mirrorhashsize * 2);
+        }
+    }
+
+    thing->mirror = slot;
+    mirrormobj[slot] = thing;
+    mirrornext[slot] = -1;
+    P_UpdateThingMirror(thing);
+}
+
+//
+// P_UpdateThingMirror
+// For the few places that move or resize a thing, or change
+// the flags above, without going through
+// P_UnsetThingPosition/P_SetThingPosition.
+//
+void P_UpdateThingMirror (mobj_t* thing)
+{
+    if (!thingfilter)
+    {
+        return;
+    }
+
+    mirrorx[thing->mirror] = thing->x;
+    mirrory[thing->mirror] = thing->y;
+    mirrorradius[thing->mirror] = thing->radius;
+    mirrorflags[thing->mirror] = thing->flags;
+}
+
+
 //
 // THING POSITION SETTING
 //
@@ -366,7 +629,12 @@ void P_UnsetThingPosition (mobj_t* thing)
 	    thing->bnext->bprev = thing->bprev;
 	
 	if (thing->bprev)
+	{
 	    thing->bprev->bnext = thing->bnext;
+
+	    if (thingfilter)
+		mirrornext[thing->bprev->mirror] = MIRRORINDEX(thing->bnext);
+	}
 	else
 	{
 	    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
@@ -376,6 +644,10 @@ void P_UnsetThingPosition (mobj_t* thing)
 		&& blocky>=0 && blocky <bmapheight)
 	    {
 		blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
+
+		if (thingfilter)
+		    mirrorheads[blocky*bmapwidth+blockx] =
+			MIRRORINDEX(thing->bnext);
 	    }
 	}
     }
@@ -416,6 +688,7 @@ P_SetThingPosition (mobj_t* thing)
 	sec->thinglist = thing;
     }
 
+    P_UpdateThingMirror(thing);
     
     // link into blockmap
     if ( ! (thing->flags & MF_NOBLOCKMAP) )
@@ -436,11 +709,20 @@ P_SetThingPosition (mobj_t* thing)
 		(*link)->bprev = thing;
 
 	    *link = thing;
+
+	    if (thingfilter)
+	    {
+		mirrornext[thing->mirror] = MIRRORINDEX(thing->bnext);
+		mirrorheads[blocky*bmapwidth+blockx] = thing->mirror;
+	    }
 	}
 	else
 	{
 	    // thing is off the map
 	    thing->bnext = thing->bprev = NULL;
+
+	    if (thingfilter)
+		mirrornext[thing->mirror] = -1;
 	}
     }
 }
@@ -534,6 +816,152 @@ P_BlockThingsIterator
 }
 
 
+//
+// P_CheckThingMirror
+// With -checkthingfilter, make sure the mirror of a block
+// matches the block chain, mobj for mobj.
+//
+static void P_CheckThingMirror (int x, int y)
+{
+    mobj_t*             mobj;
+    int                 i;
+
+    LINKED_LIST_CHECK_NO_CYCLE(mobj_t, blocklinks[y*bmapwidth+x], bnext);
+
+    i = mirrorheads[y*bmapwidth+x];
+
+    for (mobj = blocklinks[y*bmapwidth+x] ;
+         mobj ;
+         mobj = mobj->bnext)
+    {
+        if (i < 0
+         || mirrormobj[i] != mobj
+         || mirrorx[i] != mobj->x
+         || mirrory[i] != mobj->y
+         || mirrorradius[i] != mobj->radius
+         || (mirrorflags[i] & MIRRORFLAGS) != (mobj->flags & MIRRORFLAGS))
+        {
+            I_Error("P_CheckThingMirror: Thing mirror differs from "
+                    "block %i,%i (mobj type %i)", x, y, mobj->type);
+        }
+
+        i = mirrornext[i];
+    }
+
+    if (i >= 0)
+    {
+        I_Error("P_CheckThingMirror: Thing mirror of block %i,%i "
+                "is too long", x, y);
+    }
+}
+
+//
+// P_BlockThingsFlagIterator
+// As P_BlockThingsIterator, but skips things that have none of
+// the given flags, using only the thing mirror with -thingfilter;
+// the order of the rest is unchanged.  Only for PIT_* functions
+// that themselves return true, untouched, for those things.
+//
+boolean
+P_BlockThingsFlagIterator
+( int                   x,
+  int                   y,
+  int                   flags,
+  boolean(*func)(mobj_t*) )
+{
+    int                 i;
+
+    if (!thingfilter)
+    {
+        return P_BlockThingsIterator(x, y, func);
+    }
+
+    if ( x<0
+         || y<0
+         || x>=bmapwidth
+         || y>=bmapheight)
+    {
+        return true;
+    }
+
+    if (thingfiltercheck)
+    {
+        P_CheckThingMirror(x, y);
+    }
+
+    for (i = mirrorheads[y*bmapwidth+x] ;
+         i >= 0 ;
+         i = mirrornext[i])
+    {
+        if (!(mirrorflags[i] & flags))
+            continue;
+
+        if (!func( mirrormobj[i] ) )
+            return false;
+    }
+    return true;
+}
+
+
+//
+// P_BlockThingsNearIterator
+// As P_BlockThingsFlagIterator, but also skips things whose
+// box does not overlap the box of the given radius around
+// (px, py).
+//
+boolean
+P_BlockThingsNearIterator
+( int                   x,
+  int                   y,
+  int                   flags,
+  fixed_t               px,
+  fixed_t               py,
+  fixed_t               radius,
+  boolean(*func)(mobj_t*) )
+{
+    fixed_t             blockdist;
+    int                 i;
+
+    if (!thingfilter)
+    {
+        return P_BlockThingsIterator(x, y, func);
+    }
+
+    if ( x<0
+         || y<0
+         || x>=bmapwidth
+         || y>=bmapheight)
+    {
+        return true;
+    }
+
+    if (thingfiltercheck)
+    {
+        P_CheckThingMirror(x, y);
+    }
+
+    for (i = mirrorheads[y*bmapwidth+x] ;
+         i >= 0 ;
+         i = mirrornext[i])
+    {
+        if (!(mirrorflags[i] & flags))
+            continue;
+
+        blockdist = mirrorradius[i] + radius;
+
+        if ( abs(mirrorx[i] - px) >= blockdist
+             || abs(mirrory[i] - py) >= blockdist )
+        {
+            continue;
+        }
+
+        if (!func( mirrormobj[i] ) )
+            return false;
+    }
+    return true;
+}
+
+
 
 //
 // INTERCEPT ROUTINES
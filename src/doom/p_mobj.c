@@ -529,7 +529,7 @@ P_SpawnMobj
     state_t*	st;
     mobjinfo_t*	info;
 
-    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+    mobj = Z_PoolMalloc (sizeof(*mobj), PU_LEVEL);
     memset (mobj, 0, sizeof (*mobj));
     info = &mobjinfo[type];
 
@@ -556,6 +556,7 @@ P_SpawnMobj
     mobj->frame = st->frame;
 
     // set subsector and/or block links
+    P_AddThingMirror (mobj);
     P_SetThingPosition (mobj);
 
     mobj->floorz = mobj->subsector->sector->floorheight;
@@ -938,6 +939,7 @@ void P_CheckMissileSpawn (mobj_t* th)
     th->x += (th->momx>>1);
     th->y += (th->momy>>1);
     th->z += (th->momz>>1);
+    P_UpdateThingMirror(th);
 
     if (!P_TryMove (th, th->x, th->y))
 	P_ExplodeMissile (th);
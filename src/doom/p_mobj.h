@@ -221,6 +221,10 @@ typedef struct mobj_s
     // Links in blocks (if needed).
     struct mobj_s*	bnext;
     struct mobj_s*	bprev;
+
+    // Slot in the dense thing mirror with -thingfilter (see p_maputl.c).
+    // Not saved.
+    int			mirror;
     
     struct subsector_s*	subsector;
 
@@ -0,0 +1,343 @@
+//
+// Copyright(C) 1993-1996 Id Software, Inc.
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Offline REJECT builder.  For maps shipped with an empty or
+//	zero-filled REJECT lump, works out which sector pairs can
+//	never see each other and writes the maps back out with a
+//	filled-in REJECT to a new PWAD.
+//
+//	Two sectors are marked as rejected when no chain of
+//	two-sided lines joins them.  P_CrossSubsector stops at any
+//	line that is one-sided (or has no back sector), so a sight
+//	line between two such sectors can never succeed and
+//	P_CheckSight returns false either way; the REJECT bit just
+//	lets it say so without walking the BSP.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdata.h"
+#include "i_swap.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "p_reject.h"
+
+
+typedef PACKED_STRUCT (
+{
+    char		identification[4];
+    int			numlumps;
+    int			infotableofs;
+}) rejectwadinfo_t;
+
+typedef PACKED_STRUCT (
+{
+    int			filepos;
+    int			size;
+    char		name[8];
+}) rejectfilelump_t;
+
+// Number of lumps making up a map, marker included.
+#define MAPLUMPS (ML_BLOCKMAP + 1)
+
+
+static int FindRoot(int *parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+
+    return i;
+}
+
+
+//
+// Returns true if the map starting at the given marker lump
+// has a REJECT lump that is too short or all zeroes.
+//
+
+static boolean RejectNeedsBuilding(int marker, int numsectors)
+{
+    int minlength;
+    int lumplen;
+    int i;
+    byte *data;
+    boolean empty;
+
+    minlength = (numsectors * numsectors + 7) / 8;
+    lumplen = W_LumpLength(marker + ML_REJECT);
+
+    if (lumplen < minlength)
+    {
+        return true;
+    }
+
+    data = W_CacheLumpNum(marker + ML_REJECT, PU_STATIC);
+    empty = true;
+
+    for (i = 0; i < lumplen; ++i)
+    {
+        if (data[i] != 0)
+        {
+            empty = false;
+            break;
+        }
+    }
+
+    W_ReleaseLumpNum(marker + ML_REJECT);
+
+    return empty;
+}
+
+
+//
+// Build a REJECT matrix for the map at the given marker lump.
+// Returns NULL if the map data is too broken to reason about.
+//
+
+static byte *BuildReject(int marker, int numsectors, int *length)
+{
+    maplinedef_t *mld;
+    mapsidedef_t *msd;
+    int numlines, numsides;
+    int *parent;
+    int *root;
+    byte *reject;
+    int side[2];
+    int sector[2];
+    int i, j, s;
+    int pnum;
+
+    numlines = W_LumpLength(marker + ML_LINEDEFS) / sizeof(maplinedef_t);
+    numsides = W_LumpLength(marker + ML_SIDEDEFS) / sizeof(mapsidedef_t);
+
+    mld = W_CacheLumpNum(marker + ML_LINEDEFS, PU_STATIC);
+    msd = W_CacheLumpNum(marker + ML_SIDEDEFS, PU_STATIC);
+
+    parent = Z_Malloc(numsectors * sizeof(*parent), PU_STATIC, NULL);
+    root = Z_Malloc(numsectors * sizeof(*root), PU_STATIC, NULL);
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        parent[i] = i;
+    }
+
+    reject = NULL;
+
+    for (i = 0; i < numlines; ++i)
+    {
+        side[0] = SHORT(mld[i].sidenum[0]);
+        side[1] = SHORT(mld[i].sidenum[1]);
+
+        // Same test as P_CrossSubsector: sight only passes
+        // through lines that are two-sided and have a back.
+
+        if (!(SHORT(mld[i].flags) & ML_TWOSIDED)
+         || side[0] < 0 || side[0] >= numsides
+         || side[1] < 0 || side[1] >= numsides)
+        {
+            continue;
+        }
+
+        for (s = 0; s < 2; ++s)
+        {
+            sector[s] = SHORT(msd[side[s]].sector);
+
+            if (sector[s] < 0 || sector[s] >= numsectors)
+            {
+                fprintf(stderr, "BuildReject: %.8s: linedef %i references "
+                                "bad sector %i\n",
+                        lumpinfo[marker]->name, i, sector[s]);
+                goto done;
+            }
+        }
+
+        parent[FindRoot(parent, sector[0])] = FindRoot(parent, sector[1]);
+    }
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        root[i] = FindRoot(parent, i);
+    }
+
+    *length = (numsectors * numsectors + 7) / 8;
+    reject = Z_Malloc(*length, PU_STATIC, NULL);
+    memset(reject, 0, *length);
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        for (j = 0; j < numsectors; ++j)
+        {
+            if (root[i] != root[j])
+            {
+                pnum = i * numsectors + j;
+                reject[pnum >> 3] |= 1 << (pnum & 7);
+            }
+        }
+    }
+
+done:
+    Z_Free(parent);
+    Z_Free(root);
+    W_ReleaseLumpNum(marker + ML_LINEDEFS);
+    W_ReleaseLumpNum(marker + ML_SIDEDEFS);
+
+    return reject;
+}
+
+
+static void WriteLump(FILE *fstream, rejectfilelump_t *dirent,
+                      const char *name, void *data, int length)
+{
+    dirent->filepos = LONG(ftell(fstream));
+    dirent->size = LONG(length);
+    strncpy(dirent->name, name, 8);
+
+    if (length > 0 && fwrite(data, 1, length, fstream) != length)
+    {
+        I_Error("WriteLump: Error writing lump %.8s", name);
+    }
+}
+
+
+//
+// P_BuildRejectWad
+// Scans every loaded map and writes those that needed a
+// REJECT lump, complete with the new one, to the given PWAD.
+//
+
+void P_BuildRejectWad(const char *filename)
+{
+    FILE *fstream;
+    rejectwadinfo_t header;
+    rejectfilelump_t *directory;
+    int numentries;
+    int nummaps;
+    int marker;
+    int numsectors;
+    int length;
+    int i;
+    byte *reject;
+    void *data;
+
+    fstream = M_fopen(filename, "wb");
+
+    if (fstream == NULL)
+    {
+        I_Error("P_BuildRejectWad: Unable to open %s", filename);
+    }
+
+    directory = Z_Malloc(numlumps * sizeof(*directory), PU_STATIC, NULL);
+    numentries = 0;
+    nummaps = 0;
+
+    // Leave room for the header; it is filled in at the end.
+
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, fstream);
+
+    // A map is a marker lump followed by THINGS, LINEDEFS and
+    // so on in the usual order.  Maps overridden by a later
+    // WAD are still visited but the result is the same, as the
+    // last one loaded wins.
+
+    for (marker = 0; marker + ML_BLOCKMAP < numlumps; ++marker)
+    {
+        if (strncasecmp(lumpinfo[marker + ML_THINGS]->name, "THINGS", 8)
+         || strncasecmp(lumpinfo[marker + ML_REJECT]->name, "REJECT", 8)
+         || strncasecmp(lumpinfo[marker + ML_BLOCKMAP]->name, "BLOCKMAP", 8))
+        {
+            continue;
+        }
+
+        numsectors = W_LumpLength(marker + ML_SECTORS) / sizeof(mapsector_t);
+
+        if (numsectors <= 0 || !RejectNeedsBuilding(marker, numsectors))
+        {
+            continue;
+        }
+
+        reject = BuildReject(marker, numsectors, &length);
+
+        if (reject == NULL)
+        {
+            continue;
+        }
+
+        if (W_LumpLength(marker + ML_REJECT) < length)
+        {
+            // Vanilla pads short REJECT lumps with whatever followed
+            // them in memory; PadRejectArray emulates that.  A built
+            // lump replaces that behaviour, which matters for demos.
+
+            printf("P_BuildRejectWad: %.8s: REJECT was short; demos "
+                   "recorded against the padded lump may not play back.\n",
+                   lumpinfo[marker]->name);
+        }
+
+        for (i = 0; i < MAPLUMPS; ++i)
+        {
+            if (i == ML_REJECT)
+            {
+                WriteLump(fstream, &directory[numentries], "REJECT",
+                          reject, length);
+            }
+            else
+            {
+                data = W_CacheLumpNum(marker + i, PU_STATIC);
+                WriteLump(fstream, &directory[numentries],
+                          lumpinfo[marker + i]->name, data,
+                          W_LumpLength(marker + i));
+                W_ReleaseLumpNum(marker + i);
+            }
+
+            ++numentries;
+        }
+
+        Z_Free(reject);
+        ++nummaps;
+
+        printf("P_BuildRejectWad: %.8s: %i sectors\n",
+               lumpinfo[marker]->name, numsectors);
+    }
+
+    // Directory goes at the end, then rewrite the header.
+
+    memcpy(header.identification, "PWAD", 4);
+    header.numlumps = LONG(numentries);
+    header.infotableofs = LONG(ftell(fstream));
+
+    if (fwrite(directory, sizeof(*directory), numentries, fstream)
+            != numentries
+     || fseek(fstream, 0, SEEK_SET) != 0
+     || fwrite(&header, sizeof(header), 1, fstream) != 1)
+    {
+        I_Error("P_BuildRejectWad: Error writing %s", filename);
+    }
+
+    fclose(fstream);
+    Z_Free(directory);
+
+    printf("P_BuildRejectWad: Wrote %i map(s) to %s\n", nummaps, filename);
+}
+
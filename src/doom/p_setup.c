@@ -20,6 +20,7 @@
 
 
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "z_zone.h"
@@ -28,6 +29,10 @@
 #include "i_swap.h"
 #include "m_argv.h"
 #include "m_bbox.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "sha1.h"
+#include "w_file.h"
 
 #include "g_game.h"
 
@@ -72,6 +77,9 @@ side_t*		sides;
 
 static int      totallines;
 
+// Start of the line lists built by P_GroupLines.
+static line_t**	sectorlines;
+
 // BLOCKMAP
 // Created from axis aligned bounding box
 // of the map, a rectangular array of
@@ -555,6 +563,7 @@ void P_LoadBlockMap (int lump)
     count = sizeof(*blocklinks) * bmapwidth * bmapheight;
     blocklinks = Z_Malloc(count, PU_LEVEL, 0);
     memset(blocklinks, 0, count);
+    P_InitThingMirror();
 }
 
 
@@ -601,6 +610,7 @@ void P_GroupLines (void)
 
     // build line tables for each sector	
     linebuffer = Z_Malloc (totallines*sizeof(line_t *), PU_LEVEL, 0);
+    sectorlines = linebuffer;
 
     for (i=0; i<numsectors; ++i)
     {
@@ -764,6 +774,801 @@ static void P_LoadReject(int lumpnum)
 // pointer to the current map lump info struct
 lumpinfo_t *maplumpinfo;
 
+//
+// P_MapLumpName
+//
+static void P_MapLumpName (int episode, int map, char *lumpname)
+{
+    if ( gamemode == commercial)
+    {
+	if (map<10)
+	    DEH_snprintf(lumpname, 9, "map0%i", map);
+	else
+	    DEH_snprintf(lumpname, 9, "map%i", map);
+    }
+    else
+    {
+	lumpname[0] = 'E';
+	lumpname[1] = '0' + episode;
+	lumpname[2] = 'M';
+	lumpname[3] = '0' + map;
+	lumpname[4] = 0;
+    }
+}
+
+
+//
+// P_PrefetchLevel
+// Called when the intermission starts, so that
+//  reading the next level from disk overlaps with it.
+//
+void P_PrefetchLevel (int episode, int map)
+{
+    char	lumpname[9];
+    int		lumpnum;
+    int		i;
+
+    P_MapLumpName (episode, map, lumpname);
+
+    lumpnum = W_CheckNumForName (lumpname);
+
+    if (lumpnum < 0 || lumpnum + ML_BLOCKMAP >= numlumps)
+	return;
+
+    for (i=ML_THINGS ; i<=ML_BLOCKMAP ; i++)
+	W_PrefetchLumpNum (lumpnum+i);
+
+    R_PrefetchLevel (lumpnum);
+}
+
+
+//
+// P_LoadLevelData
+// Converts the map lumps into the level structures.
+//
+static void P_LoadLevelData (int lumpnum)
+{
+    // note: most of this ordering is important	
+    P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
+    P_LoadVertexes (lumpnum+ML_VERTEXES);
+    P_LoadSectors (lumpnum+ML_SECTORS);
+    P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
+
+    P_LoadLineDefs (lumpnum+ML_LINEDEFS);
+    P_LoadSubsectors (lumpnum+ML_SSECTORS);
+    P_LoadNodes (lumpnum+ML_NODES);
+    P_LoadSegs (lumpnum+ML_SEGS);
+
+    P_GroupLines ();
+}
+
+
+//
+// LEVEL CACHE
+// With -levelcache, the structures built by P_LoadLevelData
+//  are saved to a file keyed by the contents of the map lumps.
+//  Loading it back is one read into a PU_LEVEL block, after
+//  which the pointers between the arrays, stored as indexes,
+//  are turned back into pointers.
+// Texture and flat numbers depend on the rest of the WADs,
+//  so the names behind them are saved too and looked up again.
+// THINGS and REJECT are not cached; REJECT is used directly.
+//
+
+#define LEVCACHE_MAGIC "LEVCACHE"
+#define LEVCACHE_VERSION 1
+#define LEVCACHE_BYTEORDER 0x01020304
+
+// Stored in place of pointers that are not array elements.
+#define LEVCACHE_NULL		INTPTR_MIN
+#define LEVCACHE_NULLSECTOR	(INTPTR_MIN + 1)
+
+enum
+{
+    LC_VERTEXES,
+    LC_SECTORS,
+    LC_SIDES,
+    LC_LINES,
+    LC_SUBSECTORS,
+    LC_NODES,
+    LC_SEGS,
+    LC_SECTORLINES,
+    LC_BLOCKMAP,
+    LC_NAMES,
+    LC_NUMSECTIONS
+};
+
+typedef struct
+{
+    char		magic[8];
+    int			version;
+    int			byteorder;
+    int			header_size;
+    int			pointer_size;
+    unsigned int	length;
+    sha1_digest_t	key;
+
+    // Element size and count of each section.
+    int			sizes[LC_NUMSECTIONS];
+    int			counts[LC_NUMSECTIONS];
+} levcache_header_t;
+
+// A texture or flat name, and the number it resolved to.
+typedef struct
+{
+    char		name[8];
+    int			isflat;
+    int			num;
+} levcache_name_t;
+
+static char *levcache_path = NULL;
+
+static const int levcache_sizes[LC_NUMSECTIONS] =
+{
+    sizeof(vertex_t),
+    sizeof(sector_t),
+    sizeof(side_t),
+    sizeof(line_t),
+    sizeof(subsector_t),
+    sizeof(node_t),
+    sizeof(seg_t),
+    sizeof(line_t *),
+    sizeof(short),
+    sizeof(levcache_name_t),
+};
+
+// Round up to keep the arrays in the cache file aligned.
+
+static unsigned int LevCacheAlign(unsigned int offset)
+{
+    return (offset + 7) & ~7;
+}
+
+// Work out where each section starts.  Returns the file length.
+
+static unsigned int LevCacheLayout(const int *counts, unsigned int *offsets)
+{
+    unsigned int offset;
+    int i;
+
+    offset = LevCacheAlign(sizeof(levcache_header_t));
+
+    for (i = 0; i < LC_NUMSECTIONS; ++i)
+    {
+        offsets[i] = offset;
+        offset = LevCacheAlign(offset + counts[i] * levcache_sizes[i]);
+    }
+
+    return offset;
+}
+
+// The key is the contents of the map lumps that are converted.
+
+static void LevCacheKey(int lumpnum, sha1_digest_t key)
+{
+    sha1_context_t context;
+    int lump;
+    int i;
+
+    SHA1_Init(&context);
+    SHA1_UpdateInt32(&context, LEVCACHE_VERSION);
+
+    for (i = ML_LINEDEFS; i <= ML_BLOCKMAP; ++i)
+    {
+        if (i == ML_REJECT)
+        {
+            continue;
+        }
+
+        lump = lumpnum + i;
+        SHA1_UpdateInt32(&context, W_LumpLength(lump));
+        SHA1_Update(&context, W_CacheLumpNum(lump, PU_STATIC),
+                    W_LumpLength(lump));
+        W_ReleaseLumpNum(lump);
+    }
+
+    SHA1_Final(key, &context);
+}
+
+static void LevCacheSetPath(sha1_digest_t key)
+{
+    char hex[sizeof(sha1_digest_t) * 2 + 1];
+    char *dir;
+    int i;
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        M_snprintf(hex + i * 2, 3, "%02x", key[i]);
+    }
+
+    free(levcache_path);
+
+    dir = M_StringJoin(configdir, "levelcache", NULL);
+    M_MakeDirectory(dir);
+    levcache_path = M_StringJoin(dir, DIR_SEPARATOR_S, hex, ".dat", NULL);
+    free(dir);
+}
+
+static void *LevCacheEncode(const void *ptr, const void *base, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return (void *) LEVCACHE_NULL;
+    }
+    else if (ptr == GetSectorAtNullAddress())
+    {
+        return (void *) LEVCACHE_NULLSECTOR;
+    }
+    else
+    {
+        return (void *) (((const byte *) ptr - (const byte *) base)
+                         / (intptr_t) size);
+    }
+}
+
+static void *LevCacheDecode(const void *ptr, void *base, size_t size)
+{
+    intptr_t index = (intptr_t) ptr;
+
+    if (index == LEVCACHE_NULL)
+    {
+        return NULL;
+    }
+    else if (index == LEVCACHE_NULLSECTOR)
+    {
+        return GetSectorAtNullAddress();
+    }
+    else
+    {
+        return (byte *) base + index * (intptr_t) size;
+    }
+}
+
+#define ENCODE(ptr, base) LevCacheEncode((ptr), (base), sizeof(*(base)))
+#define DECODE(ptr, base) LevCacheDecode((ptr), (base), sizeof(*(base)))
+
+// Whether an index read from the cache refers to one of count
+// entries.  Sector references may also be one of the null markers.
+
+static boolean LevCacheIndexValid(const void *ptr, int count,
+                                  boolean is_sector)
+{
+    intptr_t index = (intptr_t) ptr;
+
+    if (index == LEVCACHE_NULL || index == LEVCACHE_NULLSECTOR)
+    {
+        return is_sector;
+    }
+
+    return index >= 0 && index < count;
+}
+
+#define INDEX_VALID(ptr, count) LevCacheIndexValid((ptr), (count), false)
+#define SECTOR_VALID(ptr) LevCacheIndexValid((ptr), numsectors, true)
+
+// Check every index in the cache before any is turned back into a
+// pointer.  A cache that passes the header checks can still be bad,
+// for example if it came from another build with the same structure
+// sizes.
+
+static boolean LevCacheIndexesValid(void)
+{
+    intptr_t first;
+    int i;
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        first = (intptr_t) sectors[i].lines;
+
+        if (first < 0 || first > totallines || sectors[i].linecount < 0
+         || sectors[i].linecount > totallines - first)
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < numsides; ++i)
+    {
+        if (!INDEX_VALID(sides[i].sector, numsectors))
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < numlines; ++i)
+    {
+        if (!INDEX_VALID(lines[i].v1, numvertexes)
+         || !INDEX_VALID(lines[i].v2, numvertexes)
+         || !SECTOR_VALID(lines[i].frontsector)
+         || !SECTOR_VALID(lines[i].backsector))
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < numsubsectors; ++i)
+    {
+        if (!INDEX_VALID(subsectors[i].sector, numsectors))
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < numsegs; ++i)
+    {
+        if (!INDEX_VALID(segs[i].v1, numvertexes)
+         || !INDEX_VALID(segs[i].v2, numvertexes)
+         || !INDEX_VALID(segs[i].sidedef, numsides)
+         || !INDEX_VALID(segs[i].linedef, numlines)
+         || !SECTOR_VALID(segs[i].frontsector)
+         || !SECTOR_VALID(segs[i].backsector))
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < totallines; ++i)
+    {
+        if (!INDEX_VALID(sectorlines[i], numlines))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Look a texture or flat name up again.
+
+static boolean LevCacheNameValid(const levcache_name_t *entry)
+{
+    char name[9];
+    int lump;
+
+    M_StringCopy(name, entry->name, sizeof(name));
+
+    if (entry->isflat)
+    {
+        lump = W_CheckNumForName(name);
+        return lump >= 0 && lump - firstflat == entry->num;
+    }
+    else if (name[0] == '-')
+    {
+        return entry->num == 0;
+    }
+    else
+    {
+        return R_CheckTextureNumForName(name) == entry->num;
+    }
+}
+
+//
+// P_LoadLevelCache
+// Returns false if there is no usable cache file,
+//  in which case the caller converts the map lumps.
+//
+static boolean P_LoadLevelCache (sha1_digest_t key)
+{
+    wad_file_t*		file;
+    byte*		data;
+    levcache_header_t*	header;
+    levcache_name_t*	names;
+    unsigned int	offsets[LC_NUMSECTIONS];
+    unsigned int	length;
+    int			count;
+    int			i;
+
+    file = W_OpenFile(levcache_path);
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    length = file->length;
+
+    if (length < sizeof(levcache_header_t))
+    {
+        W_CloseFile(file);
+        return false;
+    }
+
+    data = Z_Malloc(length, PU_LEVEL, NULL);
+
+    if (W_Read(file, 0, data, length) != length)
+    {
+        W_CloseFile(file);
+        Z_Free(data);
+        return false;
+    }
+
+    W_CloseFile(file);
+
+    header = (levcache_header_t *) data;
+
+    if (memcmp(header->magic, LEVCACHE_MAGIC, sizeof(header->magic)) != 0
+     || header->version != LEVCACHE_VERSION
+     || header->byteorder != LEVCACHE_BYTEORDER
+     || header->header_size != sizeof(levcache_header_t)
+     || header->pointer_size != sizeof(void *)
+     || header->length != length
+     || memcmp(header->key, key, sizeof(sha1_digest_t)) != 0
+     || memcmp(header->sizes, levcache_sizes, sizeof(levcache_sizes)) != 0
+     || LevCacheLayout(header->counts, offsets) != length)
+    {
+        printf("P_SetupLevel: Ignoring stale level cache %s\n",
+               levcache_path);
+        Z_Free(data);
+        return false;
+    }
+
+    names = (levcache_name_t *) (data + offsets[LC_NAMES]);
+
+    for (i = 0; i < header->counts[LC_NAMES]; ++i)
+    {
+        if (!LevCacheNameValid(&names[i]))
+        {
+            Z_Free(data);
+            return false;
+        }
+    }
+
+    numvertexes = header->counts[LC_VERTEXES];
+    numsectors = header->counts[LC_SECTORS];
+    numsides = header->counts[LC_SIDES];
+    numlines = header->counts[LC_LINES];
+    numsubsectors = header->counts[LC_SUBSECTORS];
+    numnodes = header->counts[LC_NODES];
+    numsegs = header->counts[LC_SEGS];
+    totallines = header->counts[LC_SECTORLINES];
+
+    vertexes = (vertex_t *) (data + offsets[LC_VERTEXES]);
+    sectors = (sector_t *) (data + offsets[LC_SECTORS]);
+    sides = (side_t *) (data + offsets[LC_SIDES]);
+    lines = (line_t *) (data + offsets[LC_LINES]);
+    subsectors = (subsector_t *) (data + offsets[LC_SUBSECTORS]);
+    nodes = (node_t *) (data + offsets[LC_NODES]);
+    segs = (seg_t *) (data + offsets[LC_SEGS]);
+    sectorlines = (line_t **) (data + offsets[LC_SECTORLINES]);
+
+    if (!LevCacheIndexesValid())
+    {
+        printf("P_SetupLevel: Ignoring bad level cache %s\n",
+               levcache_path);
+        Z_Free(data);
+        return false;
+    }
+
+    // Turn the indexes back into pointers.
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        sectors[i].lines = DECODE(sectors[i].lines, sectorlines);
+    }
+
+    for (i = 0; i < numsides; ++i)
+    {
+        sides[i].sector = DECODE(sides[i].sector, sectors);
+    }
+
+    for (i = 0; i < numlines; ++i)
+    {
+        lines[i].v1 = DECODE(lines[i].v1, vertexes);
+        lines[i].v2 = DECODE(lines[i].v2, vertexes);
+        lines[i].frontsector = DECODE(lines[i].frontsector, sectors);
+        lines[i].backsector = DECODE(lines[i].backsector, sectors);
+    }
+
+    for (i = 0; i < numsubsectors; ++i)
+    {
+        subsectors[i].sector = DECODE(subsectors[i].sector, sectors);
+    }
+
+    for (i = 0; i < numsegs; ++i)
+    {
+        segs[i].v1 = DECODE(segs[i].v1, vertexes);
+        segs[i].v2 = DECODE(segs[i].v2, vertexes);
+        segs[i].sidedef = DECODE(segs[i].sidedef, sides);
+        segs[i].linedef = DECODE(segs[i].linedef, lines);
+        segs[i].frontsector = DECODE(segs[i].frontsector, sectors);
+        segs[i].backsector = DECODE(segs[i].backsector, sectors);
+    }
+
+    for (i = 0; i < totallines; ++i)
+    {
+        sectorlines[i] = DECODE(sectorlines[i], lines);
+    }
+
+    // The blockmap is stored already swapped.
+
+    blockmaplump = (short *) (data + offsets[LC_BLOCKMAP]);
+    blockmap = blockmaplump + 4;
+    bmaporgx = blockmaplump[0]<<FRACBITS;
+    bmaporgy = blockmaplump[1]<<FRACBITS;
+    bmapwidth = blockmaplump[2];
+    bmapheight = blockmaplump[3];
+
+    count = sizeof(*blocklinks) * bmapwidth * bmapheight;
+    blocklinks = Z_Malloc(count, PU_LEVEL, 0);
+    memset(blocklinks, 0, count);
+    P_InitThingMirror();
+
+    return true;
+}
+
+// Write out a copy of an array, with its pointers replaced by
+// indexes by the encode function.
+
+static boolean LevCacheWrite(FILE *fstream, const void *array, int count,
+                             int section, void (*encode)(void *))
+{
+    static const byte zeroes[8];
+    byte *copy;
+    size_t len;
+    size_t padding;
+    int i;
+
+    len = count * levcache_sizes[section];
+    padding = LevCacheAlign(len) - len;
+
+    if (encode == NULL || len == 0)
+    {
+        return fwrite(array, 1, len, fstream) == len
+            && fwrite(zeroes, 1, padding, fstream) == padding;
+    }
+
+    copy = malloc(len);
+
+    if (copy == NULL)
+    {
+        return false;
+    }
+
+    memcpy(copy, array, len);
+
+    for (i = 0; i < count; ++i)
+    {
+        encode(copy + i * levcache_sizes[section]);
+    }
+
+    len = fwrite(copy, 1, len, fstream);
+    free(copy);
+
+    return len == count * levcache_sizes[section]
+        && fwrite(zeroes, 1, padding, fstream) == padding;
+}
+
+static void EncodeSector(void *p)
+{
+    sector_t *sector = p;
+
+    sector->lines = ENCODE(sector->lines, sectorlines);
+
+    // Nothing has been spawned yet, but make sure.
+
+    sector->soundtarget = NULL;
+    sector->thinglist = NULL;
+    sector->specialdata = NULL;
+    memset(&sector->soundorg.thinker, 0, sizeof(thinker_t));
+}
+
+static void EncodeSide(void *p)
+{
+    side_t *side = p;
+
+    side->sector = ENCODE(side->sector, sectors);
+}
+
+static void EncodeLine(void *p)
+{
+    line_t *line = p;
+
+    line->v1 = ENCODE(line->v1, vertexes);
+    line->v2 = ENCODE(line->v2, vertexes);
+    line->frontsector = ENCODE(line->frontsector, sectors);
+    line->backsector = ENCODE(line->backsector, sectors);
+    line->specialdata = NULL;
+}
+
+static void EncodeSubsector(void *p)
+{
+    subsector_t *subsector = p;
+
+    subsector->sector = ENCODE(subsector->sector, sectors);
+}
+
+static void EncodeSeg(void *p)
+{
+    seg_t *seg = p;
+
+    seg->v1 = ENCODE(seg->v1, vertexes);
+    seg->v2 = ENCODE(seg->v2, vertexes);
+    seg->sidedef = ENCODE(seg->sidedef, sides);
+    seg->linedef = ENCODE(seg->linedef, lines);
+    seg->frontsector = ENCODE(seg->frontsector, sectors);
+    seg->backsector = ENCODE(seg->backsector, sectors);
+}
+
+static void EncodeSectorLine(void *p)
+{
+    line_t **line = p;
+
+    *line = ENCODE(*line, lines);
+}
+
+static int CompareNames(const void *a, const void *b)
+{
+    const levcache_name_t *na = a, *nb = b;
+
+    if (na->isflat != nb->isflat)
+    {
+        return na->isflat - nb->isflat;
+    }
+
+    return strncmp(na->name, nb->name, sizeof(na->name));
+}
+
+static void AddName(levcache_name_t *names, int *count,
+                    const char *name, int isflat, int num)
+{
+    levcache_name_t *entry = &names[*count];
+
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->name, name, sizeof(entry->name));
+    entry->isflat = isflat;
+    entry->num = num;
+    ++*count;
+}
+
+// Collect each distinct texture and flat name used by the level.
+
+static levcache_name_t *LevCacheNames(int lumpnum, int *count)
+{
+    levcache_name_t *names;
+    mapsector_t *ms;
+    mapsidedef_t *msd;
+    int total;
+    int i, j;
+
+    names = malloc((numsectors * 2 + numsides * 3 + 1)
+                   * sizeof(levcache_name_t));
+    total = 0;
+
+    ms = W_CacheLumpNum(lumpnum + ML_SECTORS, PU_STATIC);
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        AddName(names, &total, ms[i].floorpic, 1, sectors[i].floorpic);
+        AddName(names, &total, ms[i].ceilingpic, 1, sectors[i].ceilingpic);
+    }
+
+    W_ReleaseLumpNum(lumpnum + ML_SECTORS);
+
+    msd = W_CacheLumpNum(lumpnum + ML_SIDEDEFS, PU_STATIC);
+
+    for (i = 0; i < numsides; ++i)
+    {
+        AddName(names, &total, msd[i].toptexture, 0, sides[i].toptexture);
+        AddName(names, &total, msd[i].bottomtexture, 0,
+                sides[i].bottomtexture);
+        AddName(names, &total, msd[i].midtexture, 0, sides[i].midtexture);
+    }
+
+    W_ReleaseLumpNum(lumpnum + ML_SIDEDEFS);
+
+    qsort(names, total, sizeof(levcache_name_t), CompareNames);
+
+    // Every occurrence of a name resolved to the same number, so
+    // keep just the first.
+
+    for (i = 0, j = 0; i < total; ++i)
+    {
+        if (j == 0 || CompareNames(&names[j - 1], &names[i]) != 0)
+        {
+            names[j++] = names[i];
+        }
+    }
+
+    *count = j;
+
+    return names;
+}
+
+//
+// P_SaveLevelCache
+// Writes the structures built by P_LoadLevelData.
+//
+static void P_SaveLevelCache (int lumpnum, sha1_digest_t key)
+{
+    levcache_header_t	header;
+    levcache_name_t*	names;
+    unsigned int	offsets[LC_NUMSECTIONS];
+    FILE*		fstream;
+    char*		temp_path;
+    int			numnames;
+    boolean		ok;
+
+    names = LevCacheNames(lumpnum, &numnames);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVCACHE_MAGIC, sizeof(header.magic));
+    header.version = LEVCACHE_VERSION;
+    header.byteorder = LEVCACHE_BYTEORDER;
+    header.header_size = sizeof(levcache_header_t);
+    header.pointer_size = sizeof(void *);
+    memcpy(header.key, key, sizeof(sha1_digest_t));
+    memcpy(header.sizes, levcache_sizes, sizeof(levcache_sizes));
+
+    header.counts[LC_VERTEXES] = numvertexes;
+    header.counts[LC_SECTORS] = numsectors;
+    header.counts[LC_SIDES] = numsides;
+    header.counts[LC_LINES] = numlines;
+    header.counts[LC_SUBSECTORS] = numsubsectors;
+    header.counts[LC_NODES] = numnodes;
+    header.counts[LC_SEGS] = numsegs;
+    header.counts[LC_SECTORLINES] = totallines;
+    header.counts[LC_BLOCKMAP] = W_LumpLength(lumpnum + ML_BLOCKMAP) / 2;
+    header.counts[LC_NAMES] = numnames;
+
+    header.length = LevCacheLayout(header.counts, offsets);
+
+    temp_path = M_StringJoin(levcache_path, ".tmp", NULL);
+    fstream = M_fopen(temp_path, "wb");
+
+    if (fstream == NULL)
+    {
+        printf("P_SetupLevel: Unable to write level cache %s\n", temp_path);
+        free(temp_path);
+        free(names);
+        return;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, fstream) == 1
+      && fseek(fstream, offsets[0], SEEK_SET) == 0
+      && LevCacheWrite(fstream, vertexes, numvertexes, LC_VERTEXES, NULL)
+      && LevCacheWrite(fstream, sectors, numsectors, LC_SECTORS, EncodeSector)
+      && LevCacheWrite(fstream, sides, numsides, LC_SIDES, EncodeSide)
+      && LevCacheWrite(fstream, lines, numlines, LC_LINES, EncodeLine)
+      && LevCacheWrite(fstream, subsectors, numsubsectors, LC_SUBSECTORS,
+                       EncodeSubsector)
+      && LevCacheWrite(fstream, nodes, numnodes, LC_NODES, NULL)
+      && LevCacheWrite(fstream, segs, numsegs, LC_SEGS, EncodeSeg)
+      && LevCacheWrite(fstream, sectorlines, totallines, LC_SECTORLINES,
+                       EncodeSectorLine)
+      && LevCacheWrite(fstream, blockmaplump, header.counts[LC_BLOCKMAP],
+                       LC_BLOCKMAP, NULL)
+      && LevCacheWrite(fstream, names, numnames, LC_NAMES, NULL);
+
+    free(names);
+
+    if (fclose(fstream) != 0 || !ok)
+    {
+        printf("P_SetupLevel: Error writing level cache %s\n", temp_path);
+        M_remove(temp_path);
+    }
+    else
+    {
+        // Other processes may be loading the same cache.  Renaming
+        // over the old file replaces it atomically on POSIX systems, so
+        // they never see a partial file.  Windows will not rename over
+        // an existing file; removing it first leaves a moment where the
+        // cache is missing, which only costs the reader a rebuild.
+
+        if (M_rename(temp_path, levcache_path) != 0)
+        {
+            M_remove(levcache_path);
+
+            if (M_rename(temp_path, levcache_path) != 0)
+            {
+                M_remove(temp_path);
+            }
+        }
+    }
+
+    free(temp_path);
+}
+
+
 //
 // P_SetupLevel
 //
@@ -777,6 +1582,7 @@ P_SetupLevel
     int		i;
     char	lumpname[9];
     int		lumpnum;
+    sha1_digest_t key;
 	
     totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
     wminfo.partime = 180;
@@ -794,6 +1600,7 @@ P_SetupLevel
     S_Start ();			
 
     Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
+    P_InvalidateSightMemo ();
 
     // UNUSED W_Profile ();
     P_InitThinkers ();
@@ -802,40 +1609,38 @@ P_SetupLevel
     W_Reload ();
 
     // find map name
-    if ( gamemode == commercial)
-    {
-	if (map<10)
-	    DEH_snprintf(lumpname, 9, "map0%i", map);
-	else
-	    DEH_snprintf(lumpname, 9, "map%i", map);
-    }
-    else
-    {
-	lumpname[0] = 'E';
-	lumpname[1] = '0' + episode;
-	lumpname[2] = 'M';
-	lumpname[3] = '0' + map;
-	lumpname[4] = 0;
-    }
+    P_MapLumpName (episode, map, lumpname);
 
     lumpnum = W_GetNumForName (lumpname);
 	
     maplumpinfo = lumpinfo[lumpnum];
 
     leveltime = 0;
-	
-    // note: most of this ordering is important	
-    P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
-    P_LoadVertexes (lumpnum+ML_VERTEXES);
-    P_LoadSectors (lumpnum+ML_SECTORS);
-    P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
 
-    P_LoadLineDefs (lumpnum+ML_LINEDEFS);
-    P_LoadSubsectors (lumpnum+ML_SSECTORS);
-    P_LoadNodes (lumpnum+ML_NODES);
-    P_LoadSegs (lumpnum+ML_SEGS);
+    //!
+    // @category obscure
+    //
+    // Cache the converted geometry, BSP tree and blockmap of each
+    // level in the configuration directory, so that later loads of
+    // the same level skip converting the map lumps.
+    //
+
+    if (M_ParmExists("-levelcache"))
+    {
+	LevCacheKey (lumpnum, key);
+	LevCacheSetPath (key);
+
+	if (!P_LoadLevelCache (key))
+	{
+	    P_LoadLevelData (lumpnum);
+	    P_SaveLevelCache (lumpnum, key);
+	}
+    }
+    else
+    {
+	P_LoadLevelData (lumpnum);
+    }
 
-    P_GroupLines ();
     P_LoadReject (lumpnum+ML_REJECT);
 
     bodyqueslot = 0;
@@ -880,6 +1685,8 @@ void P_Init (void)
 {
     P_InitSwitchList ();
     P_InitPicAnims ();
+    P_InitSightMemo ();
+    P_InitThingFilter ();
     R_InitSprites (sprnames);
 }
 
@@ -33,6 +33,9 @@ P_SetupLevel
   int		playermask,
   skill_t	skill);
 
+// Hint that a level will be loaded soon.
+void P_PrefetchLevel (int episode, int map);
+
 // Called by startup code.
 void P_Init (void);
 
@@ -21,7 +21,9 @@
 #include "doomstat.h"
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "p_local.h"
+#include "simbench.h"
 
 // State.
 #include "r_state.h"
@@ -40,6 +42,86 @@ fixed_t		t2y;
 int		sightcounts[2];
 
 
+//
+// SIGHT MEMO
+// P_CrossBSPNode depends only on where the two things are and
+// on the floor and ceiling heights, so its result can be kept
+// until either of those changes.  Entries are keyed on the
+// exact positions (not a rounded bucket), so a hit always
+// returns what the full check would have.  Any plane movement
+// invalidates the whole memo by bumping sightgeneration.
+//
+
+#define SIGHTMEMOSIZE	1024
+
+typedef struct
+{
+    subsector_t*	ss1;
+    subsector_t*	ss2;
+    fixed_t		x1, y1, z1, h1;
+    fixed_t		x2, y2, z2, h2;
+    int			generation;
+    boolean		result;
+} sightmemo_t;
+
+static sightmemo_t	sightmemo[SIGHTMEMOSIZE];
+static int		sightgeneration = 1;
+static boolean		sightmemoenabled;
+
+
+//
+// P_InitSightMemo
+//
+void P_InitSightMemo (void)
+{
+    //!
+    // @category obscure
+    //
+    // Remember the results of line of sight checks between things
+    // that have not moved, for as long as no floor or ceiling moves.
+    // Results are identical to a full check.
+    //
+
+    sightmemoenabled = M_CheckParm("-sightmemo") > 0;
+}
+
+
+//
+// P_InvalidateSightMemo
+// Must be called whenever a floor or ceiling height changes.
+//
+void P_InvalidateSightMemo (void)
+{
+    ++sightgeneration;
+}
+
+
+static sightmemo_t *P_SightMemoSlot (mobj_t* t1, mobj_t* t2)
+{
+    unsigned int	hash;
+
+    hash = (unsigned int) t1->x * 0x9e3779b1u;
+    hash ^= (unsigned int) t1->y * 0x85ebca6bu;
+    hash ^= (unsigned int) t2->x * 0xc2b2ae35u;
+    hash ^= (unsigned int) t2->y * 0x27d4eb2fu;
+    hash ^= (unsigned int) (t1->z ^ t2->z);
+    hash ^= hash >> 15;
+
+    return &sightmemo[hash % SIGHTMEMOSIZE];
+}
+
+
+static boolean P_SightMemoMatches (sightmemo_t* memo, mobj_t* t1, mobj_t* t2)
+{
+    return memo->generation == sightgeneration
+        && memo->ss1 == t1->subsector && memo->ss2 == t2->subsector
+        && memo->x1 == t1->x && memo->y1 == t1->y
+        && memo->z1 == t1->z && memo->h1 == t1->height
+        && memo->x2 == t2->x && memo->y2 == t2->y
+        && memo->z2 == t2->z && memo->h2 == t2->height;
+}
+
+
 // PTR_SightTraverse() for Doom 1.2 sight calculations
 // taken from prboom-plus/src/p_sight.c:69-102
 boolean PTR_SightTraverse(intercept_t *in)
@@ -335,8 +417,8 @@ boolean P_CrossBSPNode (int bspnum)
 //  if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
-boolean
-P_CheckSight
+static boolean
+P_DoCheckSight
 ( mobj_t*	t1,
   mobj_t*	t2 )
 {
@@ -345,6 +427,8 @@ P_CheckSight
     int		pnum;
     int		bytenum;
     int		bitnum;
+    sightmemo_t*	memo;
+    boolean	result;
     
     // First check for trivial rejection.
 
@@ -368,6 +452,21 @@ P_CheckSight
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
 
+    // The Doom 1.2 path goes through P_PathTraverse, whose
+    // intercepts overrun emulation has side effects, so it is
+    // never memoized.
+    memo = NULL;
+
+    if (sightmemoenabled && gameversion > exe_doom_1_2)
+    {
+        memo = P_SightMemoSlot(t1, t2);
+
+        if (P_SightMemoMatches(memo, t1, t2))
+        {
+            return memo->result;
+        }
+    }
+
     validcount++;
 	
     sightzstart = t1->z + t1->height - (t1->height>>2);
@@ -388,7 +487,42 @@ P_CheckSight
     strace.dy = t2->y - t1->y;
 
     // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+    result = P_CrossBSPNode (numnodes-1);
+
+    if (memo != NULL)
+    {
+        memo->ss1 = t1->subsector;
+        memo->ss2 = t2->subsector;
+        memo->x1 = t1->x;
+        memo->y1 = t1->y;
+        memo->z1 = t1->z;
+        memo->h1 = t1->height;
+        memo->x2 = t2->x;
+        memo->y2 = t2->y;
+        memo->z2 = t2->z;
+        memo->h2 = t2->height;
+        memo->generation = sightgeneration;
+        memo->result = result;
+    }
+
+    return result;
 }
 
 
+boolean
+P_CheckSight
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    boolean	result;
+
+    if (!simbench)
+	return P_DoCheckSight (t1, t2);
+
+    SB_Enter (sb_checksight);
+    result = P_DoCheckSight (t1, t2);
+    SB_Leave (sb_checksight);
+
+    return result;
+}
+
@@ -22,6 +22,7 @@
 #include "p_local.h"
 
 #include "doomstat.h"
+#include "simbench.h"
 
 
 int	leveltime;
@@ -29,6 +30,7 @@ int	leveltime;
 //
 // THINKERS
 // All thinkers should be allocated by Z_Malloc
+// (or Z_PoolMalloc, which Z_Free also accepts)
 // so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
@@ -144,7 +146,14 @@ void P_Ticker (void)
 	if (playeringame[i])
 	    P_PlayerThink (&players[i]);
 			
+    if (simbench)
+        SB_Enter (sb_runthinkers);
+
     P_RunThinkers ();
+
+    if (simbench)
+        SB_Leave (sb_runthinkers);
+
     P_UpdateSpecials ();
     P_RespawnSpecials ();
 
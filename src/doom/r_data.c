@@ -18,13 +18,19 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "m_argv.h"
+#include "m_config.h"
+#include "sha1.h"
 #include "z_zone.h"
 
 
+#include "w_checksum.h"
+#include "w_file.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -441,11 +447,11 @@ static void GenerateTextureHashTable(void)
 
 
 //
-// R_InitTextures
-// Initializes the texture list
-//  with the textures from the world map.
+// R_ParseTextures
+// Builds the texture list and column lookups
+//  from PNAMES and TEXTURE1/TEXTURE2.
 //
-void R_InitTextures (void)
+static void R_ParseTextures (void)
 {
     maptexture_t*	mtexture;
     texture_t*		texture;
@@ -607,7 +613,461 @@ void R_InitTextures (void)
 
     for (i=0 ; i<numtextures ; i++)
 	R_GenerateLookup (i);
-    
+}
+
+
+//
+// TEXTURE CACHE
+// Generating the column lookups needs every patch
+//  of every texture to be read from the WADs, which
+//  is slow with large PWADs.  With -texcache, the
+//  texture list, lookups and composites are saved
+//  to a file keyed by the WAD directory and mapped
+//  back in on the next run.
+//
+
+#define TEXCACHE_MAGIC "TEXCACHE"
+#define TEXCACHE_VERSION 1
+#define TEXCACHE_BYTEORDER 0x01020304
+
+typedef struct
+{
+    char		magic[8];
+    int			version;
+    int			byteorder;
+    int			header_size;
+    int			numtextures;
+    unsigned int	length;
+    sha1_digest_t	key;
+} texcache_header_t;
+
+typedef struct
+{
+    char		name[8];
+    short		width;
+    short		height;
+    short		patchcount;
+    short		pad;
+    int			compositesize;
+    unsigned int	patches_offset;
+    unsigned int	columnlump_offset;
+    unsigned int	columnofs_offset;
+    unsigned int	composite_offset;
+} texcache_texture_t;
+
+static char *texcache_path = NULL;
+
+// Round up to keep the arrays in the cache file aligned.
+
+static unsigned int TexCacheAlign(unsigned int offset)
+{
+    return (offset + 3) & ~3;
+}
+
+static void TexCacheAddLump(sha1_context_t *context, const char *name)
+{
+    int lump;
+
+    lump = W_CheckNumForName(name);
+
+    if (lump < 0)
+    {
+        SHA1_UpdateInt32(context, 0);
+        return;
+    }
+
+    SHA1_UpdateInt32(context, W_LumpLength(lump));
+    SHA1_Update(context, W_CacheLumpNum(lump, PU_STATIC), W_LumpLength(lump));
+    W_ReleaseLumpNum(lump);
+}
+
+// The key is the checksum of the WAD directory, plus the contents of
+// the lumps the texture list is parsed from.
+
+static void TexCacheKey(sha1_digest_t key)
+{
+    sha1_context_t context;
+    sha1_digest_t directory;
+
+    W_Checksum(directory);
+
+    SHA1_Init(&context);
+    SHA1_Update(&context, directory, sizeof(directory));
+    TexCacheAddLump(&context, DEH_String("PNAMES"));
+    TexCacheAddLump(&context, DEH_String("TEXTURE1"));
+    TexCacheAddLump(&context, DEH_String("TEXTURE2"));
+    SHA1_Final(key, &context);
+}
+
+static void TexCacheSetPath(sha1_digest_t key)
+{
+    char hex[sizeof(sha1_digest_t) * 2 + 1];
+    char *dir;
+    int i;
+
+    for (i = 0; i < sizeof(sha1_digest_t); ++i)
+    {
+        M_snprintf(hex + i * 2, 3, "%02x", key[i]);
+    }
+
+    dir = M_StringJoin(configdir, "texcache", NULL);
+    M_MakeDirectory(dir);
+    texcache_path = M_StringJoin(dir, DIR_SEPARATOR_S, hex, ".dat", NULL);
+    free(dir);
+}
+
+static boolean TexCacheRangeValid(const texcache_header_t *header,
+                                  unsigned int offset, unsigned int size)
+{
+    return offset == TexCacheAlign(offset)
+        && offset <= header->length && size <= header->length - offset;
+}
+
+// A stale or damaged cache is never fatal: drop it and let the caller
+// parse the texture lumps and write a new one.
+
+static boolean TexCacheDiscard(wad_file_t *file, byte *data)
+{
+    printf("R_InitTextures: Ignoring stale texture cache %s\n",
+           texcache_path);
+
+    if (file != NULL)
+    {
+        W_CloseFile(file);
+    }
+    else
+    {
+        Z_Free(data);
+    }
+
+    return false;
+}
+
+//
+// R_LoadTextureCache
+// Returns false if there is no usable cache file,
+//  in which case the caller parses the texture lumps.
+//
+static boolean R_LoadTextureCache (sha1_digest_t key)
+{
+    wad_file_t*			file;
+    byte*			data;
+    texcache_header_t*		header;
+    texcache_texture_t*		record;
+    texture_t*			texture;
+    unsigned int		length;
+    int				i;
+    int				j;
+
+    file = NULL;
+
+#ifdef HAVE_MMAP
+    file = posix_wad_file.OpenFile(texcache_path);
+#endif
+
+    if (file == NULL)
+    {
+        file = W_OpenFile(texcache_path);
+    }
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    if (file->length < sizeof(texcache_header_t))
+    {
+        W_CloseFile(file);
+        return false;
+    }
+
+    // The cache stays in use for the rest of the game, so either keep
+    // the mapping or read the whole file into a static block.
+
+    length = file->length;
+
+    if (file->mapped != NULL)
+    {
+        data = file->mapped;
+    }
+    else
+    {
+        data = Z_Malloc(length, PU_STATIC, NULL);
+
+        if (W_Read(file, 0, data, length) != length)
+        {
+            Z_Free(data);
+            W_CloseFile(file);
+            return false;
+        }
+
+        W_CloseFile(file);
+        file = NULL;
+    }
+
+    header = (texcache_header_t *) data;
+
+    if (memcmp(header->magic, TEXCACHE_MAGIC, sizeof(header->magic)) != 0
+     || header->version != TEXCACHE_VERSION
+     || header->byteorder != TEXCACHE_BYTEORDER
+     || header->header_size != sizeof(texcache_header_t)
+     || header->length != length
+     || header->numtextures <= 0
+     || memcmp(header->key, key, sizeof(sha1_digest_t)) != 0
+     || !TexCacheRangeValid(header, sizeof(texcache_header_t),
+                            header->numtextures
+                              * sizeof(texcache_texture_t)))
+    {
+        return TexCacheDiscard(file, data);
+    }
+
+    numtextures = header->numtextures;
+    record = (texcache_texture_t *) (data + sizeof(texcache_header_t));
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+        if (record[i].width <= 0 || record[i].patchcount <= 0
+         || !TexCacheRangeValid(header, record[i].patches_offset,
+                                record[i].patchcount * sizeof(texpatch_t))
+         || !TexCacheRangeValid(header, record[i].columnlump_offset,
+                                record[i].width * sizeof(short))
+         || !TexCacheRangeValid(header, record[i].columnofs_offset,
+                                record[i].width * sizeof(unsigned short))
+         || !TexCacheRangeValid(header, record[i].composite_offset,
+                                record[i].compositesize))
+        {
+            return TexCacheDiscard(file, data);
+        }
+    }
+
+    textures = Z_Malloc (numtextures * sizeof(*textures), PU_STATIC, 0);
+    texturecolumnlump = Z_Malloc (numtextures * sizeof(*texturecolumnlump), PU_STATIC, 0);
+    texturecolumnofs = Z_Malloc (numtextures * sizeof(*texturecolumnofs), PU_STATIC, 0);
+    texturecomposite = Z_Malloc (numtextures * sizeof(*texturecomposite), PU_STATIC, 0);
+    texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
+    texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
+    textureheight = Z_Malloc (numtextures * sizeof(*textureheight), PU_STATIC, 0);
+
+    for (i=0 ; i<numtextures ; i++, record++)
+    {
+        texture = textures[i] =
+            Z_Malloc (sizeof(texture_t)
+                      + sizeof(texpatch_t)*(record->patchcount-1),
+                      PU_STATIC, 0);
+
+        memcpy (texture->name, record->name, sizeof(texture->name));
+        texture->width = record->width;
+        texture->height = record->height;
+        texture->patchcount = record->patchcount;
+        memcpy (texture->patches, data + record->patches_offset,
+                record->patchcount * sizeof(texpatch_t));
+
+        // The lookups and composites are used straight from the cache
+        // and are never regenerated or purged.
+
+        texturecolumnlump[i] = (short *) (data + record->columnlump_offset);
+        texturecolumnofs[i] =
+            (unsigned short *) (data + record->columnofs_offset);
+        texturecompositesize[i] = record->compositesize;
+
+        if (record->compositesize > 0)
+            texturecomposite[i] = data + record->composite_offset;
+        else
+            texturecomposite[i] = NULL;
+
+        j = 1;
+        while (j*2 <= texture->width)
+            j<<=1;
+
+        texturewidthmask[i] = j-1;
+        textureheight[i] = texture->height<<FRACBITS;
+    }
+
+    return true;
+}
+
+static boolean TexCacheWrite(FILE *fstream, const void *buf, size_t len,
+                             unsigned int *offset)
+{
+    static const byte zeroes[4];
+    unsigned int padding;
+
+    padding = TexCacheAlign(*offset + len) - (*offset + len);
+    *offset += len + padding;
+
+    return fwrite(buf, 1, len, fstream) == len
+        && fwrite(zeroes, 1, padding, fstream) == padding;
+}
+
+//
+// R_SaveTextureCache
+// Writes the tables built by R_ParseTextures,
+//  generating any composites not built yet.
+//
+static void R_SaveTextureCache (sha1_digest_t key)
+{
+    texcache_header_t	header;
+    texcache_texture_t	record;
+    texture_t*		texture;
+    FILE*		fstream;
+    char*		temp_path;
+    unsigned int	offset;
+    boolean		ok;
+    int			i;
+
+    temp_path = M_StringJoin(texcache_path, ".tmp", NULL);
+    fstream = M_fopen(temp_path, "wb");
+
+    if (fstream == NULL)
+    {
+        printf("R_InitTextures: Unable to write texture cache %s\n",
+               temp_path);
+        free(temp_path);
+        return;
+    }
+
+    // First pass: lay out the file.
+
+    offset = sizeof(texcache_header_t)
+           + numtextures * sizeof(texcache_texture_t);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+        texture = textures[i];
+        offset = TexCacheAlign(offset + texture->patchcount * sizeof(texpatch_t));
+        offset = TexCacheAlign(offset + texture->width * sizeof(short));
+        offset = TexCacheAlign(offset + texture->width * sizeof(unsigned short));
+        offset = TexCacheAlign(offset + texturecompositesize[i]);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXCACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXCACHE_VERSION;
+    header.byteorder = TEXCACHE_BYTEORDER;
+    header.header_size = sizeof(texcache_header_t);
+    header.numtextures = numtextures;
+    header.length = offset;
+    memcpy(header.key, key, sizeof(sha1_digest_t));
+
+    offset = 0;
+    ok = TexCacheWrite(fstream, &header, sizeof(header), &offset);
+
+    // Second pass: the texture records, with the same layout as above.
+
+    offset += numtextures * sizeof(texcache_texture_t);
+
+    for (i=0 ; ok && i<numtextures ; i++)
+    {
+        texture = textures[i];
+
+        memset(&record, 0, sizeof(record));
+        memcpy(record.name, texture->name, sizeof(record.name));
+        record.width = texture->width;
+        record.height = texture->height;
+        record.patchcount = texture->patchcount;
+        record.compositesize = texturecompositesize[i];
+        record.patches_offset = offset;
+        offset = TexCacheAlign(offset + texture->patchcount * sizeof(texpatch_t));
+        record.columnlump_offset = offset;
+        offset = TexCacheAlign(offset + texture->width * sizeof(short));
+        record.columnofs_offset = offset;
+        offset = TexCacheAlign(offset + texture->width * sizeof(unsigned short));
+        record.composite_offset = offset;
+        offset = TexCacheAlign(offset + texturecompositesize[i]);
+
+        ok = fwrite(&record, sizeof(record), 1, fstream) == 1;
+    }
+
+    // Third pass: the data itself.  Each composite is written out
+    // as soon as it is generated, before it can be purged.
+
+    offset = sizeof(texcache_header_t)
+           + numtextures * sizeof(texcache_texture_t);
+
+    for (i=0 ; ok && i<numtextures ; i++)
+    {
+        texture = textures[i];
+
+        ok = TexCacheWrite(fstream, texture->patches,
+                           texture->patchcount * sizeof(texpatch_t), &offset)
+          && TexCacheWrite(fstream, texturecolumnlump[i],
+                           texture->width * sizeof(short), &offset)
+          && TexCacheWrite(fstream, texturecolumnofs[i],
+                           texture->width * sizeof(unsigned short), &offset);
+
+        if (ok && texturecompositesize[i] > 0)
+        {
+            if (!texturecomposite[i])
+                R_GenerateComposite (i);
+
+            ok = TexCacheWrite(fstream, texturecomposite[i],
+                               texturecompositesize[i], &offset);
+        }
+    }
+
+    if (fclose(fstream) != 0 || !ok)
+    {
+        printf("R_InitTextures: Error writing texture cache %s\n",
+               temp_path);
+        M_remove(temp_path);
+    }
+    else
+    {
+        // Other processes may be loading the same cache.  Renaming
+        // over the old file replaces it atomically on POSIX systems, so
+        // they never see a partial file.  Windows will not rename over
+        // an existing file; removing it first leaves a moment where the
+        // cache is missing, which only costs the reader a rebuild.
+
+        if (M_rename(temp_path, texcache_path) != 0)
+        {
+            M_remove(texcache_path);
+
+            if (M_rename(temp_path, texcache_path) != 0)
+            {
+                M_remove(temp_path);
+            }
+        }
+    }
+
+    free(temp_path);
+}
+
+
+//
+// R_InitTextures
+// Initializes the texture list
+//  with the textures from the world map.
+//
+void R_InitTextures (void)
+{
+    sha1_digest_t	key;
+    int			i;
+
+    //!
+    // @category obscure
+    //
+    // Cache texture lookups and composite textures in the
+    // configuration directory, keyed by the loaded WADs.  Speeds up
+    // startup when the same set of large PWADs is used repeatedly.
+    //
+
+    if (M_ParmExists("-texcache"))
+    {
+        TexCacheKey(key);
+        TexCacheSetPath(key);
+
+        if (!R_LoadTextureCache(key))
+        {
+            R_ParseTextures();
+            R_SaveTextureCache(key);
+        }
+    }
+    else
+    {
+        R_ParseTextures();
+    }
+
     // Create translation table for global animation.
     texturetranslation = Z_Malloc ((numtextures+1)*sizeof(*texturetranslation), PU_STATIC, 0);
     
@@ -781,9 +1241,80 @@ int R_TextureNumForName(const char *name)
 
 
 
+//
+// R_PrefetchLevel
+// Hints that the flats and wall patches used
+//  by the map at lumpnum will be read soon.
+//
+static void R_PrefetchTexture (const char *name)
+{
+    texture_t*	texture;
+    int		texnum;
+    int		i;
+
+    texnum = R_CheckTextureNumForName (name);
+
+    if (texnum <= 0)
+	return;
+
+    texture = textures[texnum];
+
+    for (i=0 ; i<texture->patchcount ; i++)
+	W_PrefetchLumpNum (texture->patches[i].patch);
+}
+
+static void R_PrefetchFlat (const char *name)
+{
+    char	namet[9];
+    int		lump;
+
+    M_StringCopy (namet, name, sizeof(namet));
+    lump = W_CheckNumForName (namet);
+
+    if (lump >= firstflat && lump <= lastflat)
+	W_PrefetchLumpNum (lump);
+}
+
+void R_PrefetchLevel (int lumpnum)
+{
+    mapsector_t*	ms;
+    mapsidedef_t*	msd;
+    int			num;
+    int			i;
+
+    // The sectors and sidedefs themselves are read now; they
+    //  stay in the cache for P_SetupLevel.
+    num = W_LumpLength (lumpnum+ML_SECTORS) / sizeof(mapsector_t);
+    ms = W_CacheLumpNum (lumpnum+ML_SECTORS, PU_STATIC);
+
+    for (i=0 ; i<num ; i++, ms++)
+    {
+	R_PrefetchFlat (ms->floorpic);
+	R_PrefetchFlat (ms->ceilingpic);
+    }
+
+    W_ReleaseLumpNum (lumpnum+ML_SECTORS);
+
+    num = W_LumpLength (lumpnum+ML_SIDEDEFS) / sizeof(mapsidedef_t);
+    msd = W_CacheLumpNum (lumpnum+ML_SIDEDEFS, PU_STATIC);
+
+    for (i=0 ; i<num ; i++, msd++)
+    {
+	R_PrefetchTexture (msd->toptexture);
+	R_PrefetchTexture (msd->bottomtexture);
+	R_PrefetchTexture (msd->midtexture);
+    }
+
+    W_ReleaseLumpNum (lumpnum+ML_SIDEDEFS);
+}
+
+
+
 //
 // R_PrecacheLevel
 // Preloads all relevant graphics for the level.
+// Each group of lumps is prefetched before it is
+//  loaded, so the reads are issued together.
 //
 int		flatmemory;
 int		texturememory;
@@ -819,6 +1350,12 @@ void R_PrecacheLevel (void)
 	
     flatmemory = 0;
 
+    for (i=0 ; i<numflats ; i++)
+    {
+	if (flatpresent[i])
+	    W_PrefetchLumpNum(firstflat + i);
+    }
+
     for (i=0 ; i<numflats ; i++)
     {
 	if (flatpresent[i])
@@ -851,6 +1388,17 @@ void R_PrecacheLevel (void)
     texturepresent[skytexture] = 1;
 	
     texturememory = 0;
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!texturepresent[i])
+	    continue;
+
+	texture = textures[i];
+
+	for (j=0 ; j<texture->patchcount ; j++)
+	    W_PrefetchLumpNum(texture->patches[j].patch);
+    }
+
     for (i=0 ; i<numtextures ; i++)
     {
 	if (!texturepresent[i])
@@ -879,6 +1427,19 @@ void R_PrecacheLevel (void)
     }
 	
     spritememory = 0;
+    for (i=0 ; i<numsprites ; i++)
+    {
+	if (!spritepresent[i])
+	    continue;
+
+	for (j=0 ; j<sprites[i].numframes ; j++)
+	{
+	    sf = &sprites[i].spriteframes[j];
+	    for (k=0 ; k<8 ; k++)
+		W_PrefetchLumpNum(firstspritelump + sf->lump[k]);
+	}
+    }
+
     for (i=0 ; i<numsprites ; i++)
     {
 	if (!spritepresent[i])
@@ -23,6 +23,10 @@
 
 
 
+// Screen row and column offsets into the view window.
+extern pixel_t*		ylookup[];
+extern int		columnofs[];
+
 extern lighttable_t*	dc_colormap;
 extern int		dc_x;
 extern int		dc_yl;
@@ -81,6 +85,26 @@ void 	R_DrawSpan (void);
 void 	R_DrawSpanLow (void);
 
 
+// A set of column and span drawers.  The fuzz drawers are not
+//  included, as each pixel depends on the one drawn before it.
+typedef struct
+{
+    const char	*name;
+    void	(*column) (void);
+    void	(*columnlow) (void);
+    void	(*transcolumn) (void);
+    void	(*transcolumnlow) (void);
+    void	(*span) (void);
+    void	(*spanlow) (void);
+} r_drawkernels_t;
+
+// Drawers chosen by R_InitDrawKernels, used by R_ExecuteSetViewSize.
+extern const r_drawkernels_t *drawkernels;
+
+void R_InitDrawKernels (void);
+const r_drawkernels_t *R_GetDrawKernels (int n);
+
+
 void
 R_InitBuffer
 ( int		width,
@@ -0,0 +1,234 @@
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Checks that each set of drawers in r_simd.c draws exactly the
+//	same pixels as the reference drawers in r_draw.c.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "deh_str.h"
+#include "i_system.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+
+// Stubs for what r_draw.c uses outside of the drawers.
+
+pixel_t *I_VideoBuffer;
+GameMode_t gamemode = commercial;
+lighttable_t *colormaps;
+int centery;
+
+const char *DEH_String(const char *s) { return s; }
+void V_DrawPatch(int x, int y, patch_t *patch) { }
+void V_MarkRect(int x, int y, int width, int height) { }
+void V_UseBuffer(pixel_t *buffer) { }
+void V_RestoreBuffer(void) { }
+void *W_CacheLumpName(const char *name, int tag) { return NULL; }
+void *Z_Malloc2(int size, int tag, void *ptr, const char *file, int line)
+{
+    return malloc(size);
+}
+void Z_Free(void *ptr) { free(ptr); }
+boolean M_ParmExists(const char *check) { return false; }
+
+void I_Error(const char *error, ...)
+{
+    va_list args;
+
+    va_start(args, error);
+    vfprintf(stderr, error, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+#define NUM_SCENES 16
+#define DRAWS_PER_SCENE 2000
+
+// Translated columns do not mask the texture coordinate, so give them
+// a source that covers every value of frac>>FRACBITS.
+
+static byte column_source[0x10000];
+static byte span_source[64 * 64];
+static byte colormap[256];
+static byte translation[256];
+
+static pixel_t reference_screen[SCREENWIDTH * SCREENHEIGHT];
+static pixel_t test_screen[SCREENWIDTH * SCREENHEIGHT];
+
+static unsigned int rand_state;
+
+static unsigned int Random(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 8) ^ (rand_state << 16);
+}
+
+static int RandomRange(int n)
+{
+    return (int) (Random() % n);
+}
+
+static void SetScreen(pixel_t *screen)
+{
+    int i;
+
+    for (i = 0; i < SCREENHEIGHT; ++i)
+    {
+        ylookup[i] = screen + i * SCREENWIDTH;
+    }
+    for (i = 0; i < SCREENWIDTH; ++i)
+    {
+        columnofs[i] = i;
+    }
+}
+
+// Draw a scene of columns and spans with the given drawers.  The same
+// seed always gives the same scene.
+
+static void DrawScene(const r_drawkernels_t *kernels, pixel_t *screen,
+                      unsigned int seed)
+{
+    int width;
+    int kind;
+    int i;
+
+    SetScreen(screen);
+    memset(screen, 0, SCREENWIDTH * SCREENHEIGHT);
+
+    rand_state = seed;
+
+    for (i = 0; i < DRAWS_PER_SCENE; ++i)
+    {
+        kind = RandomRange(6);
+
+        // Low detail drawers work on half width coordinates.
+
+        width = (kind & 1) ? SCREENWIDTH / 2 : SCREENWIDTH;
+
+        if (kind < 4)
+        {
+            dc_x = RandomRange(width);
+            dc_yl = RandomRange(SCREENHEIGHT);
+            dc_yh = RandomRange(SCREENHEIGHT);
+
+            // Mostly proper columns, with some empty ones.
+
+            if (dc_yh < dc_yl && RandomRange(4) != 0)
+            {
+                int tmp = dc_yl;
+                dc_yl = dc_yh;
+                dc_yh = tmp;
+            }
+
+            dc_iscale = RandomRange(0x40000) - 0x8000;
+            dc_texturemid = Random();
+            dc_source = column_source + 0x8000;
+            dc_colormap = colormap;
+            dc_translation = translation;
+
+            switch (kind)
+            {
+                case 0: kernels->column(); break;
+                case 1: kernels->columnlow(); break;
+                case 2: kernels->transcolumn(); break;
+                case 3: kernels->transcolumnlow(); break;
+            }
+        }
+        else
+        {
+            ds_y = RandomRange(SCREENHEIGHT);
+            ds_x1 = RandomRange(width);
+            ds_x2 = ds_x1 + RandomRange(width - ds_x1);
+            ds_xfrac = Random();
+            ds_yfrac = Random();
+            ds_xstep = Random() >> RandomRange(16);
+            ds_ystep = Random() >> RandomRange(16);
+            ds_source = span_source;
+            ds_colormap = colormap;
+
+            if (kind == 4)
+            {
+                kernels->span();
+            }
+            else
+            {
+                kernels->spanlow();
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const r_drawkernels_t *reference;
+    const r_drawkernels_t *kernels;
+    int failures = 0;
+    int scene;
+    int n;
+    int i;
+
+    centery = SCREENHEIGHT / 2;
+
+    rand_state = 1;
+
+    for (i = 0; i < sizeof(column_source); ++i)
+    {
+        column_source[i] = Random();
+    }
+    for (i = 0; i < sizeof(span_source); ++i)
+    {
+        span_source[i] = Random();
+    }
+    for (i = 0; i < 256; ++i)
+    {
+        colormap[i] = Random();
+        translation[i] = Random();
+    }
+
+    reference = R_GetDrawKernels(0);
+
+    for (n = 1; (kernels = R_GetDrawKernels(n)) != NULL; ++n)
+    {
+        for (scene = 0; scene < NUM_SCENES; ++scene)
+        {
+            DrawScene(reference, reference_screen, scene + 1);
+            DrawScene(kernels, test_screen, scene + 1);
+
+            if (memcmp(reference_screen, test_screen,
+                       sizeof(test_screen)) != 0)
+            {
+                printf("%s drawers: scene %i differs from reference\n",
+                       kernels->name, scene);
+                ++failures;
+            }
+        }
+
+        printf("%s drawers: %i scenes checked\n", kernels->name, NUM_SCENES);
+    }
+
+    if (n == 1)
+    {
+        printf("No accelerated drawers on this CPU\n");
+    }
+
+    return failures != 0;
+}
@@ -696,17 +696,17 @@ void R_ExecuteSetViewSize (void)
 
     if (!detailshift)
     {
-	colfunc = basecolfunc = R_DrawColumn;
+	colfunc = basecolfunc = drawkernels->column;
 	fuzzcolfunc = R_DrawFuzzColumn;
-	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
+	transcolfunc = drawkernels->transcolumn;
+	spanfunc = drawkernels->span;
     }
     else
     {
-	colfunc = basecolfunc = R_DrawColumnLow;
+	colfunc = basecolfunc = drawkernels->columnlow;
 	fuzzcolfunc = R_DrawFuzzColumnLow;
-	transcolfunc = R_DrawTranslatedColumnLow;
-	spanfunc = R_DrawSpanLow;
+	transcolfunc = drawkernels->transcolumnlow;
+	spanfunc = drawkernels->spanlow;
     }
 
     R_InitBuffer (scaledviewwidth, viewheight);
@@ -770,6 +770,7 @@ void R_Init (void)
     R_InitPointToAngle ();
     printf (".");
     R_InitTables ();
+    R_InitDrawKernels ();
     // viewwidth / viewheight / detailLevel are set by the defaults
     printf (".");
 
@@ -0,0 +1,537 @@
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Column and span drawers that compute several pixels per
+//	iteration, selected at startup from the features of the CPU.
+//	Each one must produce exactly the same output as the reference
+//	drawer in r_draw.c; see r_draw_test.c.
+//
+//	The texture and colormap lookups are byte-sized, so they are
+//	still done one pixel at a time; it is the texture coordinate
+//	stepping and masking that is done in vector registers.
+//
+
+#include <string.h>
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "r_local.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define HAVE_X86_DRAWERS
+#include <immintrin.h>
+#endif
+
+
+static const r_drawkernels_t reference_kernels =
+{
+    "C",
+    R_DrawColumn,
+    R_DrawColumnLow,
+    R_DrawTranslatedColumn,
+    R_DrawTranslatedColumnLow,
+    R_DrawSpan,
+    R_DrawSpanLow,
+};
+
+const r_drawkernels_t *drawkernels = &reference_kernels;
+
+
+#ifdef HAVE_X86_DRAWERS
+
+//
+// SSE2: four pixels per iteration.
+//
+
+// Texture coordinates for a column: frac, frac+step, frac+2*step, ...
+// The arithmetic is done unsigned so that it wraps exactly as the
+// reference drawers do.
+
+__attribute__((target("sse2")))
+static __m128i ColumnFracs_SSE2(unsigned int frac, unsigned int step)
+{
+    return _mm_set_epi32(frac + step * 3, frac + step * 2,
+                         frac + step, frac);
+}
+
+__attribute__((target("sse2")))
+static void R_DrawColumn_SSE2 (void)
+{
+    int			count;
+    pixel_t*		dest;
+    unsigned int	frac;
+    unsigned int	fracstep;
+    __m128i		fracs;
+    __m128i		step4;
+    __m128i		mask;
+    int			spot[4];
+
+    count = dc_yh - dc_yl + 1;
+
+    if (count <= 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[dc_x];
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    fracs = ColumnFracs_SSE2(frac, fracstep);
+    step4 = _mm_set1_epi32(fracstep * 4);
+    mask = _mm_set1_epi32(127);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot,
+	                 _mm_and_si128(_mm_srli_epi32(fracs, FRACBITS), mask));
+
+	dest[0] = dc_colormap[dc_source[spot[0]]];
+	dest[SCREENWIDTH] = dc_colormap[dc_source[spot[1]]];
+	dest[SCREENWIDTH*2] = dc_colormap[dc_source[spot[2]]];
+	dest[SCREENWIDTH*3] = dc_colormap[dc_source[spot[3]]];
+
+	fracs = _mm_add_epi32(fracs, step4);
+	dest += SCREENWIDTH*4;
+	count -= 4;
+    }
+
+    frac = _mm_cvtsi128_si32(fracs);
+
+    while (count > 0)
+    {
+	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
+	dest += SCREENWIDTH;
+	frac += fracstep;
+	count--;
+    }
+}
+
+__attribute__((target("sse2")))
+static void R_DrawColumnLow_SSE2 (void)
+{
+    int			count;
+    pixel_t*		dest;
+    pixel_t*		dest2;
+    unsigned int	frac;
+    unsigned int	fracstep;
+    __m128i		fracs;
+    __m128i		step4;
+    __m128i		mask;
+    int			spot[4];
+    int			x;
+    int			i;
+
+    count = dc_yh - dc_yl + 1;
+
+    if (count <= 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    // Blocky mode, need to multiply by 2.
+    x = dc_x << 1;
+
+    dest = ylookup[dc_yl] + columnofs[x];
+    dest2 = ylookup[dc_yl] + columnofs[x+1];
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    fracs = ColumnFracs_SSE2(frac, fracstep);
+    step4 = _mm_set1_epi32(fracstep * 4);
+    mask = _mm_set1_epi32(127);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot,
+	                 _mm_and_si128(_mm_srli_epi32(fracs, FRACBITS), mask));
+
+	for (i=0 ; i<4 ; i++)
+	{
+	    dest2[SCREENWIDTH*i] = dest[SCREENWIDTH*i]
+	                         = dc_colormap[dc_source[spot[i]]];
+	}
+
+	fracs = _mm_add_epi32(fracs, step4);
+	dest += SCREENWIDTH*4;
+	dest2 += SCREENWIDTH*4;
+	count -= 4;
+    }
+
+    frac = _mm_cvtsi128_si32(fracs);
+
+    while (count > 0)
+    {
+	*dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
+	dest += SCREENWIDTH;
+	dest2 += SCREENWIDTH;
+	frac += fracstep;
+	count--;
+    }
+}
+
+// The translated drawers do not mask the texture coordinate, so an
+// arithmetic shift is needed to match them.
+
+__attribute__((target("sse2")))
+static void R_DrawTranslatedColumn_SSE2 (void)
+{
+    int			count;
+    pixel_t*		dest;
+    unsigned int	frac;
+    unsigned int	fracstep;
+    __m128i		fracs;
+    __m128i		step4;
+    int			spot[4];
+
+    count = dc_yh - dc_yl + 1;
+
+    if (count <= 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+    {
+	I_Error ( "R_DrawColumn: %i to %i at %i",
+		  dc_yl, dc_yh, dc_x);
+    }
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[dc_x];
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    fracs = ColumnFracs_SSE2(frac, fracstep);
+    step4 = _mm_set1_epi32(fracstep * 4);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot, _mm_srai_epi32(fracs, FRACBITS));
+
+	dest[0] = dc_colormap[dc_translation[dc_source[spot[0]]]];
+	dest[SCREENWIDTH] = dc_colormap[dc_translation[dc_source[spot[1]]]];
+	dest[SCREENWIDTH*2] = dc_colormap[dc_translation[dc_source[spot[2]]]];
+	dest[SCREENWIDTH*3] = dc_colormap[dc_translation[dc_source[spot[3]]]];
+
+	fracs = _mm_add_epi32(fracs, step4);
+	dest += SCREENWIDTH*4;
+	count -= 4;
+    }
+
+    frac = _mm_cvtsi128_si32(fracs);
+
+    while (count > 0)
+    {
+	*dest = dc_colormap[dc_translation[dc_source[(int) frac>>FRACBITS]]];
+	dest += SCREENWIDTH;
+	frac += fracstep;
+	count--;
+    }
+}
+
+__attribute__((target("sse2")))
+static void R_DrawTranslatedColumnLow_SSE2 (void)
+{
+    int			count;
+    pixel_t*		dest;
+    pixel_t*		dest2;
+    unsigned int	frac;
+    unsigned int	fracstep;
+    __m128i		fracs;
+    __m128i		step4;
+    int			spot[4];
+    int			x;
+    int			i;
+
+    count = dc_yh - dc_yl + 1;
+
+    if (count <= 0)
+	return;
+
+    // low detail, need to scale by 2
+    x = dc_x << 1;
+
+#ifdef RANGECHECK
+    if ((unsigned)x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+    {
+	I_Error ( "R_DrawColumn: %i to %i at %i",
+		  dc_yl, dc_yh, x);
+    }
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[x];
+    dest2 = ylookup[dc_yl] + columnofs[x+1];
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    fracs = ColumnFracs_SSE2(frac, fracstep);
+    step4 = _mm_set1_epi32(fracstep * 4);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot, _mm_srai_epi32(fracs, FRACBITS));
+
+	for (i=0 ; i<4 ; i++)
+	{
+	    dest2[SCREENWIDTH*i] = dest[SCREENWIDTH*i]
+	        = dc_colormap[dc_translation[dc_source[spot[i]]]];
+	}
+
+	fracs = _mm_add_epi32(fracs, step4);
+	dest += SCREENWIDTH*4;
+	dest2 += SCREENWIDTH*4;
+	count -= 4;
+    }
+
+    frac = _mm_cvtsi128_si32(fracs);
+
+    while (count > 0)
+    {
+	*dest2 = *dest
+	       = dc_colormap[dc_translation[dc_source[(int) frac>>FRACBITS]]];
+	dest += SCREENWIDTH;
+	dest2 += SCREENWIDTH;
+	frac += fracstep;
+	count--;
+    }
+}
+
+// Span positions are packed as in R_DrawSpan: x in the top 16 bits and
+// y in the bottom 16 bits, each as 6.10 fixed point.
+
+__attribute__((target("sse2")))
+static __m128i SpanSpots_SSE2(__m128i position)
+{
+    __m128i ytemp, xtemp;
+
+    ytemp = _mm_and_si128(_mm_srli_epi32(position, 4),
+                          _mm_set1_epi32(0x0fc0));
+    xtemp = _mm_srli_epi32(position, 26);
+
+    return _mm_or_si128(xtemp, ytemp);
+}
+
+__attribute__((target("sse2")))
+static void R_DrawSpan_SSE2 (void)
+{
+    unsigned int	position, step;
+    pixel_t*		dest;
+    int			count;
+    int			spot[4];
+    __m128i		positions;
+    __m128i		step4;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    positions = ColumnFracs_SSE2(position, step);
+    step4 = _mm_set1_epi32(step * 4);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot, SpanSpots_SSE2(positions));
+
+	dest[0] = ds_colormap[ds_source[spot[0]]];
+	dest[1] = ds_colormap[ds_source[spot[1]]];
+	dest[2] = ds_colormap[ds_source[spot[2]]];
+	dest[3] = ds_colormap[ds_source[spot[3]]];
+
+	positions = _mm_add_epi32(positions, step4);
+	dest += 4;
+	count -= 4;
+    }
+
+    position = _mm_cvtsi128_si32(positions);
+
+    while (count > 0)
+    {
+	*dest++ = ds_colormap[ds_source[((position >> 4) & 0x0fc0)
+	                                | (position >> 26)]];
+	position += step;
+	count--;
+    }
+}
+
+__attribute__((target("sse2")))
+static void R_DrawSpanLow_SSE2 (void)
+{
+    unsigned int	position, step;
+    pixel_t*		dest;
+    int			count;
+    int			spot[4];
+    __m128i		positions;
+    __m128i		step4;
+    int			i;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    count = ds_x2 - ds_x1 + 1;
+
+    // Blocky mode, need to multiply by 2.  The reference drawer leaves
+    // ds_x1 and ds_x2 scaled, so do the same.
+    ds_x1 <<= 1;
+    ds_x2 <<= 1;
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+
+    positions = ColumnFracs_SSE2(position, step);
+    step4 = _mm_set1_epi32(step * 4);
+
+    while (count >= 4)
+    {
+	_mm_storeu_si128((__m128i *) spot, SpanSpots_SSE2(positions));
+
+	for (i=0 ; i<4 ; i++)
+	{
+	    dest[0] = dest[1] = ds_colormap[ds_source[spot[i]]];
+	    dest += 2;
+	}
+
+	positions = _mm_add_epi32(positions, step4);
+	count -= 4;
+    }
+
+    position = _mm_cvtsi128_si32(positions);
+
+    while (count > 0)
+    {
+	dest[0] = dest[1] = ds_colormap[ds_source[((position >> 4) & 0x0fc0)
+	                                          | (position >> 26)]];
+	dest += 2;
+	position += step;
+	count--;
+    }
+}
+
+static const r_drawkernels_t sse2_kernels =
+{
+    "SSE2",
+    R_DrawColumn_SSE2,
+    R_DrawColumnLow_SSE2,
+    R_DrawTranslatedColumn_SSE2,
+    R_DrawTranslatedColumnLow_SSE2,
+    R_DrawSpan_SSE2,
+    R_DrawSpanLow_SSE2,
+};
+
+#endif /* #ifdef HAVE_X86_DRAWERS */
+
+
+//
+// R_GetDrawKernels
+// Returns the nth set of drawers usable on this CPU,
+//  or NULL if there are no more.  Set 0 is always
+//  the reference drawers.
+//
+const r_drawkernels_t *R_GetDrawKernels (int n)
+{
+    const r_drawkernels_t *supported[2];
+    int num_supported;
+
+    num_supported = 0;
+    supported[num_supported++] = &reference_kernels;
+
+#ifdef HAVE_X86_DRAWERS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported[num_supported++] = &sse2_kernels;
+    }
+#endif
+
+    if (n < 0 || n >= num_supported)
+    {
+        return NULL;
+    }
+
+    return supported[n];
+}
+
+
+//
+// R_InitDrawKernels
+// Selects the fastest drawers the CPU supports.
+//
+void R_InitDrawKernels (void)
+{
+    const r_drawkernels_t *kernels;
+    int i;
+
+    //!
+    // @category video
+    //
+    // Use the reference C column and span drawers, even if the CPU
+    // supports faster ones.
+    //
+
+    if (M_ParmExists("-nosimd"))
+    {
+        drawkernels = &reference_kernels;
+        return;
+    }
+
+    for (i = 0; (kernels = R_GetDrawKernels(i)) != NULL; ++i)
+    {
+        drawkernels = kernels;
+    }
+}
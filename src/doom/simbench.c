@@ -0,0 +1,284 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ --
+
+ Headless play simulation benchmark.  Plays back a list of demos
+ one after another with rendering and sound off, timing each demo
+ and a few of the more expensive play simulation functions, and
+ writes the results as JSON so that runs of different builds can
+ be compared mechanically.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "cJSON.h"
+#include "d_loop.h"
+#include "doomstat.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_misc.h"
+#include "z_zone.h"
+
+#include "simbench.h"
+
+#define MAX_BENCH_DEMOS 64
+
+typedef struct
+{
+    char lumpname[9];
+    int gametics;
+    uint64_t us;
+    unsigned int calls[NUMSBFUNCS];
+    uint64_t funcus[NUMSBFUNCS];
+    unsigned int zonepeak;
+} benchdemo_t;
+
+static const char *func_names[NUMSBFUNCS] =
+{
+    "P_RunThinkers",
+    "P_CheckSight",
+    "P_TryMove",
+    "P_LineAttack",
+};
+
+boolean simbench = false;
+
+static benchdemo_t bench_demos[MAX_BENCH_DEMOS];
+static int num_bench_demos = 0;
+static int current_demo = -1;
+static const char *output_filename;
+
+static int start_gametic;
+static uint64_t start_us;
+
+// Only the outermost call of a function is timed, so that
+// recursion through the PIT_* callbacks is not counted twice.
+static int func_depth[NUMSBFUNCS];
+static uint64_t func_start[NUMSBFUNCS];
+
+void SB_AddDemo(const char *lumpname)
+{
+    if (num_bench_demos >= MAX_BENCH_DEMOS)
+    {
+        I_Error("SB_AddDemo: Too many demos (max %i)", MAX_BENCH_DEMOS);
+    }
+
+    M_StringCopy(bench_demos[num_bench_demos].lumpname, lumpname,
+                 sizeof(bench_demos[num_bench_demos].lumpname));
+    ++num_bench_demos;
+}
+
+void SB_Start(const char *filename)
+{
+    if (num_bench_demos == 0)
+    {
+        I_Error("SB_Start: No demos to benchmark");
+    }
+
+    output_filename = filename;
+    simbench = true;
+
+    nodrawers = true;
+    singletics = true;
+    singledemo = true;
+
+    current_demo = 0;
+    G_DeferedPlayDemo(bench_demos[current_demo].lumpname);
+}
+
+//
+// Called from G_DoPlayDemo once the level is loaded, so that the
+// time spent loading the first level is not counted.
+//
+void SB_DemoStarted(void)
+{
+    if (!simbench)
+    {
+        return;
+    }
+
+    memset(func_depth, 0, sizeof(func_depth));
+    memset(bench_demos[current_demo].calls, 0,
+           sizeof(bench_demos[current_demo].calls));
+    memset(bench_demos[current_demo].funcus, 0,
+           sizeof(bench_demos[current_demo].funcus));
+    Z_ResetPeak();
+    start_gametic = gametic;
+    start_us = I_GetTimeUS();
+}
+
+void SB_Enter(sbfunc_t func)
+{
+    benchdemo_t *demo = &bench_demos[current_demo];
+
+    ++demo->calls[func];
+
+    if (func_depth[func]++ == 0)
+    {
+        func_start[func] = I_GetTimeUS();
+    }
+}
+
+void SB_Leave(sbfunc_t func)
+{
+    benchdemo_t *demo = &bench_demos[current_demo];
+
+    if (--func_depth[func] == 0)
+    {
+        demo->funcus[func] += I_GetTimeUS() - func_start[func];
+    }
+}
+
+static double Seconds(uint64_t us)
+{
+    return us / 1000000.0;
+}
+
+static double TicsPerSecond(int gametics, uint64_t us)
+{
+    return us > 0 ? gametics / Seconds(us) : 0.0;
+}
+
+static cJSON *DemoReport(benchdemo_t *demo)
+{
+    cJSON *json, *funcs, *func;
+    int i;
+
+    json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "demo", demo->lumpname);
+    cJSON_AddNumberToObject(json, "gametics", demo->gametics);
+    cJSON_AddNumberToObject(json, "seconds", Seconds(demo->us));
+    cJSON_AddNumberToObject(json, "tics_per_sec",
+                            TicsPerSecond(demo->gametics, demo->us));
+    cJSON_AddNumberToObject(json, "zone_peak_bytes", demo->zonepeak);
+
+    funcs = cJSON_CreateObject();
+
+    for (i = 0; i < NUMSBFUNCS; ++i)
+    {
+        func = cJSON_CreateObject();
+        cJSON_AddNumberToObject(func, "calls", demo->calls[i]);
+        cJSON_AddNumberToObject(func, "seconds", Seconds(demo->funcus[i]));
+        cJSON_AddNumberToObject(func, "percent", demo->us > 0 ?
+                                100.0 * demo->funcus[i] / demo->us : 0.0);
+        cJSON_AddItemToObject(funcs, func_names[i], func);
+    }
+
+    cJSON_AddItemToObject(json, "functions", funcs);
+
+    return json;
+}
+
+static void WriteReport(void)
+{
+    cJSON *json, *demos, *total;
+    FILE *stream;
+    char *text;
+    uint64_t us = 0;
+    unsigned int zonepeak = 0;
+    int gametics = 0;
+    int i;
+
+    json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "version", PACKAGE_STRING);
+
+    demos = cJSON_CreateArray();
+
+    for (i = 0; i < num_bench_demos; ++i)
+    {
+        cJSON_AddItemToArray(demos, DemoReport(&bench_demos[i]));
+        gametics += bench_demos[i].gametics;
+        us += bench_demos[i].us;
+
+        if (bench_demos[i].zonepeak > zonepeak)
+        {
+            zonepeak = bench_demos[i].zonepeak;
+        }
+    }
+
+    cJSON_AddItemToObject(json, "demos", demos);
+
+    total = cJSON_CreateObject();
+    cJSON_AddNumberToObject(total, "gametics", gametics);
+    cJSON_AddNumberToObject(total, "seconds", Seconds(us));
+    cJSON_AddNumberToObject(total, "tics_per_sec", TicsPerSecond(gametics, us));
+    cJSON_AddNumberToObject(total, "zone_peak_bytes", zonepeak);
+    cJSON_AddItemToObject(json, "total", total);
+
+    text = cJSON_Print(json);
+
+    // Allow "-" as output file, for stdout.
+
+    if (strcmp(output_filename, "-") != 0)
+    {
+        stream = M_fopen(output_filename, "w");
+
+        if (stream == NULL)
+        {
+            I_Error("SB_DemoFinished: Unable to open %s", output_filename);
+        }
+    }
+    else
+    {
+        stream = stdout;
+    }
+
+    fprintf(stream, "%s\n", text);
+
+    if (stream != stdout)
+    {
+        fclose(stream);
+    }
+
+    free(text);
+    cJSON_Delete(json);
+}
+
+//
+// Called from G_CheckDemoStatus at the end of each demo; moves
+// on to the next one, or writes the report and quits.
+//
+void SB_DemoFinished(void)
+{
+    benchdemo_t *demo = &bench_demos[current_demo];
+    zonestats_t stats;
+
+    demo->us = I_GetTimeUS() - start_us;
+    demo->gametics = gametic - start_gametic;
+
+    Z_GetStats(&stats);
+    demo->zonepeak = stats.usedpeak;
+
+    printf("SB_DemoFinished: %s: %i gametics in %.3f seconds (%.1f tics/sec)\n",
+           demo->lumpname, demo->gametics, Seconds(demo->us),
+           TicsPerSecond(demo->gametics, demo->us));
+
+    ++current_demo;
+
+    if (current_demo < num_bench_demos)
+    {
+        G_DeferedPlayDemo(bench_demos[current_demo].lumpname);
+        return;
+    }
+
+    WriteReport();
+    I_Quit();
+}
+
@@ -0,0 +1,46 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ */
+
+#ifndef DOOM_SIMBENCH_H
+#define DOOM_SIMBENCH_H
+
+#include "doomtype.h"
+
+// Play simulation functions timed by -simbench.
+
+typedef enum
+{
+    sb_runthinkers,
+    sb_checksight,
+    sb_trymove,
+    sb_lineattack,
+    NUMSBFUNCS
+} sbfunc_t;
+
+// True while running -simbench; the SB_Enter/SB_Leave calls
+// are skipped entirely otherwise.
+extern boolean simbench;
+
+void SB_AddDemo(const char *lumpname);
+void SB_Start(const char *filename);
+void SB_DemoStarted(void);
+void SB_DemoFinished(void);
+
+void SB_Enter(sbfunc_t func);
+void SB_Leave(sbfunc_t func);
+
+#endif /* #ifndef DOOM_SIMBENCH_H */
+
@@ -0,0 +1,308 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ --
+
+ Per-tic game state hashes, for checking that demos still play
+ back the same way.  With -hashrecord, a hash of the players,
+ mobjs and sectors is written for every tic of demo playback;
+ with -hashcheck, the hashes are compared against such a file
+ and playback stops with an error at the first tic that differs.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomstat.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_random.h"
+#include "p_local.h"
+
+#include "statehash.h"
+
+#define HASH_HEADER "statehash 1"
+
+boolean statehash = false;
+
+static FILE *hash_file;
+static boolean hash_checking;
+static int hash_tic;
+
+//
+// Same idea as G_CmdChecksum, but mixing rather than summing so
+// that swapped values don't cancel out.
+//
+static unsigned int HashInt(unsigned int hash, int value)
+{
+    return hash * 31 + (unsigned int) value;
+}
+
+static unsigned int HashPlayer(unsigned int hash, player_t *player)
+{
+    int i;
+
+    hash = HashInt(hash, player->playerstate);
+    hash = HashInt(hash, player->viewz);
+    hash = HashInt(hash, player->health);
+    hash = HashInt(hash, player->armorpoints);
+    hash = HashInt(hash, player->armortype);
+    hash = HashInt(hash, player->readyweapon);
+    hash = HashInt(hash, player->pendingweapon);
+
+    for (i = 0; i < NUMPOWERS; ++i)
+    {
+        hash = HashInt(hash, player->powers[i]);
+    }
+
+    for (i = 0; i < NUMCARDS; ++i)
+    {
+        hash = HashInt(hash, player->cards[i]);
+    }
+
+    for (i = 0; i < NUMWEAPONS; ++i)
+    {
+        hash = HashInt(hash, player->weaponowned[i]);
+    }
+
+    for (i = 0; i < NUMAMMO; ++i)
+    {
+        hash = HashInt(hash, player->ammo[i]);
+        hash = HashInt(hash, player->maxammo[i]);
+    }
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        hash = HashInt(hash, player->frags[i]);
+    }
+
+    hash = HashInt(hash, player->killcount);
+    hash = HashInt(hash, player->itemcount);
+    hash = HashInt(hash, player->secretcount);
+    hash = HashInt(hash, player->damagecount);
+    hash = HashInt(hash, player->bonuscount);
+
+    return hash;
+}
+
+static unsigned int HashMobj(unsigned int hash, mobj_t *mo)
+{
+    hash = HashInt(hash, mo->type);
+    hash = HashInt(hash, mo->x);
+    hash = HashInt(hash, mo->y);
+    hash = HashInt(hash, mo->z);
+    hash = HashInt(hash, mo->momx);
+    hash = HashInt(hash, mo->momy);
+    hash = HashInt(hash, mo->momz);
+    hash = HashInt(hash, mo->angle);
+    hash = HashInt(hash, mo->flags);
+    hash = HashInt(hash, mo->health);
+    hash = HashInt(hash, mo->state - states);
+    hash = HashInt(hash, mo->tics);
+    hash = HashInt(hash, mo->movedir);
+    hash = HashInt(hash, mo->movecount);
+    hash = HashInt(hash, mo->reactiontime);
+    hash = HashInt(hash, mo->threshold);
+
+    return hash;
+}
+
+static unsigned int HashSector(unsigned int hash, sector_t *sector)
+{
+    hash = HashInt(hash, sector->floorheight);
+    hash = HashInt(hash, sector->ceilingheight);
+    hash = HashInt(hash, sector->floorpic);
+    hash = HashInt(hash, sector->ceilingpic);
+    hash = HashInt(hash, sector->lightlevel);
+    hash = HashInt(hash, sector->special);
+
+    return hash;
+}
+
+//
+// Hash of everything in the play simulation that a desync would
+// show up in.  Mobjs are taken in thinker order, which is itself
+// part of the state.
+//
+unsigned int SH_HashState(void)
+{
+    unsigned int hash = 0;
+    thinker_t *th;
+    int i;
+
+    hash = HashInt(hash, gamestate);
+    hash = HashInt(hash, gamemap);
+    hash = HashInt(hash, leveltime);
+    hash = HashInt(hash, prndindex);
+
+    for (i = 0; i < MAXPLAYERS; ++i)
+    {
+        if (playeringame[i])
+        {
+            hash = HashPlayer(hash, &players[i]);
+        }
+    }
+
+    if (gamestate != GS_LEVEL)
+    {
+        return hash;
+    }
+
+    for (th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+        if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+        {
+            hash = HashMobj(hash, (mobj_t *) th);
+        }
+    }
+
+    for (i = 0; i < numsectors; ++i)
+    {
+        hash = HashSector(hash, &sectors[i]);
+    }
+
+    return hash;
+}
+
+void SH_Init(void)
+{
+    char line[64];
+    int p;
+
+    //!
+    // @arg <file>
+    // @category demo
+    //
+    // While playing back a demo, write a hash of the game state
+    // for every tic to the given file, for use with -hashcheck.
+    //
+
+    p = M_CheckParmWithArgs("-hashrecord", 1);
+
+    if (p > 0)
+    {
+        hash_file = M_fopen(myargv[p + 1], "w");
+
+        if (hash_file == NULL)
+        {
+            I_Error("SH_Init: Unable to open %s", myargv[p + 1]);
+        }
+
+        fprintf(hash_file, "%s\n", HASH_HEADER);
+        hash_checking = false;
+        statehash = true;
+        return;
+    }
+
+    //!
+    // @arg <file>
+    // @category demo
+    //
+    // While playing back a demo, compare the game state every tic
+    // against hashes written by -hashrecord, and exit with an error
+    // at the first tic that differs.
+    //
+
+    p = M_CheckParmWithArgs("-hashcheck", 1);
+
+    if (p > 0)
+    {
+        hash_file = M_fopen(myargv[p + 1], "r");
+
+        if (hash_file == NULL)
+        {
+            I_Error("SH_Init: Unable to open %s", myargv[p + 1]);
+        }
+
+        if (fgets(line, sizeof(line), hash_file) == NULL
+         || strncmp(line, HASH_HEADER, strlen(HASH_HEADER)) != 0)
+        {
+            I_Error("SH_Init: %s is not a state hash file", myargv[p + 1]);
+        }
+
+        hash_checking = true;
+        statehash = true;
+    }
+}
+
+//
+// Called at the end of each G_Ticker.
+//
+void SH_Ticker(void)
+{
+    unsigned int hash, expected;
+    int tic;
+
+    if (!demoplayback)
+    {
+        return;
+    }
+
+    hash = SH_HashState();
+
+    if (!hash_checking)
+    {
+        fprintf(hash_file, "%i %08x\n", hash_tic, hash);
+    }
+    else
+    {
+        if (fscanf(hash_file, "%i %x", &tic, &expected) != 2)
+        {
+            I_Error("SH_Ticker: Demo still running at tic %i, "
+                    "but no more hashes recorded", hash_tic);
+        }
+
+        if (tic != hash_tic || hash != expected)
+        {
+            I_Error("SH_Ticker: Desync at tic %i (gametic %i, map %i, "
+                    "leveltime %i): state hash %08x, expected %08x",
+                    hash_tic, gametic, gamemap, leveltime, hash, expected);
+        }
+    }
+
+    ++hash_tic;
+}
+
+//
+// Called from G_CheckDemoStatus when the demo ends.
+//
+void SH_DemoFinished(void)
+{
+    int tic;
+    unsigned int expected;
+
+    if (hash_checking)
+    {
+        if (fscanf(hash_file, "%i %x", &tic, &expected) == 2)
+        {
+            I_Error("SH_DemoFinished: Demo ended at tic %i, "
+                    "but hashes were recorded up to tic %i or later",
+                    hash_tic, tic);
+        }
+
+        printf("SH_DemoFinished: %i tics match.\n", hash_tic);
+    }
+    else
+    {
+        printf("SH_DemoFinished: %i tics recorded.\n", hash_tic);
+    }
+
+    fclose(hash_file);
+    hash_file = NULL;
+    statehash = false;
+}
+
@@ -0,0 +1,33 @@
+ /*
+
+ Copyright(C) 2005-2014 Simon Howard
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ */
+
+#ifndef DOOM_STATEHASH_H
+#define DOOM_STATEHASH_H
+
+#include "doomtype.h"
+
+// True if game state is being hashed during demo playback
+// (-hashrecord or -hashcheck).
+extern boolean statehash;
+
+unsigned int SH_HashState(void);
+
+void SH_Init(void);
+void SH_Ticker(void);
+void SH_DemoFinished(void);
+
+#endif /* #ifndef DOOM_STATEHASH_H */
+
@@ -57,6 +57,7 @@
 #include "m_config.h"
 #include "m_fixed.h"
 #include "x_events.h"
+#include "z_zone.h"
 
 #define MAX_FILENAME_LEN 128
 
@@ -181,6 +182,8 @@ const char* eventTypeName(xeventtype_t ev)
             return "enter_subsector";
         case e_move:
             return "move";
+        case e_zone_profile:
+            return "zone_profile";
     }
 
     printf("XXX: Unknown event type: %d\n", ev);
@@ -1473,6 +1476,67 @@ void X_LogCardPickup(player_t *player, card_t card)
     logEventWithExtraNumber(&ev, "card", card);
 }
 
+////////// Diagnostics
+
+void X_LogZoneProfile(void)
+{
+    xevent_t ev = { e_zone_profile, NULL, NULL };
+    zonestats_t stats;
+    zonesite_t top[8];
+    cJSON *json, *tags, *sites, *site;
+    int count, i;
+
+    ASSERT_TELEMETRY_ON();
+
+    json = cJSON_CreateObject();
+    tags = cJSON_CreateObject();
+    sites = cJSON_CreateArray();
+    if (!json || !tags || !sites)
+    {
+        I_Error("failed to instantiate zone profile json metadata!");
+    }
+
+    Z_GetStats(&stats);
+    cJSON_AddNumberToObject(json, "size", stats.size);
+    cJSON_AddNumberToObject(json, "free", stats.freebytes);
+    cJSON_AddNumberToObject(json, "free_blocks", stats.freeblocks);
+    cJSON_AddNumberToObject(json, "largest_free", stats.largestfree);
+    cJSON_AddNumberToObject(json, "purges", stats.purges);
+    cJSON_AddNumberToObject(json, "purged_bytes", stats.purgedbytes);
+
+    cJSON_AddNumberToObject(tags, "static", stats.tagbytes[PU_STATIC]);
+    cJSON_AddNumberToObject(tags, "sound", stats.tagbytes[PU_SOUND]);
+    cJSON_AddNumberToObject(tags, "music", stats.tagbytes[PU_MUSIC]);
+    cJSON_AddNumberToObject(tags, "level", stats.tagbytes[PU_LEVEL]);
+    cJSON_AddNumberToObject(tags, "level_peak", stats.tagpeak[PU_LEVEL]);
+    cJSON_AddNumberToObject(tags, "levspec", stats.tagbytes[PU_LEVSPEC]);
+    cJSON_AddNumberToObject(tags, "levspec_peak", stats.tagpeak[PU_LEVSPEC]);
+    cJSON_AddNumberToObject(tags, "purgelevel", stats.tagbytes[PU_PURGELEVEL]);
+    cJSON_AddNumberToObject(tags, "cache", stats.tagbytes[PU_CACHE]);
+    cJSON_AddItemToObject(json, "tags", tags);
+
+    count = Z_GetSites(top, arrlen(top));
+    for (i = 0; i < count; i++)
+    {
+        site = cJSON_CreateObject();
+        if (!site)
+        {
+            I_Error("failed to instantiate zone site json metadata!");
+        }
+        cJSON_AddStringToObject(site, "file", top[i].file);
+        cJSON_AddNumberToObject(site, "line", top[i].line);
+        cJSON_AddNumberToObject(site, "allocs", top[i].allocs);
+        cJSON_AddNumberToObject(site, "frees", top[i].frees);
+        cJSON_AddNumberToObject(site, "bytes", top[i].bytes);
+        cJSON_AddNumberToObject(site, "peak_bytes", top[i].peakbytes);
+        cJSON_AddItemToArray(sites, site);
+    }
+    cJSON_AddItemToObject(json, "sites", sites);
+
+    logEventWithExtra(&ev, "zone", json);
+    cJSON_Delete(json);
+}
+
 //// Get some feedback from a the external telemetry service.
 //
 // Returns number of bytes populated in buf on success, otherwise -1.
@@ -55,7 +55,8 @@ typedef enum
     e_health_bonus,
     e_armor_bonus,
     e_entered_sector,
-    e_entered_subsector
+    e_entered_subsector,
+    e_zone_profile
 } xeventtype_t;
 
 // A basic event data type, with optional actor and target references
@@ -122,6 +123,8 @@ void X_LogArmorPickup(mobj_t *actor, int armortype);
 void X_LogWeaponPickup(mobj_t *actor, weapontype_t weapon);
 void X_LogCardPickup(player_t *player, card_t card);
 
+void X_LogZoneProfile(void);
+
 int X_GetFeedback(char *buf, size_t buflen);
 int X_Poll(void);
 
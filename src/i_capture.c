@@ -0,0 +1,413 @@
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Capture of the rendered screen to a video file or command.
+//
+//     Frames are copied into a queue in I_FinishUpdate and converted
+//     and written out on a separate thread, so that the game loop is
+//     only held up if the output cannot keep up.
+//
+//     The video has one frame per game tic, whatever rate the screen
+//     is actually drawn at: frames drawn within the same tic are
+//     dropped, and a frame that covers several tics is repeated.
+//
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "d_loop.h"
+#include "i_capture.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Number of frames that can be waiting to be written.
+
+#define CAPTURE_QUEUE_LEN 64
+
+typedef enum
+{
+    CAPTURE_RAW,        // Headerless 24-bit RGB frames
+    CAPTURE_Y4M,        // YUV4MPEG2 stream, 4:4:4
+} capture_format_t;
+
+typedef struct
+{
+    pixel_t pixels[SCREENWIDTH * SCREENHEIGHT];
+    SDL_Color palette[256];
+    int repeat;         // Number of tics the frame was shown for
+} capture_frame_t;
+
+static boolean capture_active = false;
+static capture_format_t capture_format;
+static FILE *capture_stream;
+static boolean capture_is_pipe;
+static int capture_lasttic;
+
+#ifndef _WIN32
+static void (*old_sigpipe_handler)(int);
+#endif
+
+static capture_frame_t *queue;
+static int queue_head, queue_count;
+static boolean queue_shutdown;
+static SDL_mutex *queue_lock;
+static SDL_cond *queue_not_empty, *queue_not_full;
+static SDL_Thread *capture_thread;
+
+// Output buffer for one converted frame, used by the capture thread.
+
+static byte *frame_buffer;
+static int frame_buffer_len;
+
+static unsigned int frames_captured;
+
+static void ConvertRGB(capture_frame_t *frame)
+{
+    byte *out;
+    SDL_Color *c;
+    int i;
+
+    out = frame_buffer;
+
+    for (i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
+    {
+        c = &frame->palette[frame->pixels[i]];
+        *out++ = c->r;
+        *out++ = c->g;
+        *out++ = c->b;
+    }
+}
+
+// Convert to planar Y'CbCr (BT.601, studio range), via a table built
+// from the palette so that each pixel is just three lookups.
+
+static void ConvertY4M(capture_frame_t *frame)
+{
+    static const char frame_header[] = "FRAME\n";
+    byte ytab[256], utab[256], vtab[256];
+    byte *yplane, *uplane, *vplane;
+    SDL_Color *c;
+    pixel_t p;
+    int i;
+
+    for (i = 0; i < 256; ++i)
+    {
+        c = &frame->palette[i];
+        ytab[i] = ((66 * c->r + 129 * c->g + 25 * c->b + 128) >> 8) + 16;
+        utab[i] = ((-38 * c->r - 74 * c->g + 112 * c->b + 128) >> 8) + 128;
+        vtab[i] = ((112 * c->r - 94 * c->g - 18 * c->b + 128) >> 8) + 128;
+    }
+
+    memcpy(frame_buffer, frame_header, sizeof(frame_header) - 1);
+    yplane = frame_buffer + sizeof(frame_header) - 1;
+    uplane = yplane + SCREENWIDTH * SCREENHEIGHT;
+    vplane = uplane + SCREENWIDTH * SCREENHEIGHT;
+
+    for (i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
+    {
+        p = frame->pixels[i];
+        yplane[i] = ytab[p];
+        uplane[i] = utab[p];
+        vplane[i] = vtab[p];
+    }
+}
+
+static boolean WriteFrame(capture_frame_t *frame)
+{
+    int i;
+
+    if (capture_format == CAPTURE_Y4M)
+    {
+        ConvertY4M(frame);
+    }
+    else
+    {
+        ConvertRGB(frame);
+    }
+
+    for (i = 0; i < frame->repeat; ++i)
+    {
+        if (fwrite(frame_buffer, 1, frame_buffer_len, capture_stream)
+            != frame_buffer_len)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int CaptureThread(void *unused)
+{
+    capture_frame_t *frame;
+    boolean ok = true;
+
+    for (;;)
+    {
+        SDL_LockMutex(queue_lock);
+
+        while (queue_count == 0 && !queue_shutdown)
+        {
+            SDL_CondWait(queue_not_empty, queue_lock);
+        }
+
+        if (queue_count == 0)
+        {
+            SDL_UnlockMutex(queue_lock);
+            break;
+        }
+
+        frame = &queue[queue_head];
+        SDL_UnlockMutex(queue_lock);
+
+        // If writing fails (eg. the command exited), keep draining the
+        // queue so that the game does not stall.
+
+        if (ok && !WriteFrame(frame))
+        {
+            fprintf(stderr, "I_CaptureFrame: Error writing frame, "
+                            "capture stopped.\n");
+            ok = false;
+        }
+
+        SDL_LockMutex(queue_lock);
+        queue_head = (queue_head + 1) % CAPTURE_QUEUE_LEN;
+        --queue_count;
+        SDL_CondSignal(queue_not_full);
+        SDL_UnlockMutex(queue_lock);
+    }
+
+    return 0;
+}
+
+static void I_ShutdownCapture(void)
+{
+    if (!capture_active)
+    {
+        return;
+    }
+
+    // Let the thread write out everything still queued.
+
+    SDL_LockMutex(queue_lock);
+    queue_shutdown = true;
+    SDL_CondSignal(queue_not_empty);
+    SDL_UnlockMutex(queue_lock);
+
+    SDL_WaitThread(capture_thread, NULL);
+
+    if (capture_is_pipe)
+    {
+        pclose(capture_stream);
+#ifndef _WIN32
+        signal(SIGPIPE, old_sigpipe_handler);
+#endif
+    }
+    else
+    {
+        fclose(capture_stream);
+    }
+
+    free(queue);
+    free(frame_buffer);
+
+    printf("I_ShutdownCapture: %u frames captured.\n", frames_captured);
+
+    capture_active = false;
+}
+
+boolean I_CaptureRequested(void)
+{
+    return M_ParmExists("-capture") || M_ParmExists("-capturecmd");
+}
+
+void I_InitCapture(void)
+{
+    const char *filename;
+    int p;
+
+    //!
+    // @arg <file>
+    // @category video
+    //
+    // Capture one frame per game tic (35 frames per second) to the
+    // specified file, however many frames are displayed.  If the
+    // filename ends in .y4m, a YUV4MPEG2 stream is written; otherwise,
+    // the file contains raw 24-bit RGB frames of 320x200.  Combined with
+    // -timedemo and -noblit, demos are converted to video as fast as
+    // they can be rendered, without needing a display.
+    //
+
+    p = M_CheckParmWithArgs("-capture", 1);
+
+    if (p > 0)
+    {
+        filename = myargv[p + 1];
+        capture_stream = M_fopen(filename, "wb");
+        capture_is_pipe = false;
+
+        if (M_StringEndsWith(filename, ".y4m"))
+        {
+            capture_format = CAPTURE_Y4M;
+        }
+        else
+        {
+            capture_format = CAPTURE_RAW;
+        }
+    }
+    else
+    {
+        //!
+        // @arg <command>
+        // @category video
+        //
+        // Capture one frame per game tic as a YUV4MPEG2 stream, piped
+        // to the standard input of the specified command (eg.
+        // "ffmpeg -i - demo.mkv").
+        //
+
+        p = M_CheckParmWithArgs("-capturecmd", 1);
+
+        if (p == 0)
+        {
+            return;
+        }
+
+        filename = myargv[p + 1];
+        capture_stream = popen(filename, "w");
+
+#ifndef _WIN32
+        // If the command exits early, report a write error rather
+        // than being killed.  Only needed while the pipe is open;
+        // the previous handler is put back when it is closed.
+
+        old_sigpipe_handler = signal(SIGPIPE, SIG_IGN);
+#endif
+        capture_is_pipe = true;
+        capture_format = CAPTURE_Y4M;
+    }
+
+    if (capture_stream == NULL)
+    {
+        I_Error("I_InitCapture: Unable to open '%s' for capture", filename);
+    }
+
+    if (capture_format == CAPTURE_Y4M)
+    {
+        // One frame per tic, with a 5:6 pixel aspect ratio so that
+        // the 320x200 frame is shown at 4:3.
+
+        fprintf(capture_stream, "YUV4MPEG2 W%i H%i F%i:1 Ip A5:6 C444\n",
+                SCREENWIDTH, SCREENHEIGHT, TICRATE);
+        frame_buffer_len = 6 + SCREENWIDTH * SCREENHEIGHT * 3;
+    }
+    else
+    {
+        frame_buffer_len = SCREENWIDTH * SCREENHEIGHT * 3;
+    }
+
+    // The queue is several megabytes; keep it out of the zone.
+
+    frame_buffer = malloc(frame_buffer_len);
+    queue = malloc(sizeof(capture_frame_t) * CAPTURE_QUEUE_LEN);
+
+    if (frame_buffer == NULL || queue == NULL)
+    {
+        I_Error("I_InitCapture: Unable to allocate capture queue");
+    }
+
+    queue_head = 0;
+    queue_count = 0;
+    queue_shutdown = false;
+
+    queue_lock = SDL_CreateMutex();
+    queue_not_empty = SDL_CreateCond();
+    queue_not_full = SDL_CreateCond();
+    capture_thread = SDL_CreateThread(CaptureThread, "capture", NULL);
+
+    if (capture_thread == NULL)
+    {
+        I_Error("I_InitCapture: Unable to create thread: %s",
+                SDL_GetError());
+    }
+
+    capture_active = true;
+    capture_lasttic = -1;
+    frames_captured = 0;
+
+    I_AtExit(I_ShutdownCapture, true);
+}
+
+void I_CaptureFrame(const pixel_t *screen, const SDL_Color *palette)
+{
+    capture_frame_t *frame;
+    int repeat;
+
+    if (!capture_active)
+    {
+        return;
+    }
+
+    // The first frame, or one after gametic was reset, is shown once.
+
+    if (capture_lasttic < 0 || gametic < capture_lasttic)
+    {
+        repeat = 1;
+    }
+    else
+    {
+        repeat = gametic - capture_lasttic;
+    }
+
+    if (repeat == 0)
+    {
+        return;
+    }
+
+    capture_lasttic = gametic;
+
+    // Only this thread adds frames, so the free slot can be filled in
+    // without holding the lock.
+
+    SDL_LockMutex(queue_lock);
+
+    while (queue_count == CAPTURE_QUEUE_LEN)
+    {
+        SDL_CondWait(queue_not_full, queue_lock);
+    }
+
+    frame = &queue[(queue_head + queue_count) % CAPTURE_QUEUE_LEN];
+    SDL_UnlockMutex(queue_lock);
+
+    memcpy(frame->pixels, screen, sizeof(frame->pixels));
+    memcpy(frame->palette, palette, sizeof(frame->palette));
+    frame->repeat = repeat;
+
+    SDL_LockMutex(queue_lock);
+    ++queue_count;
+    SDL_CondSignal(queue_not_empty);
+    SDL_UnlockMutex(queue_lock);
+
+    frames_captured += repeat;
+}
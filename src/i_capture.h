@@ -0,0 +1,39 @@
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Capture of the rendered screen to a video file or command.
+//
+
+#ifndef __I_CAPTURE__
+#define __I_CAPTURE__
+
+#include "SDL.h"
+
+#include "doomtype.h"
+
+// Check the command line for capture options and start the encoder
+// thread if capture was requested.
+
+void I_InitCapture(void);
+
+// True if -capture or -capturecmd was given.  May be called before
+// I_InitCapture.
+
+boolean I_CaptureRequested(void);
+
+// Queue a copy of the screen buffer and palette for encoding, once
+// per game tic.  Only blocks if the encoder has fallen behind by a
+// full queue of frames.
+
+void I_CaptureFrame(const pixel_t *screen, const SDL_Color *palette);
+
+#endif
@@ -55,6 +55,11 @@ int snd_pitchshift = -1;
 int snd_musicdevice = SNDDEVICE_SB;
 int snd_sfxdevice = SNDDEVICE_SB;
 
+// Set by the game to disable sound effects or music.
+
+boolean nosfxparm = false;
+boolean nomusicparm = false;
+
 // Low-level sound and music modules we are using
 static const sound_module_t *sound_module;
 static const music_module_t *music_module;
@@ -213,7 +218,7 @@ void I_InitSound(GameMission_t mission)
     // Disable sound effects. 
     //
 
-    nosfx = M_CheckParm("-nosfx") > 0;
+    nosfx = nosfxparm || M_CheckParm("-nosfx") > 0;
 
     //!
     // @vanilla
@@ -221,7 +226,7 @@ void I_InitSound(GameMission_t mission)
     // Disable music.
     //
 
-    nomusic = M_CheckParm("-nomusic") > 0;
+    nomusic = nomusicparm || M_CheckParm("-nomusic") > 0;
 
     //!
     //
@@ -229,6 +229,12 @@ void I_PlaySong(void *handle, boolean looping);
 void I_StopSong(void);
 boolean I_MusicIsPlaying(void);
 
+// Set by the game before I_InitSound to disable sound effects or
+// music, as if -nosfx or -nomusic had been given.
+
+extern boolean nosfxparm;
+extern boolean nomusicparm;
+
 extern int snd_sfxdevice;
 extern int snd_musicdevice;
 extern int snd_samplerate;
@@ -16,30 +16,62 @@
 //      Timer functions.
 //
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #include "SDL.h"
 
 #include "i_timer.h"
 #include "doomtype.h"
 
+// All times are measured from the first time the timer is read, using
+// the performance counter, so that tics are not limited to the
+// millisecond resolution of SDL_GetTicks.
+
+static Uint64 basecounter = 0;
+static Uint64 counterfreq;
+
+#ifdef _WIN32
+// High resolution waitable timer used for sleeping, where available.
+
+static HANDLE sleep_timer = NULL;
+#endif
+
 //
-// I_GetTime
-// returns time in 1/35th second tics
+// Time in microseconds since the timer was first read.
 //
 
-static Uint32 basetime = 0;
-
-int  I_GetTime (void)
+static uint64_t GetElapsedUS(void)
 {
-    Uint32 ticks;
+    Uint64 counter;
+
+    counter = SDL_GetPerformanceCounter();
 
-    ticks = SDL_GetTicks();
+    if (basecounter == 0)
+    {
+        basecounter = counter;
+        counterfreq = SDL_GetPerformanceFrequency();
+    }
 
-    if (basetime == 0)
-        basetime = ticks;
+    counter -= basecounter;
 
-    ticks -= basetime;
+    // Split to avoid overflowing when the counter runs in ns.
+    return (counter / counterfreq) * 1000000
+         + ((counter % counterfreq) * 1000000) / counterfreq;
+}
+
+//
+// I_GetTime
+// returns time in 1/35th second tics
+//
 
-    return (ticks * TICRATE) / 1000;    
+int  I_GetTime (void)
+{
+    return (GetElapsedUS() * TICRATE) / 1000000;
 }
 
 //
@@ -48,14 +80,17 @@ int  I_GetTime (void)
 
 int I_GetTimeMS(void)
 {
-    Uint32 ticks;
-
-    ticks = SDL_GetTicks();
+    return GetElapsedUS() / 1000;
+}
 
-    if (basetime == 0)
-        basetime = ticks;
+//
+// High resolution time in microseconds, from the same origin as
+// I_GetTimeMS.
+//
 
-    return ticks - basetime;
+uint64_t I_GetTimeUS(void)
+{
+    return GetElapsedUS();
 }
 
 // Sleep for a specified number of ms
@@ -65,6 +100,67 @@ void I_Sleep(int ms)
     SDL_Delay(ms);
 }
 
+// Sleep for a specified number of microseconds.  This may still
+// oversleep, but by far less than SDL_Delay, which can only sleep for
+// whole milliseconds and on some systems rounds up to the scheduler
+// quantum.
+
+static void SleepUS(uint64_t us)
+{
+#ifdef _WIN32
+    LARGE_INTEGER due;
+
+    // Round up: a sleep of under a millisecond would otherwise become
+    // no sleep at all, and I_SleepUntilUS would spin instead.
+
+    if (sleep_timer == NULL)
+    {
+        SDL_Delay((Uint32) ((us + 999) / 1000));
+        return;
+    }
+
+    // Relative time, in units of 100ns.
+
+    due.QuadPart = -(LONGLONG) (us * 10);
+
+    if (SetWaitableTimer(sleep_timer, &due, 0, NULL, NULL, FALSE))
+    {
+        WaitForSingleObject(sleep_timer, INFINITE);
+    }
+#else
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Sleep until the given time (from I_GetTimeUS).  The last spin_us
+// microseconds are busy-waited rather than slept, to avoid waking up
+// late at the cost of CPU time.
+
+void I_SleepUntilUS(uint64_t deadline, unsigned int spin_us)
+{
+    uint64_t now;
+
+    for (;;)
+    {
+        now = I_GetTimeUS();
+
+        if (now >= deadline)
+        {
+            break;
+        }
+
+        if (deadline - now > spin_us)
+        {
+            SleepUS(deadline - now - spin_us);
+        }
+    }
+}
+
 void I_WaitVBL(int count)
 {
     I_Sleep((count * 1000) / 70);
@@ -78,5 +174,16 @@ void I_InitTimer(void)
     SDL_SetHint(SDL_HINT_WINDOWS_DISABLE_THREAD_NAMING, "1");
 
     SDL_Init(SDL_INIT_TIMER);
+
+#if defined(_WIN32) && defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+    // Only available on Windows 10 1803 and later; otherwise SleepUS
+    // falls back to SDL_Delay.
+
+    if (sleep_timer == NULL)
+    {
+        sleep_timer = CreateWaitableTimerExW(NULL, NULL,
+            CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    }
+#endif
 }
 
@@ -20,6 +20,8 @@
 #ifndef __I_TIMER__
 #define __I_TIMER__
 
+#include "doomtype.h"
+
 #define TICRATE 35
 
 // Called by D_DoomLoop,
@@ -29,9 +31,16 @@ int I_GetTime (void);
 // returns current time in ms
 int I_GetTimeMS (void);
 
+// returns current time in microseconds
+uint64_t I_GetTimeUS (void);
+
 // Pause for a specified number of ms
 void I_Sleep(int ms);
 
+// Pause until the specified time from I_GetTimeUS, busy-waiting
+// for the last spin_us microseconds
+void I_SleepUntilUS(uint64_t deadline, unsigned int spin_us);
+
 // Initialize timer
 void I_InitTimer(void);
 
@@ -34,6 +34,7 @@
 #include "d_loop.h"
 #include "deh_str.h"
 #include "doomtype.h"
+#include "i_capture.h"
 #include "i_input.h"
 #include "i_joystick.h"
 #include "i_system.h"
@@ -703,6 +704,10 @@ void I_FinishUpdate (void)
     if (!initialized)
         return;
 
+    // Capture the frame before the disk icon or FPS dots are drawn.
+
+    I_CaptureFrame(I_VideoBuffer, palette);
+
     if (noblit)
         return;
 
@@ -1119,6 +1124,14 @@ static void SetSDLVideoDriver(void)
         putenv(env_string);
         free(env_string);
     }
+    else if (M_ParmExists("-noblit") && I_CaptureRequested()
+          && getenv("SDL_VIDEODRIVER") == NULL)
+    {
+        // When capturing with -noblit nothing is shown on screen, so
+        // use the dummy driver to allow running without a display.
+
+        putenv("SDL_VIDEODRIVER=dummy");
+    }
 }
 
 // Check the display bounds of the display referred to by 'video_display' and
@@ -1494,6 +1507,8 @@ void I_InitGraphics(void)
   
     while (SDL_PollEvent(&dummy));
 
+    I_InitCapture();
+
     initialized = true;
 
     // Call I_ShutdownGraphics on quit
@@ -0,0 +1,176 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Hash table mapping IPv4 host:port pairs to net_addr_t structures,
+//     for the network modules.
+//
+
+#include <string.h>
+
+#include "net_addrtable.h"
+#include "z_zone.h"
+
+// Must be a power of two.
+
+#define INITIAL_TABLE_SIZE 64
+
+static unsigned int HashAddress(uint32_t host, uint16_t port)
+{
+    uint32_t hash;
+
+    hash = host * 0x9e3779b1u ^ port * 0x85ebca77u;
+
+    return hash ^ (hash >> 16);
+}
+
+// Returns the slot holding the given address, or the empty slot where
+// it would go.
+
+static net_addrslot_t *FindSlot(net_addrtable_t *table,
+                                uint32_t host, uint16_t port)
+{
+    net_addrslot_t *slot;
+    unsigned int i;
+
+    i = HashAddress(host, port) & (table->size - 1);
+
+    for (;;)
+    {
+        slot = &table->slots[i];
+
+        if (slot->addr == NULL
+         || (slot->host == host && slot->port == port))
+        {
+            return slot;
+        }
+
+        i = (i + 1) & (table->size - 1);
+    }
+}
+
+static void Resize(net_addrtable_t *table, unsigned int new_size)
+{
+    net_addrslot_t *old_slots;
+    unsigned int old_size;
+    unsigned int i;
+
+    old_slots = table->slots;
+    old_size = table->size;
+
+    table->size = new_size;
+    table->slots = Z_Malloc(sizeof(net_addrslot_t) * new_size, PU_STATIC, 0);
+    memset(table->slots, 0, sizeof(net_addrslot_t) * new_size);
+
+    for (i = 0; i < old_size; ++i)
+    {
+        if (old_slots[i].addr != NULL)
+        {
+            *FindSlot(table, old_slots[i].host, old_slots[i].port)
+                = old_slots[i];
+        }
+    }
+
+    if (old_slots != NULL)
+    {
+        Z_Free(old_slots);
+    }
+}
+
+void NET_AddrTable_Init(net_addrtable_t *table)
+{
+    table->slots = NULL;
+    table->size = 0;
+    table->count = 0;
+
+    Resize(table, INITIAL_TABLE_SIZE);
+}
+
+net_addr_t *NET_AddrTable_Find(net_addrtable_t *table,
+                               uint32_t host, uint16_t port)
+{
+    return FindSlot(table, host, port)->addr;
+}
+
+// The address must not already be in the table.
+
+void NET_AddrTable_Add(net_addrtable_t *table,
+                       uint32_t host, uint16_t port, net_addr_t *addr)
+{
+    net_addrslot_t *slot;
+
+    // Keep the table at most half full, so that probe runs stay short.
+
+    if ((table->count + 1) * 2 > table->size)
+    {
+        Resize(table, table->size * 2);
+    }
+
+    slot = FindSlot(table, host, port);
+    slot->host = host;
+    slot->port = port;
+    slot->addr = addr;
+
+    ++table->count;
+}
+
+// Returns false if the address was not in the table.
+
+boolean NET_AddrTable_Remove(net_addrtable_t *table,
+                             uint32_t host, uint16_t port)
+{
+    net_addrslot_t *slot;
+    unsigned int hole, i, home;
+
+    slot = FindSlot(table, host, port);
+
+    if (slot->addr == NULL)
+    {
+        return false;
+    }
+
+    // Rather than leaving a tombstone, move back any later entries in
+    // the same probe run that can now sit closer to their home slot.
+
+    hole = slot - table->slots;
+    i = hole;
+
+    for (;;)
+    {
+        i = (i + 1) & (table->size - 1);
+
+        if (table->slots[i].addr == NULL)
+        {
+            break;
+        }
+
+        home = HashAddress(table->slots[i].host, table->slots[i].port)
+             & (table->size - 1);
+
+        // Can the entry at i move to the hole?  Only if its home slot
+        // is not in the (cyclic) range hole < home <= i.
+
+        if (((i - home) & (table->size - 1))
+         >= ((i - hole) & (table->size - 1)))
+        {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+
+    table->slots[hole].addr = NULL;
+    --table->count;
+
+    return true;
+}
+
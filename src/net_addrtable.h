@@ -0,0 +1,51 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Hash table mapping IPv4 host:port pairs to net_addr_t structures,
+//     for the network modules.
+//
+
+#ifndef NET_ADDRTABLE_H
+#define NET_ADDRTABLE_H
+
+#include "net_defs.h"
+
+typedef struct
+{
+    uint32_t host;
+    uint16_t port;
+    net_addr_t *addr;
+} net_addrslot_t;
+
+// Open addressing with linear probing.  The host and port are used
+// only as a key, so they can be in either byte order, as long as the
+// same one is always used.
+
+typedef struct
+{
+    net_addrslot_t *slots;
+    unsigned int size;
+    unsigned int count;
+} net_addrtable_t;
+
+void NET_AddrTable_Init(net_addrtable_t *table);
+net_addr_t *NET_AddrTable_Find(net_addrtable_t *table,
+                               uint32_t host, uint16_t port);
+void NET_AddrTable_Add(net_addrtable_t *table,
+                       uint32_t host, uint16_t port, net_addr_t *addr);
+boolean NET_AddrTable_Remove(net_addrtable_t *table,
+                             uint32_t host, uint16_t port);
+
+#endif /* #ifndef NET_ADDRTABLE_H */
+
@@ -0,0 +1,211 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Checks the network address hash table against a plain array,
+//     with thousands of made up peers, and times lookups against the
+//     linear scan that it replaced.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "net_addrtable.h"
+#include "z_zone.h"
+
+#define NUM_PEERS 8192
+#define NUM_OPERATIONS 1000000
+#define NUM_LOOKUPS 10000000
+#define NUM_SCAN_LOOKUPS 100000
+
+typedef struct
+{
+    uint32_t host;
+    uint16_t port;
+    net_addr_t addr;
+    boolean present;
+} peer_t;
+
+static peer_t peers[NUM_PEERS];
+
+void *Z_Malloc2(int size, int tag, void *ptr, const char *file, int line)
+{
+    return malloc(size);
+}
+
+void Z_Free(void *ptr)
+{
+    free(ptr);
+}
+
+static void MakePeers(void)
+{
+    int i;
+
+    // Lots of peers behind the same few hosts, as with NAT, and a few
+    // hosts with lots of ports, as with a load generator.
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            peers[i].host = 0x0a000000 | i;
+            peers[i].port = (uint16_t) rand();
+        }
+        else
+        {
+            peers[i].host = 0x7f000001 + (i % 4);
+            peers[i].port = (uint16_t) (1024 + i);
+        }
+        peers[i].present = false;
+    }
+}
+
+static int CheckTable(void)
+{
+    net_addrtable_t table;
+    unsigned int count = 0;
+    peer_t *peer;
+    int i;
+
+    NET_AddrTable_Init(&table);
+
+    for (i = 0; i < NUM_OPERATIONS; ++i)
+    {
+        peer = &peers[rand() % NUM_PEERS];
+
+        if (NET_AddrTable_Find(&table, peer->host, peer->port)
+         != (peer->present ? &peer->addr : NULL))
+        {
+            printf("Lookup %i gave the wrong result\n", i);
+            return 0;
+        }
+
+        if (!peer->present)
+        {
+            NET_AddrTable_Add(&table, peer->host, peer->port, &peer->addr);
+            peer->present = true;
+            ++count;
+        }
+        else if (rand() % 2 == 0)
+        {
+            if (!NET_AddrTable_Remove(&table, peer->host, peer->port))
+            {
+                printf("Remove %i failed\n", i);
+                return 0;
+            }
+            peer->present = false;
+            --count;
+        }
+
+        if (table.count != count)
+        {
+            printf("Count is %u after operation %i, expected %u\n",
+                   table.count, i, count);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        if (NET_AddrTable_Find(&table, peers[i].host, peers[i].port)
+         != (peers[i].present ? &peers[i].addr : NULL))
+        {
+            printf("Peer %i is wrong at the end\n", i);
+            return 0;
+        }
+    }
+
+    printf("%i operations on %i peers checked\n", NUM_OPERATIONS, NUM_PEERS);
+
+    return 1;
+}
+
+static double NsPerLookup(clock_t start, int lookups)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / lookups;
+}
+
+static void Benchmark(void)
+{
+    net_addrtable_t table;
+    net_addr_t *found = NULL;
+    clock_t start;
+    peer_t *peer;
+    int i, j;
+
+    NET_AddrTable_Init(&table);
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        if (NET_AddrTable_Find(&table, peers[i].host, peers[i].port) == NULL)
+        {
+            NET_AddrTable_Add(&table, peers[i].host, peers[i].port,
+                              &peers[i].addr);
+        }
+    }
+
+    start = clock();
+
+    for (i = 0; i < NUM_LOOKUPS; ++i)
+    {
+        peer = &peers[((unsigned int) i * 7919) % NUM_PEERS];
+        found = NET_AddrTable_Find(&table, peer->host, peer->port);
+    }
+
+    printf("hash table: %.1f ns per lookup\n",
+           NsPerLookup(start, NUM_LOOKUPS));
+
+    start = clock();
+
+    for (i = 0; i < NUM_SCAN_LOOKUPS; ++i)
+    {
+        peer = &peers[((unsigned int) i * 7919) % NUM_PEERS];
+
+        for (j = 0; j < NUM_PEERS; ++j)
+        {
+            if (peers[j].host == peer->host && peers[j].port == peer->port)
+            {
+                found = &peers[j].addr;
+                break;
+            }
+        }
+    }
+
+    printf("linear scan: %.1f ns per lookup\n",
+           NsPerLookup(start, NUM_SCAN_LOOKUPS));
+
+    // Keep the lookups from being optimized away.
+
+    if (found == NULL)
+    {
+        printf("?\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    srand(1234);
+    MakePeers();
+
+    if (!CheckTable())
+    {
+        return 1;
+    }
+
+    Benchmark();
+
+    return 0;
+}
+
@@ -40,6 +40,7 @@
 #include "net_server.h"
 #include "net_structrw.h"
 #include "net_petname.h"
+#include "net_window.h"
 #include "w_checksum.h"
 #include "w_wad.h"
 
@@ -60,46 +61,6 @@ typedef enum
 
 } net_clientstate_t;
 
-// Type of structure used in the receive window
-
-typedef struct
-{
-    // Whether this tic has been received yet
-
-    boolean active;
-
-    // Last time we sent a resend request for this tic
-
-    unsigned int resend_time;
-
-    // Tic data from server
-
-    net_full_ticcmd_t cmd;
-
-} net_server_recv_t;
-
-// Type of structure used in the send window
-
-typedef struct
-{
-    // Whether this slot is active yet
-
-    boolean active;
-
-    // The tic number
-
-    unsigned int seq;
-
-    // Time the command was generated
-
-    unsigned int time;
-
-    // Ticcmd diff
-
-    net_ticdiff_t cmd;
-} net_server_send_t;
-
-
 static net_connection_t client_connection;
 static net_clientstate_t client_state;
 static net_addr_t *server_addr;
@@ -134,31 +95,14 @@ char *net_player_name = NULL;
 
 boolean drone = false;
 
-// The last ticcmd constructed
-
-static ticcmd_t last_ticcmd;
+// Ticcmds sent to the server, and tics received back
 
-// Buffer of ticcmd diffs being sent to the server
+static net_window_t client_window;
 
-static net_server_send_t send_queue[BACKUPTICS];
-
-// Receive window
+// The last ticcmd received for each player, that the next tic's
+// diffs are applied to.
 
 static ticcmd_t recvwindow_cmd_base[NET_MAXPLAYERS];
-static int recvwindow_start;
-static net_server_recv_t recvwindow[BACKUPTICS];
-
-// Whether we need to send an acknowledgement and
-// when gamedata was last received.
-
-static boolean need_to_acknowledge;
-static unsigned int gamedata_recv_time;
-
-// The latency (time between when we sent our command and we got all
-// the other players' commands from the server) for the last tic we
-// received. We include this latency in tics we send to the server so
-// that they can adjust to us.
-static int last_latency;
 
 // Hash checksums of our wad directory and dehacked data.
 
@@ -169,8 +113,6 @@ sha1_digest_t net_local_deh_sha1sum;
 
 unsigned int net_local_is_freedoom;
 
-#define NET_CL_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
-
 // Called when we become disconnected from the server
 
 static void NET_CL_Disconnected(void)
@@ -181,27 +123,11 @@ static void NET_CL_Disconnected(void)
 // Called when a packet is received from the server containing game
 // data. This updates the clock synchronization variable (offsetms)
 // using a PID filter that keeps client clocks in sync.
-static void UpdateClockSync(unsigned int seq,
-                            unsigned int remote_latency)
+static void UpdateClockSync(net_window_t *window, int latency,
+                            int remote_latency)
 {
     static int last_error, cumul_error;
-    int latency, error;
-
-    if (seq == send_queue[seq % BACKUPTICS].seq)
-    {
-        latency = I_GetTimeMS() - send_queue[seq % BACKUPTICS].time;
-    }
-    else if (seq > send_queue[seq % BACKUPTICS].seq)
-    {
-        // We have received the ticcmd from the server before we have
-        // even sent ours
-
-        latency = 0;
-    }
-    else
-    {
-        return;
-    }
+    int error;
 
     // PID filter. These are manually trained parameters.
 #define KP 0.1
@@ -217,7 +143,6 @@ static void UpdateClockSync(unsigned int seq,
              + (KD * FRACUNIT) * (last_error - error);
 
     last_error = error;
-    last_latency = latency;
 
     NET_Log("client: latency %d, remote %d -> offset=%dms, cumul_error=%d",
             latency, remote_latency, offsetms / FRACUNIT, cumul_error);
@@ -260,30 +185,17 @@ static void NET_CL_ExpandFullTiccmd(net_full_ticcmd_t *cmd, unsigned int seq,
     }
 }
 
-// Advance the receive window
+// Called as the receive window moves past each tic
 
-static void NET_CL_AdvanceWindow(void)
+static void NET_CL_RunTic(net_window_t *window, net_full_ticcmd_t *cmd,
+                          unsigned int seq)
 {
     ticcmd_t ticcmds[NET_MAXPLAYERS];
 
-    while (recvwindow[0].active)
-    {
-        // Expand tic diff data into d_net.c structures
-
-        NET_CL_ExpandFullTiccmd(&recvwindow[0].cmd, recvwindow_start,
-                                ticcmds);
-        D_ReceiveTic(ticcmds, recvwindow[0].cmd.playeringame);
-
-        // Advance the window
-
-        memmove(recvwindow, recvwindow + 1,
-                sizeof(net_server_recv_t) * (BACKUPTICS - 1));
-        memset(&recvwindow[BACKUPTICS-1], 0, sizeof(net_server_recv_t));
+    // Expand tic diff data into d_net.c structures
 
-        ++recvwindow_start;
-
-        NET_Log("client: advanced receive window to %d", recvwindow_start);
-    }
+    NET_CL_ExpandFullTiccmd(cmd, seq, ticcmds);
+    D_ReceiveTic(ticcmds, cmd->playeringame);
 }
 
 // Shut down the client code, etc.  Invoked after a disconnect.
@@ -309,10 +221,6 @@ void NET_CL_StartGame(net_gamesettings_t *settings)
 {
     net_packet_t *packet;
 
-    // Start from a ticcmd of all zeros
-
-    memset(&last_ticcmd, 0, sizeof(ticcmd_t));
-    
     // Send packet
 
     packet = NET_Conn_NewReliable(&client_connection, 
@@ -321,27 +229,10 @@ void NET_CL_StartGame(net_gamesettings_t *settings)
     NET_WriteSettings(packet, settings);
 }
 
-static void NET_CL_SendGameDataACK(void)
-{
-    net_packet_t *packet;
-
-    packet = NET_NewPacket(10);
-
-    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
-    NET_WriteInt8(packet, recvwindow_start & 0xff);
-
-    NET_Conn_SendPacket(&client_connection, packet);
-
-    NET_FreePacket(packet);
-
-    need_to_acknowledge = false;
-}
+// Add a new ticcmd to the send queue
 
-static void NET_CL_SendTics(int start, int end)
+void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
 {
-    net_packet_t *packet;
-    int i;
-
     if (!net_client_connected)
     {
         // Disconnected from server
@@ -349,80 +240,7 @@ static void NET_CL_SendTics(int start, int end)
         return;
     }
 
-    if (start < 0)
-        start = 0;
-    
-    // Build a new packet to send to the server
-
-    packet = NET_NewPacket(512);
-    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
-
-    // Write the start tic and number of tics.  Send only the low byte
-    // of start - it can be inferred by the server.
-
-    NET_WriteInt8(packet, recvwindow_start & 0xff);
-    NET_WriteInt8(packet, start & 0xff);
-    NET_WriteInt8(packet, end - start + 1);
-
-    // Add the tics.
-
-    for (i=start; i<=end; ++i)
-    {
-        net_server_send_t *sendobj;
-
-        sendobj = &send_queue[i % BACKUPTICS];
-
-        NET_WriteInt16(packet, last_latency);
-
-        NET_WriteTiccmdDiff(packet, &sendobj->cmd, settings.lowres_turn);
-    }
-    
-    // Send the packet
-
-    NET_Conn_SendPacket(&client_connection, packet);
-    
-    // All done!
-
-    NET_FreePacket(packet);
-
-    // Acknowledgement has been sent as part of the packet
-
-    need_to_acknowledge = false;
-}
-
-// Add a new ticcmd to the send queue
-
-void NET_CL_SendTiccmd(ticcmd_t *ticcmd, int maketic)
-{
-    net_ticdiff_t diff;
-    net_server_send_t *sendobj;
-    int starttic, endtic;
-    
-    // Calculate the difference to the last ticcmd
-
-    NET_TiccmdDiff(&last_ticcmd, ticcmd, &diff);
-    
-    // Store in the send queue
-
-    sendobj = &send_queue[maketic % BACKUPTICS];
-    sendobj->active = true;
-    sendobj->seq = maketic;
-    sendobj->time = I_GetTimeMS();
-    sendobj->cmd = diff;
-
-    last_ticcmd = *ticcmd;
-
-    // Send to server.
-
-    starttic = maketic - settings.extratics;
-    endtic = maketic;
-
-    if (starttic < 0)
-        starttic = 0;
-
-    NET_Log("client: generated tic %d, sending %d-%d",
-            maketic, starttic, endtic);
-    NET_CL_SendTics(starttic, endtic);
+    NET_Window_SendTiccmd(&client_window, ticcmd, maketic);
 }
 
 // Parse a SYN packet received back from the server indicating a successful
@@ -597,269 +415,29 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
     NET_Log("client: beginning game state");
     client_state = CLIENT_STATE_IN_GAME;
 
-    // Clear the receive window
+    // Clear the send queue and receive window
 
-    memset(recvwindow, 0, sizeof(recvwindow));
-    recvwindow_start = 0;
+    NET_Window_Init(&client_window, &client_connection, &settings);
     memset(&recvwindow_cmd_base, 0, sizeof(recvwindow_cmd_base));
-
-    // Clear the send queue
-
-    memset(&send_queue, 0x00, sizeof(send_queue));
-}
-
-static void NET_CL_SendResendRequest(int start, int end)
-{
-    net_packet_t *packet;
-    unsigned int nowtime;
-    int i;
-
-    //printf("CL: Send resend %i-%i\n", start, end);
-    
-    packet = NET_NewPacket(64);
-    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_RESEND);
-    NET_WriteInt32(packet, start);
-    NET_WriteInt8(packet, end - start + 1);
-    NET_Conn_SendPacket(&client_connection, packet);
-    NET_FreePacket(packet);
-
-    nowtime = I_GetTimeMS();
-
-    // Save the time we sent the resend request
-
-    for (i=start; i<=end; ++i)
-    {
-        int index;
-
-        index = i - recvwindow_start;
-
-        if (index < 0 || index >= BACKUPTICS)
-            continue;
-
-        recvwindow[index].resend_time = nowtime;
-    }
 }
 
-// Check for expired resend requests
-
-static void NET_CL_CheckResends(void)
-{
-    int i;
-    int resend_start, resend_end;
-    unsigned int nowtime;
-    boolean maybe_deadlocked;
-
-    nowtime = I_GetTimeMS();
-    maybe_deadlocked = nowtime - gamedata_recv_time > 1000;
-
-    resend_start = -1;
-    resend_end = -1;
-
-    for (i=0; i<BACKUPTICS; ++i)
-    {
-        net_server_recv_t *recvobj;
-        boolean need_resend;
-
-        recvobj = &recvwindow[i];
-
-        // if need_resend is true, this tic needs another retransmit
-        // request (300ms timeout)
-
-        need_resend = !recvobj->active
-                   && recvobj->resend_time != 0
-                   && nowtime > recvobj->resend_time + 300;
-
-        // if no game data has been received in a long time, we may be in
-        // a deadlock scenario where tics from the server have been lost, so
-        // we've stopped generating any more, so the server isn't sending us
-        // any, so we don't get any to trigger a resend request. So force the
-        // first few tics in the receive window to be requested.
-        if (i == 0 && !recvobj->active && recvobj->resend_time == 0
-         && maybe_deadlocked)
-        {
-            need_resend = true;
-        }
-
-        if (need_resend)
-        {
-            // Start a new run of resend tics?
-
-            if (resend_start < 0)
-            {
-                resend_start = i;
-            }
-
-            resend_end = i;
-        }
-        else if (resend_start >= 0)
-        {
-            // End of a run of resend tics
-            NET_Log("client: resend request timed out for %d-%d (%d)",
-                    recvwindow_start + resend_start,
-                    recvwindow_start + resend_end,
-                    recvwindow[resend_start].resend_time);
-            NET_CL_SendResendRequest(recvwindow_start + resend_start,
-                                     recvwindow_start + resend_end);
-            resend_start = -1;
-        }
-    }
-
-    if (resend_start >= 0)
-    {
-        NET_Log("client: resend request timed out for %d-%d (%d)",
-                recvwindow_start + resend_start,
-                recvwindow_start + resend_end,
-                recvwindow[resend_start].resend_time);
-        NET_CL_SendResendRequest(recvwindow_start + resend_start,
-                                 recvwindow_start + resend_end);
-    }
-
-    // We have received some data from the server and not acknowledged
-    // it yet.  Normally this gets acknowledged when we send our game
-    // data, but if the client is a drone we need to do this.
-
-    if (need_to_acknowledge && nowtime - gamedata_recv_time > 200)
-    {
-        NET_Log("client: no game data received since %d: triggering ack",
-                gamedata_recv_time);
-        NET_CL_SendGameDataACK();
-    }
-}
-
-
-// Parsing of NET_PACKET_TYPE_GAMEDATA packets
-// (packets containing the actual ticcmd data)
+// Game data and resend requests are only for games in progress.
 
 static void NET_CL_ParseGameData(net_packet_t *packet)
 {
-    net_server_recv_t *recvobj;
-    unsigned int seq, num_tics;
-    unsigned int nowtime;
-    int resend_start, resend_end;
-    size_t i;
-    int index;
-
-    NET_Log("client: processing game data packet");
-
-    // Read header
-    if (!NET_ReadInt8(packet, &seq)
-     || !NET_ReadInt8(packet, &num_tics))
-    {
-        NET_Log("client: error: failed to read header");
-        return;
-    }
-
-    nowtime = I_GetTimeMS();
-
-    // Whatever happens, we now need to send an acknowledgement of our
-    // current receive point.
-
-    if (!need_to_acknowledge)
-    {
-        need_to_acknowledge = true;
-        gamedata_recv_time = nowtime;
-    }
-
-    // Expand byte value into the full tic number
-    seq = NET_CL_ExpandTicNum(seq);
-    NET_Log("client: got game data, seq=%d, num_tics=%d", seq, num_tics);
-
-    for (i=0; i<num_tics; ++i)
+    if (client_state != CLIENT_STATE_IN_GAME)
     {
-        net_full_ticcmd_t cmd;
-
-        index = seq - recvwindow_start + i;
-
-        if (!NET_ReadFullTiccmd(packet, &cmd, settings.lowres_turn))
-        {
-            NET_Log("client: error: failed to read ticcmd %d", i);
-            return;
-        }
-
-        if (index < 0 || index >= BACKUPTICS)
-        {
-            // Out of range of the recv window
-
-            continue;
-        }
-
-        // Store in the receive window
-
-        recvobj = &recvwindow[index];
-
-        recvobj->active = true;
-        recvobj->cmd = cmd;
-        NET_Log("client: stored tic %d in receive window", seq + i);
-
-        // If a packet is lost or arrives out of order, we might get
-        // the tic in the next packet instead (because of extratic).
-        // If that's the case then the latency for receiving that tic
-        // now will be bogus. So we only use the last tic in the packet
-        // to trigger a clock sync update.
-        if (i == num_tics - 1)
-        {
-            UpdateClockSync(seq + i, cmd.latency);
-        }
-    }
-
-    // Has this been received out of sequence, ie. have we not received
-    // all tics before the first tic in this packet?  If so, send a 
-    // resend request.
-
-    //printf("CL: %p: %i\n", client, seq);
-
-    resend_end = seq - recvwindow_start;
-
-    if (resend_end <= 0)
+        NET_Log("client: error: game data but not in game");
         return;
-
-    if (resend_end >= BACKUPTICS)
-        resend_end = BACKUPTICS - 1;
-
-    index = resend_end - 1;
-    resend_start = resend_end;
-    
-    while (index >= 0)
-    {
-        recvobj = &recvwindow[index];
-
-        if (recvobj->active)
-        {
-            // ended our run of unreceived tics
-
-            break;
-        }
-
-        if (recvobj->resend_time != 0)
-        {
-            // Already sent a resend request for this tic
-
-            break;
-        }
-
-        resend_start = index;
-        --index;
     }
 
-    // Possibly send a resend request
-    if (resend_start < resend_end)
-    {
-        NET_Log("client: request resend for %d-%d before %d",
-                recvwindow_start + resend_start,
-                recvwindow_start + resend_end - 1, seq);
-        NET_CL_SendResendRequest(recvwindow_start + resend_start, 
-                                 recvwindow_start + resend_end - 1);
-    }
+    NET_Window_ParseGameData(&client_window, packet);
 }
 
 // Parse a resend request from the server due to a dropped packet
 
 static void NET_CL_ParseResendRequest(net_packet_t *packet)
 {
-    static unsigned int start;
-    static unsigned int end;
-    static unsigned int num_tics;
-
     NET_Log("client: processing resend request");
 
     if (drone)
@@ -869,45 +447,13 @@ static void NET_CL_ParseResendRequest(net_packet_t *packet)
         return;
     }
 
-    if (!NET_ReadInt32(packet, &start)
-     || !NET_ReadInt8(packet, &num_tics))
+    if (client_state != CLIENT_STATE_IN_GAME)
     {
-        NET_Log("client: error: couldn't read start and num_tics");
+        NET_Log("client: error: resend request but not in game");
         return;
     }
 
-    end = start + num_tics - 1;
-
-    //printf("requested resend %i-%i .. ", start, end);
-    NET_Log("client: resend request: start=%d, num_tics=%d", start, num_tics);
-
-    // Check we have the tics being requested.  If not, reduce the 
-    // window of tics to only what we have.
-
-    while (start <= end
-        && (!send_queue[start % BACKUPTICS].active
-         || send_queue[start % BACKUPTICS].seq != start))
-    {
-        ++start;
-    }
-     
-    while (start <= end
-        && (!send_queue[end % BACKUPTICS].active
-         || send_queue[end % BACKUPTICS].seq != end))
-    {
-        --end;
-    }
-
-    // Resend those tics
-    if (start <= end)
-    {
-        NET_Log("client: resending %d-%d", start, end);
-        NET_CL_SendTics(start, end);
-    }
-    else
-    {
-        NET_Log("client: don't have the tics to resend");
-    }
+    NET_Window_ParseResendRequest(&client_window, packet);
 }
 
 // Console message that the server wants the client to print
@@ -1031,13 +577,7 @@ void NET_CL_Run(void)
 
     if (client_state == CLIENT_STATE_IN_GAME)
     {
-        // Possibly advance the receive window
-
-        NET_CL_AdvanceWindow();
-
-        // Check if our resend requests have timed out
-
-        NET_CL_CheckResends();
+        NET_Window_Run(&client_window);
     }
 }
 
@@ -1215,6 +755,9 @@ void NET_CL_Init(void)
     {
         net_player_name = NET_GetRandomPetName();
     }
+
+    client_window.RunTic = NET_CL_RunTic;
+    client_window.ClockSync = UpdateClockSync;
 }
 
 void NET_Init(void)
@@ -62,6 +62,10 @@ static void NET_Conn_Init(net_connection_t *conn, net_addr_t *addr,
     conn->reliable_send_seq = 0;
     conn->reliable_recv_seq = 0;
     conn->keepalive_recv_time = I_GetTimeMS();
+    conn->packets_sent = 0;
+    conn->bytes_sent = 0;
+    conn->packets_recv = 0;
+    conn->bytes_recv = 0;
 }
 
 // Initialize as a client connection
@@ -89,6 +93,8 @@ void NET_Conn_InitServer(net_connection_t *conn, net_addr_t *addr,
 void NET_Conn_SendPacket(net_connection_t *conn, net_packet_t *packet)
 {
     conn->keepalive_send_time = I_GetTimeMS();
+    ++conn->packets_sent;
+    conn->bytes_sent += packet->len;
     NET_SendPacket(conn->addr, packet);
 }
 
@@ -220,6 +226,8 @@ boolean NET_Conn_Packet(net_connection_t *conn, net_packet_t *packet,
                         unsigned int *packet_type)
 {
     conn->keepalive_recv_time = I_GetTimeMS();
+    ++conn->packets_recv;
+    conn->bytes_recv += packet->len;
 
     // Is this a reliable packet?
 
@@ -368,6 +376,73 @@ void NET_Conn_Run(net_connection_t *conn)
     }
 }
 
+// Shorten *timeout (in ms) if necessary so that it expires no later
+// than the time 'when'.
+
+void NET_WakeBy(int *timeout, unsigned int nowtime, unsigned int when)
+{
+    int remaining;
+
+    remaining = (int) (when - nowtime);
+
+    if (remaining < 0)
+    {
+        remaining = 0;
+    }
+
+    if (remaining < *timeout)
+    {
+        *timeout = remaining;
+    }
+}
+
+// Shorten *timeout so that it expires by the time that NET_Conn_Run
+// next has something to do for this connection.  The +1s are because
+// NET_Conn_Run only acts once a period has strictly passed.
+
+void NET_Conn_NextTimeout(net_connection_t *conn, int *timeout)
+{
+    unsigned int nowtime;
+
+    nowtime = I_GetTimeMS();
+
+    if (conn->state == NET_CONN_STATE_CONNECTED)
+    {
+        NET_WakeBy(timeout, nowtime,
+                   conn->keepalive_recv_time + CONNECTION_TIMEOUT_LEN * 1000 + 1);
+        NET_WakeBy(timeout, nowtime,
+                   conn->keepalive_send_time + KEEPALIVE_PERIOD * 1000 + 1);
+
+        if (conn->reliable_packets != NULL)
+        {
+            if (conn->reliable_packets->last_send_time < 0)
+            {
+                *timeout = 0;
+            }
+            else
+            {
+                NET_WakeBy(timeout, nowtime,
+                           conn->reliable_packets->last_send_time + 1001);
+            }
+        }
+    }
+    else if (conn->state == NET_CONN_STATE_DISCONNECTING)
+    {
+        if (conn->last_send_time < 0)
+        {
+            *timeout = 0;
+        }
+        else
+        {
+            NET_WakeBy(timeout, nowtime, conn->last_send_time + 1001);
+        }
+    }
+    else if (conn->state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        NET_WakeBy(timeout, nowtime, conn->last_send_time + 5001);
+    }
+}
+
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type)
 {
     net_packet_t *packet;
@@ -79,6 +79,12 @@ typedef struct
     net_reliable_packet_t *reliable_packets;
     int reliable_send_seq;
     int reliable_recv_seq;
+
+    // Traffic counters, for statistics.
+    unsigned int packets_sent;
+    unsigned int bytes_sent;
+    unsigned int packets_recv;
+    unsigned int bytes_recv;
 } net_connection_t;
 
 
@@ -91,9 +97,11 @@ boolean NET_Conn_Packet(net_connection_t *conn, net_packet_t *packet,
                         unsigned int *packet_type);
 void NET_Conn_Disconnect(net_connection_t *conn);
 void NET_Conn_Run(net_connection_t *conn);
+void NET_Conn_NextTimeout(net_connection_t *conn, int *timeout);
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type);
 
 // Other miscellaneous common functions
+void NET_WakeBy(int *timeout, unsigned int nowtime, unsigned int when);
 unsigned int NET_ExpandTicNum(unsigned int relative, unsigned int b);
 boolean NET_ValidGameSettings(GameMode_t mode, GameMission_t mission,
                               net_gamesettings_t *settings);
@@ -18,14 +18,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "config.h"
 #include "doomtype.h"
 
 #include "i_system.h"
-#include "i_timer.h"
 
 #include "m_argv.h"
 
 #include "net_common.h"
+#include "net_mmsg.h"
+#include "net_relay.h"
 #include "net_sdl.h"
 #include "net_server.h"
 
@@ -63,18 +65,96 @@ static void CheckForClientOptions(void)
 
 void NET_DedicatedServer(void)
 {
+    net_module_t *module;
+    boolean (*wait_for_packet)(int timeout);
+    int max_sessions;
+    int p;
+
     CheckForClientOptions();
 
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // When running a dedicated server, host up to <n> games at once,
+    // all on the same port.  A new client joins a game that is still
+    // waiting to be launched and has room, or else starts a new one.
+    //
+
+    p = M_CheckParmWithArgs("-sessions", 1);
+
+    if (p > 0)
+    {
+        max_sessions = atoi(myargv[p + 1]);
+
+        if (max_sessions < 1)
+        {
+            I_Error("Invalid number of sessions: '%s'", myargv[p + 1]);
+        }
+    }
+    else
+    {
+        max_sessions = 1;
+    }
+
+    module = &net_sdl_module;
+    wait_for_packet = NET_SDL_WaitForPacket;
+
+    //!
+    // @category net
+    // @platform Linux
+    //
+    // When running a dedicated server, send and receive packets in
+    // batches, using recvmmsg() and sendmmsg() instead of SDL_net.
+    // This allows higher packet rates when serving many clients.
+    //
+
+    if (M_CheckParm("-batchio") > 0)
+    {
+#ifdef HAVE_RECVMMSG
+        module = &net_mmsg_module;
+        wait_for_packet = NET_MMSG_WaitForPacket;
+#else
+        I_Error("-batchio is not supported on this system.");
+#endif
+    }
+
     NET_OpenLog();
-    NET_SV_Init();
-    NET_SV_AddModule(&net_sdl_module);
+
+    //!
+    // @category net
+    // @arg <address>
+    //
+    // Run a relay instead of a game server.  The relay joins the game
+    // on the server at <address> as a single observer, and passes it
+    // on to any number of observers (see -drone) that connect to the
+    // relay.  A relay can also join another relay.
+    //
+
+    p = M_CheckParmWithArgs("-relay", 1);
+
+    if (p > 0)
+    {
+        NET_Relay_Init(module, myargv[p + 1]);
+
+        while (true)
+        {
+            NET_Relay_Run();
+            wait_for_packet(NET_Relay_Timeout());
+        }
+    }
+
+    NET_SV_InitSessions(max_sessions);
+    NET_SV_AddModule(module);
     NET_SV_RegisterWithMaster();
 
+    // Sleep until either a packet arrives or the server has something
+    // to do on a timer (resends, keepalives, etc).
+
     while (true)
     {
         NET_SV_Run();
-        // TODO: Block on socket instead of polling.
-        I_Sleep(1);
+        wait_for_packet(NET_SV_Timeout());
     }
 }
 
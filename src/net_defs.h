@@ -97,6 +97,10 @@ struct _net_addr_s
     net_module_t *module;
     int refcount;
     void *handle;
+
+    // The server's client at this address, if there is one, so that
+    // received packets can be routed without searching for it.
+    void *server_client;
 };
 
 // Magic number sent when connecting to check this is a valid client
@@ -123,6 +127,11 @@ typedef enum
     // number in this enum.
     NET_PROTOCOL_CHOCOLATE_DOOM_0,
 
+    // As CHOCOLATE_DOOM_0, but the tics in game data packets from the
+    // server are bit-packed, and each tic and player's ticcmd is sent
+    // relative to the one before it in the packet.
+    NET_PROTOCOL_CHOCOLATE_DOOM_PACKED,
+
     // Add your own protocol here; be sure to add a name for it to the list
     // in net_common.c too.
 
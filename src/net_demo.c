@@ -0,0 +1,544 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Recording of the games run by a server to demo files.
+//
+//     The server has the complete set of ticcmds from all players for
+//     every tic of the game, so it can write the same demo that a
+//     player recording with -record would, without trusting any of
+//     the clients to do so.  Demo data is collected into blocks that
+//     are written out on a separate thread, so that the server is
+//     never held up by the disk.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+
+#include "d_event.h"
+#include "d_mode.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_misc.h"
+#include "net_common.h"
+#include "net_demo.h"
+#include "net_structrw.h"
+
+// Doom can only record four players.
+
+#define DEMO_MAXPLAYERS 4
+
+// Version byte of a "Doom 1.91" demo, with high resolution turning.
+
+#define DOOM_191_VERSION 111
+
+#define DEMO_MARKER 0x80
+
+// Size of the blocks that demo data is written out in.  A block is
+// also written out if it has been waiting for longer than
+// DEMO_FLUSH_PERIOD, so that the files on disk stay up to date.
+
+#define DEMO_BLOCK_SIZE 4096
+#define DEMO_FLUSH_PERIOD 5 /* seconds */
+
+typedef struct demo_block_s demo_block_t;
+
+struct net_demo_s
+{
+    char *filename;
+
+    // Used by the writer thread only:
+
+    FILE *stream;
+    boolean failed;
+
+    // Used by the server only:
+
+    demo_block_t *block;
+    boolean longtics;
+    int ticdup;
+    boolean playeringame[DEMO_MAXPLAYERS];
+    ticcmd_t base[DEMO_MAXPLAYERS];
+
+    net_demo_t *next;
+};
+
+struct demo_block_s
+{
+    net_demo_t *demo;
+    unsigned int start_time;
+    int len;
+
+    // If true, this is the last block of the demo; the file is closed
+    // once it has been written.
+
+    boolean last;
+
+    byte data[DEMO_BLOCK_SIZE];
+    demo_block_t *next;
+};
+
+static char *demo_dir = NULL;
+static unsigned int demo_count;
+
+// Demos currently being recorded.
+
+static net_demo_t *active_demos;
+
+// Blocks waiting to be written.  Blocks are allocated with malloc()
+// rather than the zone, as they are freed by the writer thread.
+
+static demo_block_t *queue_head, *queue_tail;
+static boolean queue_shutdown;
+static SDL_mutex *queue_lock;
+static SDL_cond *queue_not_empty;
+static SDL_Thread *writer_thread;
+
+static void WriteBlock(demo_block_t *block)
+{
+    net_demo_t *demo = block->demo;
+
+    if (demo->stream == NULL && !demo->failed)
+    {
+        demo->stream = M_fopen(demo->filename, "wb");
+
+        if (demo->stream == NULL)
+        {
+            fprintf(stderr, "NET_Demo: Unable to open %s for writing\n",
+                            demo->filename);
+            demo->failed = true;
+        }
+    }
+
+    if (demo->stream != NULL && !demo->failed)
+    {
+        if (fwrite(block->data, 1, block->len, demo->stream) != block->len
+         || fflush(demo->stream) != 0)
+        {
+            fprintf(stderr, "NET_Demo: Error writing to %s, "
+                            "recording stopped.\n", demo->filename);
+            demo->failed = true;
+        }
+    }
+
+    if (block->last)
+    {
+        if (demo->stream != NULL)
+        {
+            fclose(demo->stream);
+        }
+
+        free(demo->filename);
+        free(demo);
+    }
+}
+
+static int WriterThread(void *unused)
+{
+    demo_block_t *block;
+
+    for (;;)
+    {
+        SDL_LockMutex(queue_lock);
+
+        while (queue_head == NULL && !queue_shutdown)
+        {
+            SDL_CondWait(queue_not_empty, queue_lock);
+        }
+
+        block = queue_head;
+
+        if (block == NULL)
+        {
+            SDL_UnlockMutex(queue_lock);
+            break;
+        }
+
+        queue_head = block->next;
+
+        if (queue_head == NULL)
+        {
+            queue_tail = NULL;
+        }
+
+        SDL_UnlockMutex(queue_lock);
+
+        WriteBlock(block);
+        free(block);
+    }
+
+    return 0;
+}
+
+// Pass the block being filled to the writer thread.
+
+static void HandOffBlock(net_demo_t *demo, boolean last)
+{
+    demo_block_t *block = demo->block;
+
+    demo->block = NULL;
+    block->last = last;
+    block->next = NULL;
+
+    SDL_LockMutex(queue_lock);
+
+    if (queue_tail != NULL)
+    {
+        queue_tail->next = block;
+    }
+    else
+    {
+        queue_head = block;
+    }
+
+    queue_tail = block;
+    SDL_CondSignal(queue_not_empty);
+    SDL_UnlockMutex(queue_lock);
+}
+
+static void NewBlock(net_demo_t *demo)
+{
+    demo_block_t *block;
+
+    block = malloc(sizeof(demo_block_t));
+
+    if (block == NULL)
+    {
+        I_Error("NET_Demo: Unable to allocate demo block");
+    }
+
+    block->demo = demo;
+    block->start_time = I_GetTimeMS();
+    block->len = 0;
+    demo->block = block;
+}
+
+static void WriteByte(net_demo_t *demo, byte b)
+{
+    if (demo->block == NULL)
+    {
+        NewBlock(demo);
+    }
+
+    demo->block->data[demo->block->len++] = b;
+
+    if (demo->block->len == DEMO_BLOCK_SIZE)
+    {
+        HandOffBlock(demo, false);
+    }
+}
+
+// The same as G_WriteDemoTiccmd.
+
+static void WriteTiccmd(net_demo_t *demo, ticcmd_t *cmd)
+{
+    WriteByte(demo, cmd->forwardmove);
+    WriteByte(demo, cmd->sidemove);
+
+    if (demo->longtics)
+    {
+        WriteByte(demo, cmd->angleturn & 0xff);
+        WriteByte(demo, (cmd->angleturn >> 8) & 0xff);
+    }
+    else
+    {
+        WriteByte(demo, cmd->angleturn >> 8);
+    }
+
+    WriteByte(demo, cmd->buttons);
+}
+
+static void ShutdownDemos(void)
+{
+    while (active_demos != NULL)
+    {
+        NET_Demo_End(active_demos);
+    }
+
+    // Let the thread write out everything still queued.
+
+    SDL_LockMutex(queue_lock);
+    queue_shutdown = true;
+    SDL_CondSignal(queue_not_empty);
+    SDL_UnlockMutex(queue_lock);
+
+    SDL_WaitThread(writer_thread, NULL);
+}
+
+void NET_Demo_Init(const char *dir)
+{
+    demo_dir = M_StringDuplicate(dir);
+    M_MakeDirectory(demo_dir);
+
+    queue_head = NULL;
+    queue_tail = NULL;
+    queue_shutdown = false;
+
+    queue_lock = SDL_CreateMutex();
+    queue_not_empty = SDL_CreateCond();
+    writer_thread = SDL_CreateThread(WriterThread, "demo", NULL);
+
+    if (writer_thread == NULL)
+    {
+        I_Error("NET_Demo_Init: Unable to create thread: %s",
+                SDL_GetError());
+    }
+
+    I_AtExit(ShutdownDemos, true);
+}
+
+boolean NET_Demo_Enabled(void)
+{
+    return demo_dir != NULL;
+}
+
+static boolean IsDoomMission(unsigned int gamemission)
+{
+    switch (gamemission)
+    {
+        case doom:
+        case doom2:
+        case pack_tnt:
+        case pack_plut:
+        case pack_chex:
+        case pack_hacx:
+        case doom2f:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// The same as G_VanillaVersionCode.
+
+static int VanillaVersionCode(int gameversion)
+{
+    switch (gameversion)
+    {
+        case exe_doom_1_666:
+            return 106;
+        case exe_doom_1_7:
+            return 107;
+        case exe_doom_1_8:
+            return 108;
+        case exe_doom_1_9:
+        default:
+            return 109;
+    }
+}
+
+net_demo_t *NET_Demo_Start(net_gamesettings_t *settings,
+                           unsigned int gamemission,
+                           boolean *playeringame)
+{
+    net_demo_t *demo;
+    char timestamp[32];
+    char *filename;
+    size_t filename_len;
+    time_t now;
+    int consoleplayer;
+    int i;
+
+    // Only the Doom demo format is supported.
+
+    if (!IsDoomMission(gamemission))
+    {
+        NET_Log("demo: not recording game of %s",
+                D_GameMissionString(gamemission));
+        return NULL;
+    }
+
+    if (settings->loadgame >= 0)
+    {
+        NET_Log("demo: not recording game loaded from a savegame");
+        return NULL;
+    }
+
+    for (i = DEMO_MAXPLAYERS; i < NET_MAXPLAYERS; ++i)
+    {
+        if (playeringame[i])
+        {
+            NET_Log("demo: not recording game with more than %d players",
+                    DEMO_MAXPLAYERS);
+            return NULL;
+        }
+    }
+
+    now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S",
+             localtime(&now));
+
+    ++demo_count;
+    filename_len = strlen(demo_dir) + strlen(timestamp) + 32;
+    filename = malloc(filename_len);
+
+    if (filename == NULL)
+    {
+        I_Error("NET_Demo_Start: Unable to allocate filename");
+    }
+
+    M_snprintf(filename, filename_len, "%s" DIR_SEPARATOR_S "%s-%04u.lmp",
+               demo_dir, timestamp, demo_count);
+
+    demo = calloc(1, sizeof(net_demo_t));
+
+    if (demo == NULL)
+    {
+        I_Error("NET_Demo_Start: Unable to allocate demo");
+    }
+
+    demo->filename = filename;
+    demo->stream = NULL;
+    demo->failed = false;
+    demo->block = NULL;
+    demo->ticdup = settings->ticdup;
+
+    // If the players are turning in low resolution (because one of
+    // them is recording a demo), a vanilla demo is exact; otherwise,
+    // record a "Doom 1.91" demo.
+
+    demo->longtics = !settings->lowres_turn;
+
+    consoleplayer = -1;
+
+    for (i = 0; i < DEMO_MAXPLAYERS; ++i)
+    {
+        demo->playeringame[i] = playeringame[i];
+
+        if (playeringame[i] && consoleplayer < 0)
+        {
+            consoleplayer = i;
+        }
+    }
+
+    // Header, as written by G_BeginRecording.
+
+    if (demo->longtics)
+    {
+        WriteByte(demo, DOOM_191_VERSION);
+    }
+    else if (settings->gameversion > exe_doom_1_2)
+    {
+        WriteByte(demo, VanillaVersionCode(settings->gameversion));
+    }
+
+    WriteByte(demo, settings->skill);
+    WriteByte(demo, settings->episode);
+    WriteByte(demo, settings->map);
+
+    if (demo->longtics || settings->gameversion > exe_doom_1_2)
+    {
+        WriteByte(demo, settings->deathmatch);
+        WriteByte(demo, settings->respawn_monsters);
+        WriteByte(demo, settings->fast_monsters);
+        WriteByte(demo, settings->nomonsters);
+        WriteByte(demo, consoleplayer);
+    }
+
+    for (i = 0; i < DEMO_MAXPLAYERS; ++i)
+    {
+        WriteByte(demo, demo->playeringame[i]);
+    }
+
+    demo->next = active_demos;
+    active_demos = demo;
+
+    NET_Log("demo: recording game to %s", filename);
+
+    return demo;
+}
+
+boolean NET_Demo_WriteTic(net_demo_t *demo, net_full_ticcmd_t *cmd)
+{
+    ticcmd_t ticcmd;
+    int i, j;
+
+    // A Doom demo cannot have players leave part way through.
+
+    for (i = 0; i < DEMO_MAXPLAYERS; ++i)
+    {
+        if (demo->playeringame[i] && !cmd->playeringame[i])
+        {
+            return false;
+        }
+    }
+
+    for (i = 0; i < DEMO_MAXPLAYERS; ++i)
+    {
+        if (demo->playeringame[i])
+        {
+            NET_TiccmdPatch(&demo->base[i], &cmd->cmds[i], &demo->base[i]);
+        }
+    }
+
+    // Each tic is run ticdup times, as TryRunTics does.
+
+    for (j = 0; j < demo->ticdup; ++j)
+    {
+        for (i = 0; i < DEMO_MAXPLAYERS; ++i)
+        {
+            if (!demo->playeringame[i])
+            {
+                continue;
+            }
+
+            ticcmd = demo->base[i];
+
+            if (j > 0 && (ticcmd.buttons & BT_SPECIAL) != 0)
+            {
+                ticcmd.buttons = 0;
+            }
+
+            WriteTiccmd(demo, &ticcmd);
+        }
+    }
+
+    if (demo->block != NULL
+     && I_GetTimeMS() - demo->block->start_time > DEMO_FLUSH_PERIOD * 1000)
+    {
+        HandOffBlock(demo, false);
+    }
+
+    return true;
+}
+
+void NET_Demo_End(net_demo_t *demo)
+{
+    net_demo_t **d;
+
+    for (d = &active_demos; *d != NULL; d = &(*d)->next)
+    {
+        if (*d == demo)
+        {
+            *d = demo->next;
+            break;
+        }
+    }
+
+    NET_Log("demo: finished %s", demo->filename);
+
+    WriteByte(demo, DEMO_MARKER);
+
+    if (demo->block == NULL)
+    {
+        NewBlock(demo);
+    }
+
+    HandOffBlock(demo, true);
+}
+
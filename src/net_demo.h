@@ -0,0 +1,45 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Recording of the games run by a server to demo files.
+//
+
+#ifndef NET_DEMO_H
+#define NET_DEMO_H
+
+#include "net_defs.h"
+
+typedef struct net_demo_s net_demo_t;
+
+// Record games into the given directory.
+
+void NET_Demo_Init(const char *dir);
+boolean NET_Demo_Enabled(void);
+
+// Start recording a game.  Returns NULL if the game cannot be recorded.
+
+net_demo_t *NET_Demo_Start(net_gamesettings_t *settings,
+                           unsigned int gamemission,
+                           boolean *playeringame);
+
+// Add the next tic to a demo.  Returns false if the tic cannot be
+// recorded (a player has left the game); the demo should be ended.
+
+boolean NET_Demo_WriteTic(net_demo_t *demo, net_full_ticcmd_t *cmd);
+
+// Finish a demo.  The demo is freed once it has been written out.
+
+void NET_Demo_End(net_demo_t *demo);
+
+#endif /* #ifndef NET_DEMO_H */
+
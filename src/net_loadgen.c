@@ -0,0 +1,1643 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Network load generator.
+//
+// Runs many simulated players in one process, for stress testing a
+// game server.  Each player has its own socket, connects to the server,
+// joins a game and sends ticcmds at 35Hz as a real client would; the
+// players are split into games of a few players each, which are
+// started one after another.  Latency figures are printed as the test
+// runs, and summarized at the end.
+//
+// Some of the simulated clients can instead be drones that watch the
+// first game, optionally through relays (see net_relay.c).  Every tic
+// of the first game is checked to be the same for all of its players
+// and drones.
+//
+// net_client.c keeps its state in globals, as a game only ever has one
+// client, so the connection and game startup are handled here for each
+// simulated player.  Game data is exchanged by the same code that the
+// real client uses (net_window.c).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "doomtype.h"
+#include "d_event.h"
+#include "d_mode.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_common.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_sdl.h"
+#include "net_structrw.h"
+#include "net_window.h"
+#include "z_zone.h"
+
+#ifndef DISABLE_SDL2NET
+
+#include <SDL_net.h>
+
+// Most players that can be simulated at once.  Each player has its
+// own socket, all of the sockets are waited on together with select(),
+// which cannot wait on descriptors past FD_SETSIZE (usually 1024), and
+// 1024 is also a common limit on open files.  Stay well below both.
+
+#define MAX_CLIENTS 500
+
+#define DEFAULT_CLIENTS 100
+#define DEFAULT_PLAYERS 4
+#define DEFAULT_DURATION 60
+
+// Relays turn drones away until they have found the game, which takes
+// a second or so for each relay in a chain, so drones keep trying to
+// connect for longer than players do.
+
+#define PLAYER_CONNECT_TIMEOUT 5000
+#define DRONE_CONNECT_TIMEOUT 15000
+
+// How often progress is reported, in ms.
+
+#define REPORT_PERIOD 5000
+
+// Latencies are counted per ms up to this; anything slower is counted
+// in the last bucket.
+
+#define MAX_LATENCY 2000
+
+// Most tics of the first game that are checked: ten minutes' worth.
+
+#define MAX_WATCHED_TICS (10 * 60 * TICRATE)
+
+// Longest time to wait for packets, in ms.  Resend and acknowledgement
+// timers are only checked this often.
+
+#define MAX_TIMEOUT 10
+
+typedef enum
+{
+    // Waiting for the players before us to connect, so that this
+    // player joins a new game rather than one of theirs.
+
+    LOADGEN_IDLE,
+
+    // SYN sent, waiting for a reply.
+
+    LOADGEN_CONNECTING,
+
+    // Waiting for the game to launch
+
+    LOADGEN_WAITING_LAUNCH,
+
+    // Ready to start, waiting for the game to start
+
+    LOADGEN_WAITING_START,
+
+    // In game
+
+    LOADGEN_IN_GAME,
+
+    // Failed to connect, or disconnected
+
+    LOADGEN_DONE,
+} loadgen_state_t;
+
+typedef struct
+{
+    char name[16];
+    loadgen_state_t state;
+    boolean drone;
+
+    // Each player has its own socket, so that the server sees it as a
+    // separate client.  server_addr is the server's address as used by
+    // this player: packets sent to it go out of this player's socket.
+    // server is where they go: the game server, or a relay for drones.
+
+    UDPsocket socket;
+    net_addr_t server_addr;
+    net_addr_t *server;
+    net_connection_t connection;
+
+    // Time the first and the latest SYN were sent.
+
+    unsigned int connect_time;
+    unsigned int syn_time;
+
+    // From the latest waiting data.
+
+    boolean is_controller;
+    int num_players;
+
+    boolean sent_launch;
+
+    // Game settings, as received from the server when the game started
+
+    net_gamesettings_t settings;
+
+    // Time the game started, and the next tic to generate.
+
+    unsigned int start_time;
+    unsigned int maketic;
+
+    // Ticcmds sent to the server, and tics received back.
+
+    net_window_t window;
+    unsigned int tics_received;
+
+    // Random number state, or position in the script.
+
+    unsigned int random;
+} loadgen_client_t;
+
+typedef struct
+{
+    unsigned int count[MAX_LATENCY + 1];
+    unsigned int samples;
+    unsigned int max;
+    double total;
+} latency_hist_t;
+
+// One line of a ticcmd script.
+
+typedef struct
+{
+    int forwardmove;
+    int sidemove;
+    int angleturn;
+    int buttons;
+} script_line_t;
+
+// A tic of the first game, as first received by one of its players or
+// drones; everyone else's copy is checked against it.  Players are not
+// sent their own ticcmds back, so each player's ticcmd is kept
+// separately.
+
+typedef struct
+{
+    unsigned int received;
+    unsigned int hash[NET_MAXPLAYERS];
+} watched_tic_t;
+
+// The players come first in the clients array, followed by the drones.
+
+static loadgen_client_t *clients;
+static int num_clients;
+static int num_players;
+static int num_drones;
+static int players_per_game;
+
+// Game server and relays, as resolved by the SDL_net module.
+
+static net_addr_t *server;
+static net_addr_t **relays;
+static int num_relays;
+
+static SDLNet_SocketSet socketset;
+static UDPpacket *recvpacket;
+
+// Index of the first player of the next game to be started.
+
+static int next_game;
+
+// Set once the test has run for its duration and the players are
+// disconnecting.
+
+static boolean finishing;
+
+static script_line_t *script;
+static int script_len;
+
+// Statistics.  "Client" latency is the time from a player sending its
+// ticcmd for a tic to receiving the complete tic back from the server,
+// which includes waiting for the other players in the game.  "Server"
+// latency is measured from the last player in the game sending its
+// ticcmd for the tic instead, so that it only covers the server and
+// the network.
+
+static latency_hist_t client_latency, server_latency, connect_latency;
+static latency_hist_t drone_latency;
+static latency_hist_t period_client_latency, period_server_latency;
+
+static int num_connected;
+static int num_rejected;
+static int num_dropped;
+static unsigned int tics_sent, tics_recv;
+static unsigned int resends_sent;
+static unsigned int period_tics_recv, reported_resends_requested;
+
+static watched_tic_t *watched_tics;
+static unsigned int num_watched_tics;
+static unsigned int bad_tics;
+
+// Percentage of packets to drop, each way, to simulate a lossy network.
+
+static int drop_rate;
+static unsigned int drop_random;
+
+static void AddLatency(latency_hist_t *hist, unsigned int latency)
+{
+    ++hist->count[latency < MAX_LATENCY ? latency : MAX_LATENCY];
+    ++hist->samples;
+    hist->total += latency;
+
+    if (latency > hist->max)
+    {
+        hist->max = latency;
+    }
+}
+
+// Latency that the given fraction of samples are at or below.
+
+static unsigned int Percentile(latency_hist_t *hist, double fraction)
+{
+    unsigned int needed;
+    unsigned int seen;
+    unsigned int i;
+
+    needed = (unsigned int) (fraction * hist->samples);
+
+    if (needed < 1)
+    {
+        needed = 1;
+    }
+
+    seen = 0;
+
+    for (i=0; i<MAX_LATENCY; ++i)
+    {
+        seen += hist->count[i];
+
+        if (seen >= needed)
+        {
+            return i;
+        }
+    }
+
+    return hist->max;
+}
+
+static void PrintLatency(const char *what, latency_hist_t *hist)
+{
+    unsigned int min;
+
+    if (hist->samples == 0)
+    {
+        printf("%-15s no samples\n", what);
+        return;
+    }
+
+    for (min = 0; min < MAX_LATENCY && hist->count[min] == 0; ++min);
+
+    printf("%-15s %9u samples, mean %.1f, min %u, p50 %u, p90 %u, "
+           "p99 %u, p99.9 %u, max %u ms\n",
+           what, hist->samples, hist->total / hist->samples, min,
+           Percentile(hist, 0.5), Percentile(hist, 0.9),
+           Percentile(hist, 0.99), Percentile(hist, 0.999), hist->max);
+}
+
+//
+// Network module that sends through each player's own socket.
+//
+
+static boolean LoadGen_InitClient(void)
+{
+    return true;
+}
+
+static boolean LoadGen_InitServer(void)
+{
+    return false;
+}
+
+static boolean DropPacket(void)
+{
+    if (drop_rate == 0)
+    {
+        return false;
+    }
+
+    drop_random = drop_random * 1103515245 + 12345;
+
+    return (int) ((drop_random >> 16) % 100) < drop_rate;
+}
+
+static void LoadGen_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    loadgen_client_t *client;
+    UDPpacket sdl_packet;
+
+    if (DropPacket())
+    {
+        return;
+    }
+
+    client = (loadgen_client_t *) addr->handle;
+
+    sdl_packet.channel = 0;
+    sdl_packet.data = packet->data;
+    sdl_packet.len = packet->len;
+    sdl_packet.address = *((IPaddress *) client->server->handle);
+
+    if (!SDLNet_UDP_Send(client->socket, -1, &sdl_packet))
+    {
+        I_Error("LoadGen_SendPacket: Error transmitting packet: %s",
+                SDLNet_GetError());
+    }
+}
+
+static boolean LoadGen_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    // Packets are read from each player's socket by ReceivePackets.
+
+    return false;
+}
+
+static void LoadGen_AddrToString(net_addr_t *addr, char *buffer,
+                                 int buffer_len)
+{
+    loadgen_client_t *client;
+
+    client = (loadgen_client_t *) addr->handle;
+    client->server->module->AddrToString(client->server, buffer, buffer_len);
+}
+
+static void LoadGen_FreeAddress(net_addr_t *addr)
+{
+    // Addresses are part of the player structures.
+}
+
+static net_addr_t *LoadGen_ResolveAddress(const char *address)
+{
+    return NULL;
+}
+
+static net_module_t loadgen_module =
+{
+    LoadGen_InitClient,
+    LoadGen_InitServer,
+    LoadGen_SendPacket,
+    LoadGen_RecvPacket,
+    LoadGen_AddrToString,
+    LoadGen_FreeAddress,
+    LoadGen_ResolveAddress,
+};
+
+//
+// Ticcmds
+//
+
+static unsigned int NextRandom(loadgen_client_t *client)
+{
+    client->random = client->random * 1103515245 + 12345;
+
+    return (client->random >> 16) & 0x7fff;
+}
+
+// Random input, with each control held for a while as a player would,
+// so that the ticcmd diffs look like real play rather than noise.
+
+static void RandomTiccmd(loadgen_client_t *client, ticcmd_t *cmd)
+{
+    *cmd = client->window.last_ticcmd;
+
+    if (NextRandom(client) % 8 == 0)
+    {
+        cmd->forwardmove = (signed char) (NextRandom(client) % 101 - 50);
+    }
+
+    if (NextRandom(client) % 8 == 0)
+    {
+        cmd->sidemove = (signed char) (NextRandom(client) % 81 - 40);
+    }
+
+    if (NextRandom(client) % 4 == 0)
+    {
+        cmd->angleturn = (short) (NextRandom(client) % 2561 - 1280);
+    }
+
+    if (NextRandom(client) % 16 == 0)
+    {
+        cmd->buttons ^= BT_ATTACK;
+    }
+}
+
+static void ScriptTiccmd(loadgen_client_t *client, ticcmd_t *cmd)
+{
+    script_line_t *line;
+
+    line = &script[client->random % script_len];
+    ++client->random;
+
+    memset(cmd, 0, sizeof(ticcmd_t));
+    cmd->forwardmove = (signed char) line->forwardmove;
+    cmd->sidemove = (signed char) line->sidemove;
+    cmd->angleturn = (short) line->angleturn;
+    cmd->buttons = (byte) line->buttons;
+}
+
+// Read a script of ticcmds, one per line: forwardmove, sidemove,
+// angleturn and buttons.  Blank lines and lines starting with '#' are
+// ignored.  Each player plays the script in a loop, starting from a
+// different line.
+
+static void LoadScript(const char *filename)
+{
+    script_line_t line;
+    char buf[128];
+    FILE *fstream;
+
+    fstream = M_fopen(filename, "r");
+
+    if (fstream == NULL)
+    {
+        I_Error("LoadScript: Unable to open %s", filename);
+    }
+
+    while (fgets(buf, sizeof(buf), fstream) != NULL)
+    {
+        if (buf[0] == '#' || buf[strspn(buf, " \t\r\n")] == '\0')
+        {
+            continue;
+        }
+
+        if (sscanf(buf, "%i %i %i %i", &line.forwardmove, &line.sidemove,
+                   &line.angleturn, &line.buttons) != 4)
+        {
+            I_Error("LoadScript: Bad line in %s: %s", filename, buf);
+        }
+
+        script = I_Realloc(script, sizeof(script_line_t) * (script_len + 1));
+        script[script_len] = line;
+        ++script_len;
+    }
+
+    fclose(fstream);
+
+    if (script_len == 0)
+    {
+        I_Error("LoadScript: No ticcmds in %s", filename);
+    }
+}
+
+//
+// Players
+//
+
+static boolean Connected(loadgen_client_t *client)
+{
+    return client->connection.state == NET_CONN_STATE_CONNECTED;
+}
+
+static void SendSYN(loadgen_client_t *client)
+{
+    net_connect_data_t data;
+    net_packet_t *packet;
+
+    memset(&data, 0, sizeof(data));
+    data.gamemode = commercial;
+    data.gamemission = doom2;
+    data.max_players = players_per_game;
+    data.drone = client->drone;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteString(packet, PACKAGE_STRING);
+    NET_WriteProtocolList(packet);
+    NET_WriteConnectData(packet, &data);
+    NET_WriteString(packet, client->name);
+    NET_Conn_SendPacket(&client->connection, packet);
+    NET_FreePacket(packet);
+
+    client->syn_time = I_GetTimeMS();
+}
+
+static void StartConnecting(loadgen_client_t *client)
+{
+    NET_Conn_InitClient(&client->connection, &client->server_addr,
+                        NET_PROTOCOL_UNKNOWN);
+
+    client->state = LOADGEN_CONNECTING;
+    client->connect_time = I_GetTimeMS();
+    SendSYN(client);
+}
+
+// Called when a player is done, one way or another.
+
+static void ClientDone(loadgen_client_t *client)
+{
+    if (client->state == LOADGEN_IN_GAME && !finishing)
+    {
+        fprintf(stderr, "%s: disconnected from %s\n", client->name,
+                NET_AddrToString(client->server));
+        ++num_dropped;
+    }
+
+    client->state = LOADGEN_DONE;
+}
+
+// Generate the ticcmd for the next tic and send it, as
+// NET_CL_SendTiccmd.
+
+static void MakeTic(loadgen_client_t *client)
+{
+    ticcmd_t ticcmd;
+
+    if (script != NULL)
+    {
+        ScriptTiccmd(client, &ticcmd);
+    }
+    else
+    {
+        RandomTiccmd(client, &ticcmd);
+    }
+
+    NET_Window_SendTiccmd(&client->window, &ticcmd, client->maketic);
+
+    ++client->maketic;
+    ++tics_sent;
+}
+
+// Time that the given tic is due to be generated.
+
+static unsigned int TicTime(loadgen_client_t *client, unsigned int tic)
+{
+    return client->start_time + tic * 1000 / TICRATE;
+}
+
+// A real client stops generating tics when it gets too far ahead of
+// the tics received from the server; see NetUpdate in d_loop.c.  The
+// server can also be ahead of us: in a game with only one player, it
+// has no one else's ticcmds to wait for.
+
+static boolean CanMakeTic(loadgen_client_t *client)
+{
+    return (int) (client->maketic - client->window.recvwindow_start)
+         < BACKUPTICS / 2 - 1;
+}
+
+// Index of the first player in the same game as the given player.
+// Drones watch the first game.
+
+static int GameStart(loadgen_client_t *client)
+{
+    int index;
+
+    if (client->drone)
+    {
+        return 0;
+    }
+
+    index = client - clients;
+
+    return index - index % players_per_game;
+}
+
+static int GameEnd(int start)
+{
+    if (start + players_per_game > num_players)
+    {
+        return num_players;
+    }
+
+    return start + players_per_game;
+}
+
+// Hash of one player's ticcmd in a tic, as received from the server.
+
+static unsigned int HashTiccmd(net_full_ticcmd_t *cmd, int player)
+{
+    ticcmd_t zero;
+    ticcmd_t ticcmd;
+    unsigned int hash;
+
+    if (!cmd->playeringame[player])
+    {
+        return 0;
+    }
+
+    memset(&zero, 0, sizeof(zero));
+    NET_TiccmdPatch(&zero, &cmd->cmds[player], &ticcmd);
+
+    // Never zero, unlike for a player that is not in the game.
+
+    hash = cmd->cmds[player].diff | 0x100;
+    hash = hash * 31 + (byte) ticcmd.forwardmove;
+    hash = hash * 31 + (byte) ticcmd.sidemove;
+    hash = hash * 31 + (unsigned short) ticcmd.angleturn;
+    hash = hash * 31 + ticcmd.buttons;
+    hash = hash * 31 + ticcmd.consistancy;
+    hash = hash * 31 + ticcmd.chatchar;
+
+    return hash;
+}
+
+// Check that a tic of the first game is the same as everyone else got.
+
+static void CheckWatchedTic(loadgen_client_t *client, net_full_ticcmd_t *cmd,
+                            unsigned int seq)
+{
+    watched_tic_t *tic;
+    unsigned int hash;
+    int i;
+
+    if (GameStart(client) != 0 || seq >= num_watched_tics)
+    {
+        return;
+    }
+
+    tic = &watched_tics[seq];
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (i == client->settings.consoleplayer)
+        {
+            continue;
+        }
+
+        hash = HashTiccmd(cmd, i);
+
+        if ((tic->received & (1 << i)) == 0)
+        {
+            tic->received |= 1 << i;
+            tic->hash[i] = hash;
+        }
+        else if (tic->hash[i] != hash)
+        {
+            // Only the first is shown, as the rest most likely follow
+            // from the same problem.
+
+            if (bad_tics == 0)
+            {
+                fprintf(stderr, "%s: tic %u differs from the first "
+                        "game's\n", client->name, seq);
+            }
+
+            ++bad_tics;
+            return;
+        }
+    }
+}
+
+// Called as the receive window moves past each tic, which is when the
+// game would be able to run it: record the latencies for it.
+
+static void LoadGen_RunTic(net_window_t *window, net_full_ticcmd_t *cmd,
+                           unsigned int seq)
+{
+    loadgen_client_t *client;
+    loadgen_client_t *other;
+    net_window_send_t *sendobj;
+    unsigned int nowtime;
+    unsigned int last_sent;
+    boolean have_last_sent;
+    int start, end;
+    int i;
+
+    client = window->user_data;
+    nowtime = I_GetTimeMS();
+
+    ++tics_recv;
+    ++period_tics_recv;
+    ++client->tics_received;
+
+    CheckWatchedTic(client, cmd, seq);
+
+    sendobj = &client->window.send_queue[seq % BACKUPTICS];
+
+    if (sendobj->active && sendobj->seq == seq)
+    {
+        AddLatency(&client_latency, nowtime - sendobj->time);
+        AddLatency(&period_client_latency, nowtime - sendobj->time);
+    }
+
+    // Find when the last player in the game sent its ticcmd for this
+    // tic.  Players that have left the game don't count.
+
+    start = GameStart(client);
+    end = GameEnd(start);
+    have_last_sent = false;
+    last_sent = 0;
+
+    for (i=start; i<end; ++i)
+    {
+        other = &clients[i];
+        sendobj = &other->window.send_queue[seq % BACKUPTICS];
+
+        if (other->state != LOADGEN_IN_GAME
+         || !sendobj->active || sendobj->seq != seq)
+        {
+            continue;
+        }
+
+        if (!have_last_sent || (int) (sendobj->time - last_sent) > 0)
+        {
+            last_sent = sendobj->time;
+            have_last_sent = true;
+        }
+    }
+
+    if (!have_last_sent)
+    {
+        return;
+    }
+
+    if (client->drone)
+    {
+        AddLatency(&drone_latency, nowtime - last_sent);
+    }
+    else
+    {
+        AddLatency(&server_latency, nowtime - last_sent);
+        AddLatency(&period_server_latency, nowtime - last_sent);
+    }
+}
+
+//
+// Packets from the server
+//
+
+static void ParseSYN(loadgen_client_t *client, net_packet_t *packet)
+{
+    net_protocol_t protocol;
+    char *server_version;
+
+    if (client->state != LOADGEN_CONNECTING)
+    {
+        return;
+    }
+
+    server_version = NET_ReadSafeString(packet);
+    protocol = NET_ReadProtocol(packet);
+
+    if (server_version == NULL || protocol == NET_PROTOCOL_UNKNOWN)
+    {
+        return;
+    }
+
+    client->connection.state = NET_CONN_STATE_CONNECTED;
+    client->connection.protocol = protocol;
+    client->state = LOADGEN_WAITING_LAUNCH;
+    client->is_controller = false;
+    client->num_players = 0;
+    client->sent_launch = false;
+
+    ++num_connected;
+    AddLatency(&connect_latency, I_GetTimeMS() - client->connect_time);
+}
+
+static void ParseReject(loadgen_client_t *client, net_packet_t *packet)
+{
+    char *msg;
+
+    msg = NET_ReadSafeString(packet);
+
+    if (msg == NULL || client->state != LOADGEN_CONNECTING)
+    {
+        return;
+    }
+
+    // Relays turn drones away until they have found the game, so
+    // drones keep trying until they time out.
+
+    if (client->drone)
+    {
+        NET_Log("loadgen: %s: rejected: %s", client->name, msg);
+        return;
+    }
+
+    // Only the first rejection is shown, as the rest are most likely
+    // the same.
+
+    if (num_rejected == 0)
+    {
+        fprintf(stderr, "%s: rejected by server: %s\n", client->name, msg);
+    }
+
+    ++num_rejected;
+    client->connection.state = NET_CONN_STATE_DISCONNECTED;
+    ClientDone(client);
+}
+
+static void ParseWaitingData(loadgen_client_t *client, net_packet_t *packet)
+{
+    net_waitdata_t wait_data;
+
+    if (!NET_ReadWaitData(packet, &wait_data)
+     || wait_data.num_players > NET_MAXPLAYERS)
+    {
+        return;
+    }
+
+    client->is_controller = wait_data.is_controller != 0;
+    client->num_players = wait_data.num_players;
+}
+
+static void ParseLaunch(loadgen_client_t *client, net_packet_t *packet)
+{
+    net_gamesettings_t settings;
+    net_packet_t *startpacket;
+    unsigned int num_players;
+
+    if (client->state != LOADGEN_WAITING_LAUNCH
+     || !NET_ReadInt8(packet, &num_players))
+    {
+        return;
+    }
+
+    // Ready to start straight away; only the controller's settings are
+    // used, but everyone sends them, as NET_CL_StartGame does.
+
+    memset(&settings, 0, sizeof(settings));
+    settings.ticdup = 1;
+    settings.extratics = 1;
+    settings.episode = 1;
+    settings.map = 1;
+    settings.skill = sk_medium;
+    settings.gameversion = exe_doom_1_9;
+    settings.new_sync = 1;
+
+    startpacket = NET_Conn_NewReliable(&client->connection,
+                                       NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(startpacket, &settings);
+
+    client->state = LOADGEN_WAITING_START;
+}
+
+static void ParseGameStart(loadgen_client_t *client, net_packet_t *packet)
+{
+    net_gamesettings_t settings;
+
+    if (client->state != LOADGEN_WAITING_START
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    if (settings.num_players > NET_MAXPLAYERS
+     || settings.consoleplayer >= (signed int) settings.num_players
+     || (settings.consoleplayer < 0) != client->drone)
+    {
+        return;
+    }
+
+    client->settings = settings;
+    client->state = LOADGEN_IN_GAME;
+    client->start_time = I_GetTimeMS();
+    client->maketic = 0;
+
+    NET_Window_Init(&client->window, &client->connection, &client->settings);
+}
+
+static void ParsePacket(loadgen_client_t *client, net_packet_t *packet)
+{
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    NET_Log("loadgen: %s: packet from server, type %d", client->name,
+            packet_type & ~NET_RELIABLE_PACKET);
+    NET_LogPacket(packet);
+
+    if (NET_Conn_Packet(&client->connection, packet, &packet_type))
+    {
+        // Packet eaten by the common connection code
+    }
+    else
+    {
+        switch (packet_type)
+        {
+            case NET_PACKET_TYPE_SYN:
+                ParseSYN(client, packet);
+                break;
+
+            case NET_PACKET_TYPE_REJECTED:
+                ParseReject(client, packet);
+                break;
+
+            case NET_PACKET_TYPE_WAITING_DATA:
+                ParseWaitingData(client, packet);
+                break;
+
+            case NET_PACKET_TYPE_LAUNCH:
+                ParseLaunch(client, packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMESTART:
+                ParseGameStart(client, packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMEDATA:
+                if (client->state == LOADGEN_IN_GAME)
+                {
+                    NET_Window_ParseGameData(&client->window, packet);
+                }
+                break;
+
+            case NET_PACKET_TYPE_GAMEDATA_RESEND:
+                if (client->state == LOADGEN_IN_GAME
+                 && NET_Window_ParseResendRequest(&client->window, packet))
+                {
+                    ++resends_sent;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+static void ReceivePackets(int timeout)
+{
+    loadgen_client_t *client;
+    net_packet_t *packet;
+    IPaddress *server_ip;
+    int result;
+    int i;
+
+    if (SDLNet_CheckSockets(socketset, timeout) <= 0)
+    {
+        return;
+    }
+
+    for (i=0; i<num_clients; ++i)
+    {
+        client = &clients[i];
+
+        if (!SDLNet_SocketReady(client->socket))
+        {
+            continue;
+        }
+
+        server_ip = (IPaddress *) client->server->handle;
+
+        while ((result = SDLNet_UDP_Recv(client->socket, recvpacket)) > 0)
+        {
+            // Only accept packets from the server
+
+            if (recvpacket->address.host != server_ip->host
+             || recvpacket->address.port != server_ip->port
+             || DropPacket())
+            {
+                continue;
+            }
+
+            packet = NET_NewPacket(recvpacket->len);
+            memcpy(packet->data, recvpacket->data, recvpacket->len);
+            packet->len = recvpacket->len;
+
+            ParsePacket(client, packet);
+
+            NET_FreePacket(packet);
+        }
+
+        if (result < 0)
+        {
+            I_Error("ReceivePackets: Error receiving packet: %s",
+                    SDLNet_GetError());
+        }
+
+        // Take in the tics that have arrived straight away, so that
+        // they are timed when they arrived.
+
+        if (client->state == LOADGEN_IN_GAME)
+        {
+            NET_Window_Run(&client->window);
+        }
+    }
+}
+
+//
+// Games
+//
+
+// Whether the given clients have all connected (or given up).
+
+static boolean AllConnected(int start, int end)
+{
+    int i;
+
+    for (i=start; i<end; ++i)
+    {
+        if (clients[i].state == LOADGEN_IDLE
+         || clients[i].state == LOADGEN_CONNECTING)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The controller launches the game once all of the players that it
+// is meant to have are connected, and for the first game, once the
+// drones watching it are too.
+
+static void CheckLaunch(loadgen_client_t *client)
+{
+    int waiting;
+    int start, end;
+    int i;
+
+    if (client->state != LOADGEN_WAITING_LAUNCH
+     || !client->is_controller || client->sent_launch)
+    {
+        return;
+    }
+
+    start = GameStart(client);
+    end = GameEnd(start);
+    waiting = 0;
+
+    if (start == 0 && !AllConnected(num_players, num_clients))
+    {
+        return;
+    }
+
+    for (i=start; i<end; ++i)
+    {
+        if (clients[i].state == LOADGEN_CONNECTING)
+        {
+            return;
+        }
+
+        if (clients[i].state == LOADGEN_WAITING_LAUNCH)
+        {
+            ++waiting;
+        }
+    }
+
+    if (client->num_players >= waiting)
+    {
+        NET_Conn_NewReliable(&client->connection, NET_PACKET_TYPE_LAUNCH);
+        client->sent_launch = true;
+    }
+}
+
+// Whether the first game has been launched (or given up on).
+
+static boolean FirstGameLaunched(void)
+{
+    int i;
+
+    for (i=0; i<GameEnd(0); ++i)
+    {
+        if (clients[i].state < LOADGEN_WAITING_START)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The drones start connecting once the first game's players have: a
+// relay only finds the game once there is a player in it.
+
+static void StartDrones(void)
+{
+    int i;
+
+    if (num_drones == 0 || clients[num_players].state != LOADGEN_IDLE
+     || !AllConnected(0, GameEnd(0)))
+    {
+        return;
+    }
+
+    for (i=num_players; i<num_clients; ++i)
+    {
+        StartConnecting(&clients[i]);
+    }
+}
+
+// Start the players of the next game connecting once all of the last
+// game's players have connected.  Each player asks for games of
+// players_per_game, so the last game is then full, and the next
+// players get a game of their own.  With drones, the second game
+// also waits for the first to be launched, so that the drones (and
+// relays) are sure to join the first game.
+
+static void StartNextGame(void)
+{
+    int start, end;
+    int i;
+
+    StartDrones();
+
+    if (next_game >= num_players)
+    {
+        return;
+    }
+
+    if (next_game > 0
+     && !AllConnected(next_game - players_per_game, next_game))
+    {
+        return;
+    }
+
+    if (next_game > 0 && num_drones > 0 && !FirstGameLaunched())
+    {
+        return;
+    }
+
+    start = next_game;
+    end = GameEnd(start);
+
+    for (i=start; i<end; ++i)
+    {
+        StartConnecting(&clients[i]);
+    }
+
+    next_game = end;
+}
+
+static void RunClient(loadgen_client_t *client, int *timeout)
+{
+    unsigned int nowtime;
+
+    if (client->state == LOADGEN_IDLE || client->state == LOADGEN_DONE)
+    {
+        return;
+    }
+
+    nowtime = I_GetTimeMS();
+
+    if (client->state == LOADGEN_CONNECTING)
+    {
+        // Time out after 5 seconds (longer for drones), sending a SYN
+        // every second, as NET_CL_Connect does.
+
+        if (nowtime - client->connect_time > (client->drone ?
+                                              DRONE_CONNECT_TIMEOUT :
+                                              PLAYER_CONNECT_TIMEOUT))
+        {
+            fprintf(stderr, "%s: unable to connect to %s\n", client->name,
+                    NET_AddrToString(client->server));
+            ClientDone(client);
+            return;
+        }
+
+        if (nowtime - client->syn_time > 1000)
+        {
+            SendSYN(client);
+        }
+
+        return;
+    }
+
+    NET_Conn_Run(&client->connection);
+
+    if (client->connection.state == NET_CONN_STATE_DISCONNECTED
+     || client->connection.state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        ClientDone(client);
+        return;
+    }
+
+    CheckLaunch(client);
+
+    if (client->state == LOADGEN_IN_GAME && Connected(client))
+    {
+        // Drones only watch.
+
+        if (!client->drone)
+        {
+            while (CanMakeTic(client)
+                && (int) (nowtime - TicTime(client, client->maketic)) >= 0)
+            {
+                MakeTic(client);
+            }
+
+            if (CanMakeTic(client))
+            {
+                NET_WakeBy(timeout, nowtime,
+                           TicTime(client, client->maketic));
+            }
+        }
+
+        NET_Window_Run(&client->window);
+    }
+}
+
+// Resend requests sent by all of the players so far.
+
+static unsigned int ResendsRequested(void)
+{
+    unsigned int result;
+    int i;
+
+    result = 0;
+
+    for (i=0; i<num_clients; ++i)
+    {
+        result += clients[i].window.resend_requests;
+    }
+
+    return result;
+}
+
+static void PrintReport(unsigned int elapsed)
+{
+    unsigned int resends_requested;
+    int in_game;
+    int i;
+
+    in_game = 0;
+
+    for (i=0; i<num_clients; ++i)
+    {
+        if (clients[i].state == LOADGEN_IN_GAME)
+        {
+            ++in_game;
+        }
+    }
+
+    resends_requested = ResendsRequested();
+
+    printf("%5us: %4i in game, %6u tics/s, %4u resend requests, "
+           "client p50/p99 %u/%u ms, server p50/p99 %u/%u ms\n",
+           elapsed / 1000, in_game,
+           period_tics_recv * 1000 / REPORT_PERIOD,
+           resends_requested - reported_resends_requested,
+           Percentile(&period_client_latency, 0.5),
+           Percentile(&period_client_latency, 0.99),
+           Percentile(&period_server_latency, 0.5),
+           Percentile(&period_server_latency, 0.99));
+    fflush(stdout);
+
+    period_tics_recv = 0;
+    reported_resends_requested = resends_requested;
+    memset(&period_client_latency, 0, sizeof(latency_hist_t));
+    memset(&period_server_latency, 0, sizeof(latency_hist_t));
+}
+
+// How many of the first game's tics each drone received, and whether
+// they were all the same as the players got.
+
+static void PrintDroneSummary(void)
+{
+    unsigned int game_tics;
+    unsigned int min_tics, max_tics;
+    int i;
+
+    game_tics = 0;
+
+    for (i=0; i<GameEnd(0); ++i)
+    {
+        if (clients[i].tics_received > game_tics)
+        {
+            game_tics = clients[i].tics_received;
+        }
+    }
+
+    min_tics = clients[num_players].tics_received;
+    max_tics = min_tics;
+
+    for (i=num_players; i<num_clients; ++i)
+    {
+        if (clients[i].tics_received < min_tics)
+        {
+            min_tics = clients[i].tics_received;
+        }
+
+        if (clients[i].tics_received > max_tics)
+        {
+            max_tics = clients[i].tics_received;
+        }
+    }
+
+    printf("%i drones received %u-%u tics each, of the first game's %u\n",
+           num_drones, min_tics, max_tics, game_tics);
+}
+
+static void PrintSummary(unsigned int elapsed)
+{
+    printf("\n%i players in games of %i, for %u seconds:\n",
+           num_players, players_per_game, elapsed / 1000);
+    printf("%i connected, %i rejected, %i dropped\n",
+           num_connected, num_rejected, num_dropped);
+    printf("%u tics sent, %u tics received\n", tics_sent, tics_recv);
+    printf("%u resend requests sent, %u resend requests answered\n",
+           ResendsRequested(), resends_sent);
+
+    if (num_drones > 0)
+    {
+        PrintDroneSummary();
+    }
+
+    printf("%u tics of the first game differed\n\n", bad_tics);
+    PrintLatency("Connect", &connect_latency);
+    PrintLatency("Client latency", &client_latency);
+    PrintLatency("Server latency", &server_latency);
+
+    if (num_drones > 0)
+    {
+        PrintLatency("Drone latency", &drone_latency);
+    }
+}
+
+static boolean AllDone(void)
+{
+    int i;
+
+    for (i=0; i<num_clients; ++i)
+    {
+        if (clients[i].state != LOADGEN_IDLE
+         && clients[i].state != LOADGEN_DONE)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void InitClients(void)
+{
+    loadgen_client_t *client;
+    int i;
+
+    clients = Z_Malloc(sizeof(loadgen_client_t) * num_clients, PU_STATIC, 0);
+    memset(clients, 0, sizeof(loadgen_client_t) * num_clients);
+
+    socketset = SDLNet_AllocSocketSet(num_clients);
+
+    if (socketset == NULL)
+    {
+        I_Error("InitClients: Unable to allocate socket set: %s",
+                SDLNet_GetError());
+    }
+
+    recvpacket = SDLNet_AllocPacket(1500);
+
+    for (i=0; i<num_clients; ++i)
+    {
+        client = &clients[i];
+
+        client->drone = i >= num_players;
+        client->server = server;
+
+        if (!client->drone)
+        {
+            M_snprintf(client->name, sizeof(client->name), "load%i", i);
+        }
+        else
+        {
+            M_snprintf(client->name, sizeof(client->name), "drone%i",
+                       i - num_players);
+
+            // Drones are shared out between the relays.
+
+            if (num_relays > 0)
+            {
+                client->server = relays[(i - num_players) % num_relays];
+            }
+        }
+
+        client->state = LOADGEN_IDLE;
+        client->random = i;
+
+        client->socket = SDLNet_UDP_Open(0);
+
+        if (client->socket == NULL)
+        {
+            I_Error("InitClients: Unable to open socket %i: %s",
+                    i, SDLNet_GetError());
+        }
+
+        SDLNet_UDP_AddSocket(socketset, client->socket);
+
+        client->server_addr.module = &loadgen_module;
+        client->server_addr.handle = client;
+        client->server_addr.refcount = 1;
+
+        client->window.RunTic = LoadGen_RunTic;
+        client->window.user_data = client;
+    }
+}
+
+static int ArgValue(const char *name, int default_value, int min, int max)
+{
+    int result;
+    int p;
+
+    p = M_CheckParmWithArgs(name, 1);
+
+    if (p <= 0)
+    {
+        return default_value;
+    }
+
+    result = atoi(myargv[p + 1]);
+
+    if (result < min || result > max)
+    {
+        I_Error("Invalid value for %s: '%s' (must be %i-%i)",
+                name, myargv[p + 1], min, max);
+    }
+
+    return result;
+}
+
+static void NET_LoadGen(void)
+{
+    const char *address;
+    unsigned int start_time, end_time, report_time;
+    unsigned int nowtime;
+    unsigned int seed;
+    int duration;
+    int timeout;
+    int p;
+    int i;
+
+    // Command line options (these are not game options, so are not
+    // in the manual pages):
+    //
+    //   -connect <address>  Server to test (default: localhost)
+    //   -clients <n>        Number of simulated players
+    //   -players <n>        Players in each game
+    //   -duration <n>       Length of the test, in seconds
+    //   -script <file>      Play ticcmds from a file instead of at random
+    //   -seed <n>           Seed for the random ticcmds
+    //   -drones <n>         Number of drones watching the first game
+    //   -relay <address>    Relay for the drones to connect through;
+    //                       may be given more than once
+    //   -droprate <n>       Percentage of packets to drop, each way
+
+    p = M_CheckParmWithArgs("-connect", 1);
+    address = p > 0 ? myargv[p + 1] : "localhost";
+
+    num_players = ArgValue("-clients", DEFAULT_CLIENTS, 1, MAX_CLIENTS);
+    num_drones = ArgValue("-drones", 0, 0, MAX_CLIENTS - num_players);
+    num_clients = num_players + num_drones;
+    players_per_game = ArgValue("-players", DEFAULT_PLAYERS,
+                                1, NET_MAXPLAYERS);
+    duration = ArgValue("-duration", DEFAULT_DURATION, 1, 24 * 60 * 60);
+    seed = ArgValue("-seed", 0, 0, 0x7fffffff);
+    drop_rate = ArgValue("-droprate", 0, 0, 99);
+    drop_random = seed;
+
+    p = M_CheckParmWithArgs("-script", 1);
+
+    if (p > 0)
+    {
+        LoadScript(myargv[p + 1]);
+    }
+
+    SDLNet_Init();
+
+    server = net_sdl_module.ResolveAddress(address);
+
+    if (server == NULL)
+    {
+        I_Error("Unable to resolve '%s'", address);
+    }
+
+    for (i=1; i<myargc - 1; ++i)
+    {
+        if (strcasecmp(myargv[i], "-relay") != 0)
+        {
+            continue;
+        }
+
+        relays = I_Realloc(relays, sizeof(net_addr_t *) * (num_relays + 1));
+        relays[num_relays] = net_sdl_module.ResolveAddress(myargv[i + 1]);
+
+        if (relays[num_relays] == NULL)
+        {
+            I_Error("Unable to resolve '%s'", myargv[i + 1]);
+        }
+
+        ++num_relays;
+    }
+
+    // The first game can run for at most the length of the test, and
+    // then a few seconds to finish.
+
+    num_watched_tics = (duration + 10) * TICRATE;
+
+    if (num_watched_tics > MAX_WATCHED_TICS)
+    {
+        num_watched_tics = MAX_WATCHED_TICS;
+    }
+    watched_tics = Z_Malloc(sizeof(watched_tic_t) * num_watched_tics,
+                            PU_STATIC, 0);
+    memset(watched_tics, 0, sizeof(watched_tic_t) * num_watched_tics);
+
+    InitClients();
+
+    for (i=0; i<num_clients; ++i)
+    {
+        clients[i].random += seed * MAX_CLIENTS;
+    }
+
+    printf("Testing %s with %i players in games of %i, for %i seconds\n",
+           NET_AddrToString(server), num_players, players_per_game, duration);
+
+    if (num_drones > 0)
+    {
+        printf("%i drones watching the first game, through %i relays\n",
+               num_drones, num_relays);
+    }
+
+    start_time = I_GetTimeMS();
+    end_time = start_time + duration * 1000;
+    report_time = start_time + REPORT_PERIOD;
+
+    for (;;)
+    {
+        nowtime = I_GetTimeMS();
+
+        if (!finishing && (int) (nowtime - end_time) >= 0)
+        {
+            // Time's up: disconnect everyone, and give them a few
+            // seconds to do so cleanly.
+
+            finishing = true;
+
+            for (i=0; i<num_clients; ++i)
+            {
+                if (clients[i].state == LOADGEN_IDLE
+                 || clients[i].state == LOADGEN_CONNECTING)
+                {
+                    clients[i].state = LOADGEN_DONE;
+                }
+                else if (clients[i].state != LOADGEN_DONE)
+                {
+                    NET_Conn_Disconnect(&clients[i].connection);
+                }
+            }
+        }
+
+        if (finishing && (AllDone() || nowtime - end_time > 5000))
+        {
+            break;
+        }
+
+        if (!finishing)
+        {
+            StartNextGame();
+        }
+
+        if ((int) (nowtime - report_time) >= 0)
+        {
+            PrintReport(nowtime - start_time);
+            report_time += REPORT_PERIOD;
+        }
+
+        timeout = MAX_TIMEOUT;
+
+        for (i=0; i<num_clients; ++i)
+        {
+            RunClient(&clients[i], &timeout);
+        }
+
+        ReceivePackets(timeout);
+    }
+
+    PrintSummary(end_time - start_time);
+}
+
+#else // DISABLE_SDL2NET
+
+static void NET_LoadGen(void)
+{
+    I_Error("The load generator needs SDL2_net.");
+}
+
+#endif // DISABLE_SDL2NET
+
+void D_DoomMain(void)
+{
+    printf(PACKAGE_NAME " network load generator\n");
+
+    Z_Init();
+
+    NET_OpenLog();
+
+    NET_LoadGen();
+}
+
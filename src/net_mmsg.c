@@ -0,0 +1,470 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Server networking module which uses the Linux recvmmsg() and
+//     sendmmsg() calls to move packets in batches.
+//
+
+// for recvmmsg() and sendmmsg()
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "config.h"
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "net_addrtable.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_mmsg.h"
+#include "net_packet.h"
+#include "z_zone.h"
+
+#ifdef HAVE_RECVMMSG
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PORT 2342
+
+// Number of packets received or sent with one system call
+
+#define BATCH_SIZE 32
+
+static boolean initted = false;
+static int port = DEFAULT_PORT;
+static int sock = -1;
+
+typedef struct
+{
+    net_addr_t net_addr;
+    struct sockaddr_in sin;
+} addrpair_t;
+
+static net_addrtable_t addr_table;
+static boolean addr_table_initted = false;
+
+// Received packets are read straight into packets from the pool, and
+// handed out to the caller one at a time, which frees them back into
+// the pool once done with them.
+
+static net_packet_t *recv_packets[BATCH_SIZE];
+static struct sockaddr_in recv_addrs[BATCH_SIZE];
+static struct iovec recv_iovecs[BATCH_SIZE];
+static struct mmsghdr recv_msgs[BATCH_SIZE];
+static int recv_count = 0;
+static int recv_next = 0;
+
+// Packets to send are copied here, as the caller frees them straight
+// away, and sent together by NET_MMSG_Flush: when the batch is full,
+// before the next batch is received, and before waiting for packets.
+
+static byte send_buffers[BATCH_SIZE][NET_POOLED_PACKET_SIZE];
+static struct sockaddr_in send_addrs[BATCH_SIZE];
+static struct iovec send_iovecs[BATCH_SIZE];
+static struct mmsghdr send_msgs[BATCH_SIZE];
+static int send_count = 0;
+
+// Finds an address by looking it up in the table.  If the address is
+// not found, it is added to the table.
+
+static net_addr_t *NET_MMSG_FindAddress(struct sockaddr_in *sin)
+{
+    addrpair_t *new_entry;
+    net_addr_t *result;
+
+    if (!addr_table_initted)
+    {
+        NET_AddrTable_Init(&addr_table);
+        addr_table_initted = true;
+    }
+
+    result = NET_AddrTable_Find(&addr_table, sin->sin_addr.s_addr,
+                                sin->sin_port);
+
+    if (result != NULL)
+    {
+        return result;
+    }
+
+    new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
+
+    new_entry->sin = *sin;
+    new_entry->net_addr.refcount = 0;
+    new_entry->net_addr.handle = &new_entry->sin;
+    new_entry->net_addr.server_client = NULL;
+    new_entry->net_addr.module = &net_mmsg_module;
+
+    NET_AddrTable_Add(&addr_table, sin->sin_addr.s_addr, sin->sin_port,
+                      &new_entry->net_addr);
+
+    return &new_entry->net_addr;
+}
+
+static void NET_MMSG_FreeAddress(net_addr_t *addr)
+{
+    struct sockaddr_in *sin;
+
+    sin = (struct sockaddr_in *) addr->handle;
+
+    if (!addr_table_initted
+     || !NET_AddrTable_Remove(&addr_table, sin->sin_addr.s_addr,
+                              sin->sin_port))
+    {
+        I_Error("NET_MMSG_FreeAddress: Attempted to remove an unused "
+                "address!");
+    }
+
+    // The net_addr_t is the first member of the addrpair_t.
+
+    Z_Free(addr);
+}
+
+static boolean NET_MMSG_InitClient(void)
+{
+    // Only for use by the server.
+
+    return false;
+}
+
+static boolean NET_MMSG_InitServer(void)
+{
+    struct sockaddr_in sin;
+    int broadcast = 1;
+    int p;
+
+    if (initted)
+        return true;
+
+    p = M_CheckParmWithArgs("-port", 1);
+    if (p > 0)
+        port = atoi(myargv[p+1]);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+    {
+        I_Error("NET_MMSG_InitServer: Unable to open a socket: %s",
+                strerror(errno));
+    }
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_ANY);
+    sin.sin_port = htons(port);
+
+    if (bind(sock, (struct sockaddr *) &sin, sizeof(sin)) < 0)
+    {
+        I_Error("NET_MMSG_InitServer: Unable to bind to port %i", port);
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+
+    initted = true;
+
+    return true;
+}
+
+// Send all queued packets.
+
+void NET_MMSG_Flush(void)
+{
+    int sent;
+    int result;
+
+    sent = 0;
+
+    while (sent < send_count)
+    {
+        result = sendmmsg(sock, send_msgs + sent, send_count - sent, 0);
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // Something is wrong with the first packet (no route to the
+            // host, etc).  Drop it, as SDL_net would, and carry on with
+            // the rest.
+
+            result = 1;
+        }
+
+        sent += result;
+    }
+
+    send_count = 0;
+}
+
+static void NET_MMSG_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    struct sockaddr_in *sin;
+
+    if (packet->len > NET_POOLED_PACKET_SIZE)
+    {
+        I_Error("NET_MMSG_SendPacket: Packet too large (%i bytes)",
+                (int) packet->len);
+    }
+
+    if (send_count >= BATCH_SIZE)
+    {
+        NET_MMSG_Flush();
+    }
+
+    sin = &send_addrs[send_count];
+
+    if (addr == &net_broadcast_addr)
+    {
+        memset(sin, 0, sizeof(*sin));
+        sin->sin_family = AF_INET;
+        sin->sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        sin->sin_port = htons(port);
+    }
+    else
+    {
+        *sin = *((struct sockaddr_in *) addr->handle);
+    }
+
+    memcpy(send_buffers[send_count], packet->data, packet->len);
+
+    send_iovecs[send_count].iov_base = send_buffers[send_count];
+    send_iovecs[send_count].iov_len = packet->len;
+
+    memset(&send_msgs[send_count], 0, sizeof(struct mmsghdr));
+    send_msgs[send_count].msg_hdr.msg_name = sin;
+    send_msgs[send_count].msg_hdr.msg_namelen = sizeof(*sin);
+    send_msgs[send_count].msg_hdr.msg_iov = &send_iovecs[send_count];
+    send_msgs[send_count].msg_hdr.msg_iovlen = 1;
+
+    ++send_count;
+}
+
+// Read as many waiting packets as will fit in the batch.  Returns
+// false if there were none.
+
+static boolean NET_MMSG_RecvBatch(void)
+{
+    struct msghdr *hdr;
+    int result;
+    int i;
+
+    for (i=0; i<BATCH_SIZE; ++i)
+    {
+        // Slots whose packets were handed out need a new one.
+
+        if (recv_packets[i] == NULL)
+        {
+            recv_packets[i] = NET_NewPacket(NET_POOLED_PACKET_SIZE);
+            recv_iovecs[i].iov_base = recv_packets[i]->data;
+            recv_iovecs[i].iov_len = recv_packets[i]->alloced;
+        }
+
+        hdr = &recv_msgs[i].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_name = &recv_addrs[i];
+        hdr->msg_namelen = sizeof(recv_addrs[i]);
+        hdr->msg_iov = &recv_iovecs[i];
+        hdr->msg_iovlen = 1;
+    }
+
+    do
+    {
+        result = recvmmsg(sock, recv_msgs, BATCH_SIZE, MSG_DONTWAIT, NULL);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return false;
+        }
+
+        I_Error("NET_MMSG_RecvPacket: Error receiving packets: %s",
+                strerror(errno));
+    }
+
+    recv_count = result;
+    recv_next = 0;
+
+    return result > 0;
+}
+
+static boolean NET_MMSG_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    struct mmsghdr *msg;
+    int i;
+
+    for (;;)
+    {
+        if (recv_next >= recv_count)
+        {
+            // Replies to the last batch go out together before we read
+            // the next one.
+
+            NET_MMSG_Flush();
+
+            if (!NET_MMSG_RecvBatch())
+            {
+                // no packets received
+
+                return false;
+            }
+        }
+
+        i = recv_next;
+        ++recv_next;
+        msg = &recv_msgs[i];
+
+        // Too big to be one of ours?
+
+        if ((msg->msg_hdr.msg_flags & MSG_TRUNC) != 0
+         || msg->msg_hdr.msg_namelen != sizeof(struct sockaddr_in))
+        {
+            continue;
+        }
+
+        *packet = recv_packets[i];
+        (*packet)->len = msg->msg_len;
+        (*packet)->pos = 0;
+        recv_packets[i] = NULL;
+
+        *addr = NET_MMSG_FindAddress(&recv_addrs[i]);
+
+        return true;
+    }
+}
+
+// Block until a packet is waiting to be received, or until timeout
+// ms have passed.  Returns true if there is a packet.
+
+boolean NET_MMSG_WaitForPacket(int timeout)
+{
+    struct pollfd pfd;
+
+    if (!initted)
+    {
+        I_Sleep(timeout);
+        return false;
+    }
+
+    NET_MMSG_Flush();
+
+    if (recv_next < recv_count)
+    {
+        return true;
+    }
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, timeout) > 0;
+}
+
+static void NET_MMSG_AddrToString(net_addr_t *addr, char *buffer,
+                                  int buffer_len)
+{
+    struct sockaddr_in *sin;
+    uint32_t host;
+    uint16_t addr_port;
+
+    sin = (struct sockaddr_in *) addr->handle;
+    host = ntohl(sin->sin_addr.s_addr);
+    addr_port = ntohs(sin->sin_port);
+
+    M_snprintf(buffer, buffer_len, "%i.%i.%i.%i",
+               (host >> 24) & 0xff, (host >> 16) & 0xff,
+               (host >> 8) & 0xff, host & 0xff);
+
+    // As in net_sdl.c, the port is only shown if it is not the default.
+
+    if (addr_port != DEFAULT_PORT)
+    {
+        char portbuf[10];
+        M_snprintf(portbuf, sizeof(portbuf), ":%i", addr_port);
+        M_StringConcat(buffer, portbuf, buffer_len);
+    }
+}
+
+static net_addr_t *NET_MMSG_ResolveAddress(const char *address)
+{
+    struct addrinfo hints;
+    struct addrinfo *result;
+    struct sockaddr_in sin;
+    char *addr_hostname;
+    int addr_port;
+    char *colon;
+
+    colon = strchr(address, ':');
+
+    addr_hostname = M_StringDuplicate(address);
+    if (colon != NULL)
+    {
+        addr_hostname[colon - address] = '\0';
+        addr_port = atoi(colon + 1);
+    }
+    else
+    {
+        addr_port = port;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(addr_hostname, NULL, &hints, &result) != 0)
+    {
+        // unable to resolve
+
+        free(addr_hostname);
+        return NULL;
+    }
+
+    memcpy(&sin, result->ai_addr, sizeof(sin));
+    sin.sin_port = htons(addr_port);
+
+    freeaddrinfo(result);
+    free(addr_hostname);
+
+    return NET_MMSG_FindAddress(&sin);
+}
+
+// Complete module
+
+net_module_t net_mmsg_module =
+{
+    NET_MMSG_InitClient,
+    NET_MMSG_InitServer,
+    NET_MMSG_SendPacket,
+    NET_MMSG_RecvPacket,
+    NET_MMSG_AddrToString,
+    NET_MMSG_FreeAddress,
+    NET_MMSG_ResolveAddress,
+};
+
+#endif /* #ifdef HAVE_RECVMMSG */
+
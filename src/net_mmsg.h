@@ -0,0 +1,31 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Server networking module which uses the Linux recvmmsg() and
+//     sendmmsg() calls to move packets in batches.  Only available
+//     if HAVE_RECVMMSG is defined.
+//
+
+#ifndef NET_MMSG_H
+#define NET_MMSG_H
+
+#include "net_defs.h"
+
+extern net_module_t net_mmsg_module;
+
+void NET_MMSG_Flush(void);
+boolean NET_MMSG_WaitForPacket(int timeout);
+
+#endif /* #ifndef NET_MMSG_H */
+
@@ -0,0 +1,393 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Checks the recvmmsg/sendmmsg network module by echoing packets
+//     of different sizes from lots of UDP peers over loopback, so
+//     that they arrive and are sent back in batches.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#include "doomtype.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_mmsg.h"
+#include "net_packet.h"
+#include "z_zone.h"
+
+static char *test_args[] = { "test_mmsg", "-port", "0" };
+
+int myargc = 3;
+char **myargv = test_args;
+
+net_addr_t net_broadcast_addr;
+
+void *Z_Malloc2(int size, int tag, void *ptr, const char *file, int line)
+{
+    return malloc(size);
+}
+
+void Z_Free(void *ptr)
+{
+    free(ptr);
+}
+
+void I_Error(const char *error, ...)
+{
+    va_list args;
+
+    va_start(args, error);
+    vfprintf(stderr, error, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+
+    exit(1);
+}
+
+void I_Sleep(int ms)
+{
+    usleep(ms * 1000);
+}
+
+int M_CheckParmWithArgs(const char *check, int num_args)
+{
+    int i;
+
+    for (i = 1; i < myargc - num_args; ++i)
+    {
+        if (!strcmp(myargv[i], check))
+        {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+int M_snprintf(char *buf, size_t buf_len, const char *s, ...)
+{
+    va_list args;
+    int result;
+
+    va_start(args, s);
+    result = vsnprintf(buf, buf_len, s, args);
+    va_end(args);
+
+    return result;
+}
+
+boolean M_StringCopy(char *dest, const char *src, size_t dest_size)
+{
+    snprintf(dest, dest_size, "%s", src);
+    return strlen(src) < dest_size;
+}
+
+boolean M_StringConcat(char *dest, const char *src, size_t dest_size)
+{
+    size_t offset;
+
+    offset = strlen(dest);
+
+    return M_StringCopy(dest + offset, src, dest_size - offset);
+}
+
+char *M_StringDuplicate(const char *orig)
+{
+    return strdup(orig);
+}
+
+#ifdef HAVE_RECVMMSG
+
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define NUM_PEERS 50
+#define PACKETS_PER_PEER 20
+#define MAX_PACKET_LEN 1400
+
+// How long to wait for packets before giving up, in ms.
+
+#define TIMEOUT 5000
+
+typedef struct
+{
+    int sock;
+    int port;
+    net_addr_t *addr;
+} peer_t;
+
+static peer_t peers[NUM_PEERS];
+
+// The server's address, as seen by the peers.
+
+static struct sockaddr_in server_sin;
+
+// Contents of the given packet from the given peer.  Sizes vary, so
+// that short packets follow long ones in the same batch.
+
+static int PacketLen(int peer, int seq)
+{
+    return 4 + (peer * 131 + seq * 37) % (MAX_PACKET_LEN - 4);
+}
+
+static void MakePacket(byte *buf, int peer, int seq)
+{
+    int len;
+    int i;
+
+    len = PacketLen(peer, seq);
+    buf[0] = peer;
+    buf[1] = seq;
+
+    for (i = 2; i < len; ++i)
+    {
+        buf[i] = (peer + seq * 7 + i) & 0xff;
+    }
+}
+
+static boolean CheckPacket(byte *buf, int len, int *peer, int *seq)
+{
+    byte expected[MAX_PACKET_LEN];
+
+    if (len < 2 || buf[0] >= NUM_PEERS || buf[1] >= PACKETS_PER_PEER)
+    {
+        return false;
+    }
+
+    *peer = buf[0];
+    *seq = buf[1];
+    MakePacket(expected, *peer, *seq);
+
+    return len == PacketLen(*peer, *seq) && !memcmp(buf, expected, len);
+}
+
+static boolean WaitForSocket(int sock)
+{
+    struct pollfd pfd;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, TIMEOUT) > 0;
+}
+
+static void OpenPeers(void)
+{
+    struct sockaddr_in sin;
+    socklen_t sin_len;
+    char address[32];
+    int i;
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        peers[i].sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sin.sin_port = 0;
+        sin_len = sizeof(sin);
+
+        if (peers[i].sock < 0
+         || bind(peers[i].sock, (struct sockaddr *) &sin, sizeof(sin)) < 0
+         || getsockname(peers[i].sock, (struct sockaddr *) &sin,
+                        &sin_len) < 0)
+        {
+            I_Error("Unable to open socket for peer %i", i);
+        }
+
+        peers[i].port = ntohs(sin.sin_port);
+
+        M_snprintf(address, sizeof(address), "127.0.0.1:%i", peers[i].port);
+        peers[i].addr = net_mmsg_module.ResolveAddress(address);
+
+        if (peers[i].addr == NULL)
+        {
+            I_Error("Unable to resolve %s", address);
+        }
+    }
+}
+
+// The server is on a port chosen by the system, so it says hello to
+// each peer first, and the peers find out where it is from that.
+
+static void SayHello(void)
+{
+    net_packet_t *packet;
+    socklen_t sin_len;
+    byte buf[16];
+    int i;
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        packet = NET_NewPacket(10);
+        NET_WriteInt8(packet, i);
+        net_mmsg_module.SendPacket(peers[i].addr, packet);
+        NET_FreePacket(packet);
+    }
+
+    NET_MMSG_Flush();
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        sin_len = sizeof(server_sin);
+
+        if (!WaitForSocket(peers[i].sock)
+         || recvfrom(peers[i].sock, buf, sizeof(buf), 0,
+                     (struct sockaddr *) &server_sin, &sin_len) != 1
+         || buf[0] != i)
+        {
+            I_Error("Peer %i did not get hello from the server", i);
+        }
+    }
+}
+
+// Each peer sends one packet, all at once.  Sending them all in one
+// go would overflow the server's socket buffer.
+
+static void SendFromPeers(int seq)
+{
+    byte buf[MAX_PACKET_LEN];
+    int i;
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        MakePacket(buf, i, seq);
+
+        if (sendto(peers[i].sock, buf, PacketLen(i, seq), 0,
+                   (struct sockaddr *) &server_sin, sizeof(server_sin)) < 0)
+        {
+            I_Error("Peer %i failed to send packet %i", i, seq);
+        }
+    }
+}
+
+// Echo the packets back, as the server would reply to each one.
+
+static void RunServer(int seq)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    boolean received[NUM_PEERS];
+    int num_received;
+    int peer, packet_seq;
+
+    memset(received, 0, sizeof(received));
+    num_received = 0;
+
+    while (num_received < NUM_PEERS)
+    {
+        if (!net_mmsg_module.RecvPacket(&addr, &packet))
+        {
+            if (!NET_MMSG_WaitForPacket(TIMEOUT))
+            {
+                I_Error("Server received %i of %i packets in round %i",
+                        num_received, NUM_PEERS, seq);
+            }
+
+            continue;
+        }
+
+        if (!CheckPacket(packet->data, packet->len, &peer, &packet_seq)
+         || packet_seq != seq || received[peer])
+        {
+            I_Error("Server received a bad packet (%i bytes)",
+                    (int) packet->len);
+        }
+
+        if (addr != peers[peer].addr)
+        {
+            I_Error("Packet %i from peer %i came from the wrong address",
+                    seq, peer);
+        }
+
+        net_mmsg_module.SendPacket(addr, packet);
+        NET_FreePacket(packet);
+
+        received[peer] = true;
+        ++num_received;
+    }
+
+    NET_MMSG_Flush();
+}
+
+static void CheckEchoes(int seq)
+{
+    byte buf[MAX_PACKET_LEN];
+    int len;
+    int peer, packet_seq;
+    int i;
+
+    for (i = 0; i < NUM_PEERS; ++i)
+    {
+        if (!WaitForSocket(peers[i].sock))
+        {
+            I_Error("Peer %i got no echo of packet %i", i, seq);
+        }
+
+        len = recv(peers[i].sock, buf, sizeof(buf), 0);
+
+        if (!CheckPacket(buf, len, &peer, &packet_seq)
+         || peer != i || packet_seq != seq)
+        {
+            I_Error("Peer %i got a bad echo of packet %i", i, seq);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int seq;
+
+    if (!net_mmsg_module.InitServer())
+    {
+        I_Error("Unable to initialize the server");
+    }
+
+    OpenPeers();
+    SayHello();
+
+    for (seq = 0; seq < PACKETS_PER_PEER; ++seq)
+    {
+        SendFromPeers(seq);
+        RunServer(seq);
+        CheckEchoes(seq);
+    }
+
+    printf("%i packets from %i peers echoed\n",
+           NUM_PEERS * PACKETS_PER_PEER, NUM_PEERS);
+
+    return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    // Skipped: the module is not available.
+
+    return 77;
+}
+
+#endif /* #ifdef HAVE_RECVMMSG */
+
@@ -21,12 +21,33 @@
 #include "net_packet.h"
 #include "z_zone.h"
 
+// Maximum number of freed packets kept for reuse
+
+#define MAX_POOLED_PACKETS 256
+
 static int total_packet_memory = 0;
 
+// Packets of NET_POOLED_PACKET_SIZE are not freed but kept here, to be
+// handed out again by NET_NewPacket.  This saves two allocations per
+// packet for busy servers.
+
+static net_packet_t *packet_pool[MAX_POOLED_PACKETS];
+static int num_pooled_packets = 0;
+
 net_packet_t *NET_NewPacket(int initial_size)
 {
     net_packet_t *packet;
 
+    if (initial_size <= NET_POOLED_PACKET_SIZE && num_pooled_packets > 0)
+    {
+        --num_pooled_packets;
+        packet = packet_pool[num_pooled_packets];
+        packet->len = 0;
+        packet->pos = 0;
+
+        return packet;
+    }
+
     packet = (net_packet_t *) Z_Malloc(sizeof(net_packet_t), PU_STATIC, 0);
     
     if (initial_size == 0)
@@ -61,6 +82,14 @@ net_packet_t *NET_PacketDup(net_packet_t *packet)
 void NET_FreePacket(net_packet_t *packet)
 {
     //printf("%p: destroyed\n", packet);
+
+    if (packet->alloced == NET_POOLED_PACKET_SIZE
+     && num_pooled_packets < MAX_POOLED_PACKETS)
+    {
+        packet_pool[num_pooled_packets] = packet;
+        ++num_pooled_packets;
+        return;
+    }
     
     total_packet_memory -= sizeof(net_packet_t) + packet->alloced;
     Z_Free(packet->data);
@@ -20,6 +20,12 @@
 
 #include "net_defs.h"
 
+// Packets allocated with this size are recycled when freed, rather
+// than returned to the zone.  Big enough for any UDP datagram that
+// will fit in an Ethernet frame.
+
+#define NET_POOLED_PACKET_SIZE 1500
+
 net_packet_t *NET_NewPacket(int initial_size);
 net_packet_t *NET_PacketDup(net_packet_t *packet);
 void NET_FreePacket(net_packet_t *packet);
@@ -0,0 +1,1371 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Observer relay.
+//
+// The relay connects to a game server as a single drone, and looks
+// like a game server to the drones ("observers") that connect to it.
+// Every tic received from the game server goes into one buffer that
+// is shared by all observers, and each observer is then sent the tics
+// and retransmissions that it needs from that buffer.  The game
+// server only ever sees one drone, however many observers there are.
+//
+// A relay can itself connect to another relay, so that relays can be
+// arranged in a tree.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "doomtype.h"
+#include "d_mode.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+
+#include "net_common.h"
+#include "net_defs.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_relay.h"
+#include "net_structrw.h"
+
+// Most observers that can be connected at once.
+
+#define MAX_OBSERVERS 1024
+
+// Number of tics kept for observers to catch up from.  An observer
+// that falls further behind than this is disconnected.
+
+#define RELAY_BUFFER_TICS 1024
+
+// Longest time NET_Relay_Timeout will ever ask to wait for, in ms.
+
+#define MAX_TIMEOUT 1000
+
+// Server states sent in query responses; these have the same values
+// as net_server_state_t in net_server.c.
+
+#define QUERY_STATE_WAITING_LAUNCH 0
+#define QUERY_STATE_WAITING_START  1
+#define QUERY_STATE_IN_GAME        2
+
+typedef enum
+{
+    // Waiting for the game server to have a game that we can join:
+    // that is, one that a player has joined, so that we know which
+    // game it is.
+
+    RELAY_FINDING_GAME,
+
+    // SYN sent to the game server, waiting for a reply.
+
+    RELAY_CONNECTING,
+
+    // Connected, waiting for the game to be launched.  Observers can
+    // only connect in this state.
+
+    RELAY_WAITING_LAUNCH,
+
+    // Game launched, waiting for the observers to be ready and then
+    // for the game to start.
+
+    RELAY_WAITING_START,
+
+    // In a game
+
+    RELAY_IN_GAME,
+} relay_state_t;
+
+typedef struct
+{
+    boolean active;
+    net_addr_t *addr;
+    net_connection_t connection;
+    char *name;
+
+    // If true, the observer has sent the NET_PACKET_TYPE_GAMESTART
+    // message indicating that it is ready for the game to start.
+
+    boolean ready;
+
+    // Next tic to send to the observer, and the tic that it has
+    // acknowledged receiving everything before.
+
+    unsigned int sendseq;
+    unsigned int acknowledged;
+
+    // Last time the observer acknowledged new tics.
+
+    unsigned int ack_time;
+} relay_observer_t;
+
+static boolean relay_initialized = false;
+static net_context_t *relay_context;
+static relay_state_t relay_state;
+
+// Connection to the game server:
+
+static net_addr_t *server_addr;
+static net_connection_t server_connection;
+
+// Last time a query or SYN was sent to the game server.
+
+static unsigned int server_send_time;
+
+// The game being relayed, from the game server's query response.
+
+static int gamemode;
+static int gamemission;
+static int max_players;
+
+// Latest waiting data received from the game server.
+
+static boolean have_wait_data;
+static net_waitdata_t wait_data;
+
+// Whether we have told the game server that we are ready to start.
+
+static boolean sent_ready;
+
+static net_gamesettings_t settings;
+
+// Tics received from the game server.  tics[n % RELAY_BUFFER_TICS]
+// holds tic n if its seq field is n; all tics before recv_tic have
+// been received.
+
+static net_full_ticcmd_t tics[RELAY_BUFFER_TICS];
+static unsigned int recv_tic;
+
+// Last time we sent a resend request to the game server for each tic
+// in the receive window that starts at recv_tic.
+
+static unsigned int resend_time[BACKUPTICS];
+
+// Whether we need to send an acknowledgement to the game server, and
+// when gamedata was last received.
+
+static boolean need_to_acknowledge;
+static unsigned int gamedata_recv_time;
+
+static relay_observer_t *observers;
+static int num_observers;
+
+static boolean ObserverConnected(relay_observer_t *observer)
+{
+    return observer->active
+        && observer->connection.state == NET_CONN_STATE_CONNECTED;
+}
+
+static int NET_Relay_NumObservers(void)
+{
+    int result;
+    int i;
+
+    result = 0;
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (ObserverConnected(&observers[i]))
+        {
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+static relay_observer_t *NET_Relay_FindObserver(net_addr_t *addr)
+{
+    int i;
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (observers[i].active && observers[i].addr == addr)
+        {
+            return &observers[i];
+        }
+    }
+
+    return NULL;
+}
+
+// Find a free observer slot, growing the array if there is none.
+
+static relay_observer_t *NET_Relay_NewObserver(void)
+{
+    int i;
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (!observers[i].active)
+        {
+            return &observers[i];
+        }
+    }
+
+    if (num_observers >= MAX_OBSERVERS)
+    {
+        return NULL;
+    }
+
+    observers = I_Realloc(observers,
+                          sizeof(relay_observer_t) * (num_observers + 1));
+    observers[num_observers].active = false;
+
+    return &observers[num_observers++];
+}
+
+static void NET_Relay_SendConsoleMessage(relay_observer_t *observer,
+                                         const char *msg)
+{
+    net_packet_t *packet;
+
+    packet = NET_Conn_NewReliable(&observer->connection,
+                                  NET_PACKET_TYPE_CONSOLE_MESSAGE);
+    NET_WriteString(packet, msg);
+}
+
+static void NET_Relay_SendReject(net_addr_t *addr, const char *msg)
+{
+    net_packet_t *packet;
+
+    NET_Log("relay: sending reject to %s", NET_AddrToString(addr));
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_REJECTED);
+    NET_WriteString(packet, msg);
+    NET_SendPacket(addr, packet);
+    NET_FreePacket(packet);
+}
+
+// Send the waiting data from the game server on to an observer, with
+// our observers counted among the drones.
+
+static void NET_Relay_SendWaitingData(relay_observer_t *observer)
+{
+    net_waitdata_t observer_wait_data;
+    net_packet_t *packet;
+
+    observer_wait_data = wait_data;
+    observer_wait_data.num_drones += NET_Relay_NumObservers() - 1;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_WAITING_DATA);
+    NET_WriteWaitData(packet, &observer_wait_data);
+    NET_Conn_SendPacket(&observer->connection, packet);
+    NET_FreePacket(packet);
+}
+
+// Called when the connection to the game server is lost, or the game
+// ends.  Disconnect all observers and look for the next game.
+
+static void NET_Relay_GameEnded(void)
+{
+    int i;
+
+    NET_Log("relay: game ended, disconnecting all observers");
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (observers[i].active)
+        {
+            NET_Conn_Disconnect(&observers[i].connection);
+        }
+    }
+
+    relay_state = RELAY_FINDING_GAME;
+    server_send_time = I_GetTimeMS() - 1000;
+}
+
+//
+// Game server side
+//
+
+static void NET_Relay_SendQuery(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_QUERY);
+    NET_SendPacket(server_addr, packet);
+    NET_FreePacket(packet);
+}
+
+static void NET_Relay_SendSYN(void)
+{
+    net_connect_data_t data;
+    net_packet_t *packet;
+
+    NET_Log("relay: sending SYN to %s", NET_AddrToString(server_addr));
+
+    memset(&data, 0, sizeof(data));
+    data.gamemode = gamemode;
+    data.gamemission = gamemission;
+    data.drone = true;
+    data.max_players = max_players;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteString(packet, PACKAGE_STRING);
+    NET_WriteProtocolList(packet);
+    NET_WriteConnectData(packet, &data);
+    NET_WriteString(packet, "Relay");
+    NET_Conn_SendPacket(&server_connection, packet);
+    NET_FreePacket(packet);
+}
+
+// A query response tells us whether the game server has a game that
+// we can join, and which game it is.
+
+static void NET_Relay_ParseQueryResponse(net_packet_t *packet)
+{
+    net_querydata_t querydata;
+
+    if (relay_state != RELAY_FINDING_GAME
+     || !NET_ReadQueryData(packet, &querydata))
+    {
+        return;
+    }
+
+    if (querydata.server_state != QUERY_STATE_WAITING_LAUNCH
+     || querydata.num_players <= 0
+     || !D_ValidGameMode(querydata.gamemission, querydata.gamemode))
+    {
+        NET_Log("relay: no game to join yet, state=%d, num_players=%d",
+                querydata.server_state, querydata.num_players);
+        return;
+    }
+
+    gamemode = querydata.gamemode;
+    gamemission = querydata.gamemission;
+    max_players = querydata.max_players;
+
+    NET_Log("relay: joining game, mode=%d, mission=%d",
+            gamemode, gamemission);
+
+    NET_Conn_InitClient(&server_connection, server_addr, NET_PROTOCOL_UNKNOWN);
+    relay_state = RELAY_CONNECTING;
+    have_wait_data = false;
+    sent_ready = false;
+
+    NET_Relay_SendSYN();
+    server_send_time = I_GetTimeMS();
+}
+
+static void NET_Relay_ParseSYN(net_packet_t *packet)
+{
+    net_protocol_t protocol;
+    char *server_version;
+
+    if (relay_state != RELAY_CONNECTING)
+    {
+        return;
+    }
+
+    server_version = NET_ReadSafeString(packet);
+    protocol = NET_ReadProtocol(packet);
+
+    if (server_version == NULL || protocol == NET_PROTOCOL_UNKNOWN)
+    {
+        NET_Log("relay: error: bad SYN response from server");
+        return;
+    }
+
+    NET_Log("relay: connected to server");
+    server_connection.state = NET_CONN_STATE_CONNECTED;
+    server_connection.protocol = protocol;
+    relay_state = RELAY_WAITING_LAUNCH;
+
+    printf("Relaying game from %s (%s, %s)\n",
+           NET_AddrToString(server_addr),
+           D_GameMissionString(gamemission), D_GameModeString(gamemode));
+}
+
+static void NET_Relay_ParseReject(net_packet_t *packet)
+{
+    char *msg;
+
+    msg = NET_ReadSafeString(packet);
+
+    if (msg == NULL || relay_state != RELAY_CONNECTING)
+    {
+        return;
+    }
+
+    fprintf(stderr, "NET_Relay_ParseReject: Rejected by server: %s\n", msg);
+
+    // Try again with the next game.
+
+    relay_state = RELAY_FINDING_GAME;
+}
+
+static void NET_Relay_ParseWaitingData(net_packet_t *packet)
+{
+    int i;
+
+    if (!NET_ReadWaitData(packet, &wait_data)
+     || wait_data.num_players > NET_MAXPLAYERS)
+    {
+        return;
+    }
+
+    have_wait_data = true;
+
+    // Pass it straight on.  Once the game has been launched, the game
+    // server only sends this to clients that are ready to start.
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (ObserverConnected(&observers[i])
+         && (relay_state == RELAY_WAITING_LAUNCH
+          || (relay_state == RELAY_WAITING_START && observers[i].ready)))
+        {
+            NET_Relay_SendWaitingData(&observers[i]);
+        }
+    }
+}
+
+static void NET_Relay_ParseLaunch(net_packet_t *packet)
+{
+    net_packet_t *launchpacket;
+    unsigned int num_players;
+    int i;
+
+    if (relay_state != RELAY_WAITING_LAUNCH
+     || !NET_ReadInt8(packet, &num_players))
+    {
+        return;
+    }
+
+    NET_Log("relay: game launched, sending launch to all observers");
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (!ObserverConnected(&observers[i]))
+        {
+            continue;
+        }
+
+        launchpacket = NET_Conn_NewReliable(&observers[i].connection,
+                                            NET_PACKET_TYPE_LAUNCH);
+        NET_WriteInt8(launchpacket, num_players);
+    }
+
+    relay_state = RELAY_WAITING_START;
+}
+
+static void NET_Relay_ParseGameStart(net_packet_t *packet)
+{
+    net_gamesettings_t new_settings;
+    net_packet_t *startpacket;
+    int i;
+
+    if (relay_state != RELAY_WAITING_START
+     || !NET_ReadSettings(packet, &new_settings))
+    {
+        return;
+    }
+
+    if (new_settings.num_players > NET_MAXPLAYERS
+     || new_settings.consoleplayer >= 0)
+    {
+        NET_Log("relay: error: bad settings, num_players=%d, "
+                "consoleplayer=%d",
+                new_settings.num_players, new_settings.consoleplayer);
+        return;
+    }
+
+    settings = new_settings;
+
+    NET_Log("relay: beginning game state");
+    relay_state = RELAY_IN_GAME;
+
+    memset(tics, 0xff, sizeof(tics));
+    memset(resend_time, 0, sizeof(resend_time));
+    recv_tic = 0;
+    need_to_acknowledge = false;
+    gamedata_recv_time = I_GetTimeMS();
+
+    // The settings are the same for all drones, so they can be passed
+    // on unchanged.
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (!ObserverConnected(&observers[i]))
+        {
+            continue;
+        }
+
+        observers[i].sendseq = 0;
+        observers[i].acknowledged = 0;
+        observers[i].ack_time = gamedata_recv_time;
+
+        startpacket = NET_Conn_NewReliable(&observers[i].connection,
+                                           NET_PACKET_TYPE_GAMESTART);
+        NET_WriteSettings(startpacket, &settings);
+    }
+}
+
+static void NET_Relay_SendGameDataACK(void)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
+    NET_WriteInt8(packet, recv_tic & 0xff);
+    NET_Conn_SendPacket(&server_connection, packet);
+    NET_FreePacket(packet);
+
+    need_to_acknowledge = false;
+}
+
+static void NET_Relay_SendResendRequest(unsigned int start, unsigned int end)
+{
+    net_packet_t *packet;
+    unsigned int nowtime;
+    unsigned int i;
+
+    NET_Log("relay: send resend to server for tics %d-%d", start, end);
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_RESEND);
+    NET_WriteInt32(packet, start);
+    NET_WriteInt8(packet, end - start + 1);
+    NET_Conn_SendPacket(&server_connection, packet);
+    NET_FreePacket(packet);
+
+    nowtime = I_GetTimeMS();
+
+    for (i=start; i<=end; ++i)
+    {
+        resend_time[i % BACKUPTICS] = nowtime;
+    }
+}
+
+static boolean HaveTic(unsigned int seq)
+{
+    return tics[seq % RELAY_BUFFER_TICS].seq == seq;
+}
+
+static void NET_Relay_ParseGameData(net_packet_t *packet)
+{
+    net_ticstream_t stream;
+    net_full_ticcmd_t cmd;
+    unsigned int seq, num_tics;
+    unsigned int resend_start;
+    unsigned int i;
+
+    if (relay_state != RELAY_IN_GAME
+     || !NET_ReadInt8(packet, &seq)
+     || !NET_ReadInt8(packet, &num_tics))
+    {
+        return;
+    }
+
+    if (!need_to_acknowledge)
+    {
+        need_to_acknowledge = true;
+        gamedata_recv_time = I_GetTimeMS();
+    }
+
+    seq = NET_ExpandTicNum(recv_tic, seq);
+
+    NET_TicStream_Init(&stream, packet, server_connection.protocol,
+                       settings.lowres_turn);
+
+    for (i=0; i<num_tics; ++i)
+    {
+        if (!NET_TicStream_ReadTic(&stream, &cmd))
+        {
+            NET_Log("relay: error: failed to read ticcmd %d", i);
+            return;
+        }
+
+        // Only tics in the receive window can be stored; anything past
+        // it could overwrite tics that observers still need.
+
+        if (seq + i < recv_tic || seq + i >= recv_tic + BACKUPTICS)
+        {
+            continue;
+        }
+
+        cmd.seq = seq + i;
+        tics[cmd.seq % RELAY_BUFFER_TICS] = cmd;
+        resend_time[cmd.seq % BACKUPTICS] = 0;
+    }
+
+    // Tics before this packet still missing, that have not already
+    // been asked for?  Request them.
+
+    if (seq > recv_tic + BACKUPTICS)
+    {
+        seq = recv_tic + BACKUPTICS;
+    }
+
+    resend_start = seq;
+
+    while (resend_start > recv_tic
+        && !HaveTic(resend_start - 1)
+        && resend_time[(resend_start - 1) % BACKUPTICS] == 0)
+    {
+        --resend_start;
+    }
+
+    if (resend_start < seq)
+    {
+        NET_Relay_SendResendRequest(resend_start, seq - 1);
+    }
+
+    while (HaveTic(recv_tic))
+    {
+        ++recv_tic;
+    }
+}
+
+// As NET_CL_CheckResends, for the game server connection.
+
+static void NET_Relay_CheckResends(void)
+{
+    unsigned int nowtime;
+    unsigned int seq;
+    int resend_start, resend_end;
+    boolean need_resend;
+    int i;
+
+    nowtime = I_GetTimeMS();
+    resend_start = -1;
+    resend_end = -1;
+
+    for (i=0; i<BACKUPTICS; ++i)
+    {
+        seq = recv_tic + i;
+
+        need_resend = !HaveTic(seq)
+                   && resend_time[seq % BACKUPTICS] != 0
+                   && nowtime > resend_time[seq % BACKUPTICS] + 300;
+
+        // Nothing received in a long time: the tics that would have
+        // triggered a resend request may all have been lost.
+
+        if (i == 0 && !HaveTic(seq) && resend_time[seq % BACKUPTICS] == 0
+         && nowtime - gamedata_recv_time > 1000)
+        {
+            need_resend = true;
+        }
+
+        if (need_resend)
+        {
+            if (resend_start < 0)
+            {
+                resend_start = i;
+            }
+
+            resend_end = i;
+        }
+        else if (resend_start >= 0)
+        {
+            NET_Relay_SendResendRequest(recv_tic + resend_start,
+                                        recv_tic + resend_end);
+            resend_start = -1;
+        }
+    }
+
+    if (resend_start >= 0)
+    {
+        NET_Relay_SendResendRequest(recv_tic + resend_start,
+                                    recv_tic + resend_end);
+    }
+
+    // We never send game data, which would carry the acknowledgement,
+    // so send it on its own.
+
+    if (need_to_acknowledge && nowtime - gamedata_recv_time > 200)
+    {
+        NET_Relay_SendGameDataACK();
+    }
+}
+
+static void NET_Relay_ServerPacket(net_packet_t *packet)
+{
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    NET_Log("relay: packet from server, type %d",
+            packet_type & ~NET_RELIABLE_PACKET);
+    NET_LogPacket(packet);
+
+    if (relay_state == RELAY_FINDING_GAME)
+    {
+        if (packet_type == NET_PACKET_TYPE_QUERY_RESPONSE)
+        {
+            NET_Relay_ParseQueryResponse(packet);
+        }
+    }
+    else if (NET_Conn_Packet(&server_connection, packet, &packet_type))
+    {
+        // Packet eaten by the common connection code
+    }
+    else
+    {
+        switch (packet_type)
+        {
+            case NET_PACKET_TYPE_SYN:
+                NET_Relay_ParseSYN(packet);
+                break;
+
+            case NET_PACKET_TYPE_REJECTED:
+                NET_Relay_ParseReject(packet);
+                break;
+
+            case NET_PACKET_TYPE_WAITING_DATA:
+                NET_Relay_ParseWaitingData(packet);
+                break;
+
+            case NET_PACKET_TYPE_LAUNCH:
+                NET_Relay_ParseLaunch(packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMESTART:
+                NET_Relay_ParseGameStart(packet);
+                break;
+
+            case NET_PACKET_TYPE_GAMEDATA:
+                NET_Relay_ParseGameData(packet);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+static boolean AllObserversReady(void)
+{
+    int i;
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (ObserverConnected(&observers[i]) && !observers[i].ready)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void NET_Relay_RunServer(void)
+{
+    net_gamesettings_t no_settings;
+    net_packet_t *packet;
+    unsigned int nowtime;
+
+    nowtime = I_GetTimeMS();
+
+    switch (relay_state)
+    {
+        case RELAY_FINDING_GAME:
+            if (nowtime - server_send_time > 1000)
+            {
+                NET_Relay_SendQuery();
+                server_send_time = nowtime;
+            }
+            return;
+
+        case RELAY_CONNECTING:
+            if (nowtime - server_send_time > 5000)
+            {
+                NET_Log("relay: no response to SYN");
+                relay_state = RELAY_FINDING_GAME;
+                return;
+            }
+            if (nowtime - server_send_time > 1000)
+            {
+                NET_Relay_SendSYN();
+            }
+            return;
+
+        default:
+            break;
+    }
+
+    NET_Conn_Run(&server_connection);
+
+    if (server_connection.state == NET_CONN_STATE_DISCONNECTED
+     || server_connection.state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        NET_Log("relay: disconnected from server");
+        NET_Relay_GameEnded();
+        return;
+    }
+
+    // The game server waits for us to be ready before starting the
+    // game, so wait for all our observers to be ready first; otherwise
+    // they would miss the start of the game.
+
+    if (relay_state == RELAY_WAITING_START && !sent_ready
+     && AllObserversReady())
+    {
+        NET_Log("relay: all observers ready, telling server");
+
+        // Only the controller's settings are used.
+
+        memset(&no_settings, 0, sizeof(no_settings));
+        packet = NET_Conn_NewReliable(&server_connection,
+                                      NET_PACKET_TYPE_GAMESTART);
+        NET_WriteSettings(packet, &no_settings);
+        sent_ready = true;
+    }
+
+    if (relay_state == RELAY_IN_GAME)
+    {
+        NET_Relay_CheckResends();
+    }
+}
+
+//
+// Observer side
+//
+
+static void NET_Relay_ParseObserverSYN(net_packet_t *packet,
+                                       relay_observer_t *observer,
+                                       net_addr_t *addr)
+{
+    unsigned int magic;
+    net_connect_data_t data;
+    net_packet_t *reply;
+    net_protocol_t protocol;
+    char *player_name;
+
+    NET_Log("relay: processing SYN packet");
+
+    if (!NET_ReadInt32(packet, &magic) || magic != NET_MAGIC_NUMBER
+     || NET_ReadString(packet) == NULL)
+    {
+        NET_Log("relay: error: bad magic number or version");
+        return;
+    }
+
+    protocol = NET_ReadProtocolList(packet);
+    if (protocol == NET_PROTOCOL_UNKNOWN)
+    {
+        NET_Relay_SendReject(addr,
+            "Version mismatch: no common compatible protocol could be "
+            "negotiated with this relay, which is running "
+            PACKAGE_STRING ".");
+        return;
+    }
+
+    if (!NET_ReadConnectData(packet, &data)
+     || (player_name = NET_ReadString(packet)) == NULL)
+    {
+        NET_Log("relay: error: failed to read connect data");
+        return;
+    }
+
+    // Already connected?  A recently-disconnected observer may
+    // reconnect straight away.
+
+    if (observer != NULL)
+    {
+        if (observer->connection.state != NET_CONN_STATE_DISCONNECTED)
+        {
+            NET_Log("relay: observer already connected (duplicate SYN?)");
+            return;
+        }
+
+        observer->active = false;
+    }
+
+    if (!data.drone)
+    {
+        NET_Relay_SendReject(addr,
+                             "This is a relay: only observers can join, "
+                             "using -drone.");
+        return;
+    }
+
+    if (relay_state != RELAY_WAITING_LAUNCH)
+    {
+        NET_Relay_SendReject(addr,
+                             relay_state < RELAY_WAITING_LAUNCH ?
+                             "Relay is not connected to a game yet" :
+                             "Relay is not currently accepting connections");
+        return;
+    }
+
+    if (data.gamemode != gamemode || data.gamemission != gamemission)
+    {
+        char msg[128];
+
+        M_snprintf(msg, sizeof(msg),
+                   "Game mismatch: server is %s (%s), client is %s (%s)",
+                   D_GameMissionString(gamemission),
+                   D_GameModeString(gamemode),
+                   D_GameMissionString(data.gamemission),
+                   D_GameModeString(data.gamemode));
+        NET_Relay_SendReject(addr, msg);
+        return;
+    }
+
+    if (observer == NULL)
+    {
+        observer = NET_Relay_NewObserver();
+
+        if (observer == NULL)
+        {
+            NET_Relay_SendReject(addr, "Relay is full!");
+            return;
+        }
+    }
+
+    observer->active = true;
+    observer->addr = addr;
+    NET_ReferenceAddress(addr);
+    NET_Conn_InitServer(&observer->connection, addr, protocol);
+    observer->name = M_StringDuplicate(player_name);
+    observer->ready = false;
+    observer->sendseq = 0;
+    observer->acknowledged = 0;
+
+    NET_Log("relay: new observer from %s", NET_AddrToString(addr));
+
+    reply = NET_Conn_NewReliable(&observer->connection, NET_PACKET_TYPE_SYN);
+    NET_WriteString(reply, PACKAGE_STRING);
+    NET_WriteProtocol(reply, protocol);
+
+    if (have_wait_data)
+    {
+        NET_Relay_SendWaitingData(observer);
+    }
+}
+
+static void NET_Relay_SendTics(relay_observer_t *observer,
+                               unsigned int start, unsigned int end)
+{
+    net_packet_t *packet;
+    net_ticstream_t stream;
+    unsigned int i;
+
+    packet = NET_NewPacket(500);
+
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt8(packet, start & 0xff);
+    NET_WriteInt8(packet, end - start + 1);
+
+    NET_TicStream_Init(&stream, packet, observer->connection.protocol,
+                       settings.lowres_turn);
+
+    for (i=start; i<=end; ++i)
+    {
+        NET_TicStream_WriteTic(&stream, &tics[i % RELAY_BUFFER_TICS]);
+    }
+
+    NET_TicStream_Finish(&stream);
+
+    NET_Conn_SendPacket(&observer->connection, packet);
+    NET_FreePacket(packet);
+}
+
+static void NET_Relay_ParseGameDataACK(net_packet_t *packet,
+                                       relay_observer_t *observer)
+{
+    unsigned int ackseq;
+
+    if (relay_state != RELAY_IN_GAME || !NET_ReadInt8(packet, &ackseq))
+    {
+        return;
+    }
+
+    ackseq = NET_ExpandTicNum(observer->acknowledged, ackseq);
+
+    if (ackseq > observer->acknowledged && ackseq <= observer->sendseq)
+    {
+        observer->acknowledged = ackseq;
+        observer->ack_time = I_GetTimeMS();
+    }
+}
+
+static void NET_Relay_ParseResendRequest(net_packet_t *packet,
+                                         relay_observer_t *observer)
+{
+    unsigned int start, last, num_tics;
+    unsigned int i;
+
+    if (relay_state != RELAY_IN_GAME
+     || !NET_ReadInt32(packet, &start)
+     || !NET_ReadInt8(packet, &num_tics)
+     || num_tics == 0)
+    {
+        return;
+    }
+
+    if (start >= observer->sendseq)
+    {
+        return;
+    }
+
+    last = start + num_tics - 1;
+
+    if (last >= observer->sendseq)
+    {
+        last = observer->sendseq - 1;
+    }
+
+    for (i=start; i<=last; ++i)
+    {
+        if (!HaveTic(i))
+        {
+            NET_Log("relay: error: don't have tic %d any more, "
+                    "can't resend", i);
+            return;
+        }
+    }
+
+    NET_Log("relay: resending tics %d-%d to %s", start, last,
+            NET_AddrToString(observer->addr));
+    NET_Relay_SendTics(observer, start, last);
+}
+
+// Answer a query as a game server would, so that a relay can itself
+// be relayed.  We have a game to offer once we are connected to one.
+
+static void NET_Relay_SendQueryResponse(net_addr_t *addr)
+{
+    net_querydata_t querydata;
+    net_packet_t *reply;
+    int p;
+
+    querydata.version = PACKAGE_STRING;
+    querydata.gamemode = gamemode;
+    querydata.gamemission = gamemission;
+    querydata.max_players = max_players;
+
+    switch (relay_state)
+    {
+        case RELAY_WAITING_START:
+            querydata.server_state = QUERY_STATE_WAITING_START;
+            break;
+
+        case RELAY_IN_GAME:
+            querydata.server_state = QUERY_STATE_IN_GAME;
+            break;
+
+        default:
+            querydata.server_state = QUERY_STATE_WAITING_LAUNCH;
+            break;
+    }
+
+    if (relay_state >= RELAY_WAITING_LAUNCH && have_wait_data)
+    {
+        querydata.num_players = wait_data.num_players;
+    }
+    else
+    {
+        querydata.num_players = 0;
+    }
+
+    p = M_CheckParmWithArgs("-servername", 1);
+
+    if (p > 0)
+    {
+        querydata.description = myargv[p + 1];
+    }
+    else
+    {
+        querydata.description = "Relay";
+    }
+
+    reply = NET_NewPacket(64);
+    NET_WriteInt16(reply, NET_PACKET_TYPE_QUERY_RESPONSE);
+    NET_WriteQueryData(reply, &querydata);
+    NET_SendPacket(addr, reply);
+    NET_FreePacket(reply);
+}
+
+static void NET_Relay_ObserverPacket(net_packet_t *packet, net_addr_t *addr)
+{
+    relay_observer_t *observer;
+    unsigned int packet_type;
+
+    observer = NET_Relay_FindObserver(addr);
+
+    if (!NET_ReadInt16(packet, &packet_type))
+    {
+        return;
+    }
+
+    NET_Log("relay: packet from %s; type %d", NET_AddrToString(addr),
+            packet_type & ~NET_RELIABLE_PACKET);
+    NET_LogPacket(packet);
+
+    if (packet_type == NET_PACKET_TYPE_SYN)
+    {
+        NET_Relay_ParseObserverSYN(packet, observer, addr);
+    }
+    else if (packet_type == NET_PACKET_TYPE_QUERY)
+    {
+        NET_Relay_SendQueryResponse(addr);
+    }
+    else if (observer == NULL)
+    {
+        // Must come from a valid observer; ignore otherwise
+    }
+    else if (NET_Conn_Packet(&observer->connection, packet, &packet_type))
+    {
+        // Packet was eaten by the common connection code
+    }
+    else
+    {
+        switch (packet_type)
+        {
+            case NET_PACKET_TYPE_GAMESTART:
+                if (relay_state == RELAY_WAITING_START)
+                {
+                    observer->ready = true;
+                }
+                break;
+            case NET_PACKET_TYPE_GAMEDATA_ACK:
+                NET_Relay_ParseGameDataACK(packet, observer);
+                break;
+            case NET_PACKET_TYPE_GAMEDATA_RESEND:
+                NET_Relay_ParseResendRequest(packet, observer);
+                break;
+            default:
+                // Observers do not launch games or send game data.
+                break;
+        }
+    }
+}
+
+// Send an observer any new tics that it can take.  Unlike the game
+// server, each observer goes at its own pace: a slow observer does
+// not hold back the others.
+
+static void NET_Relay_PumpObserver(relay_observer_t *observer)
+{
+    unsigned int nowtime;
+    unsigned int starttic;
+
+    if (recv_tic + BACKUPTICS > observer->acknowledged + RELAY_BUFFER_TICS)
+    {
+        NET_Log("relay: %s fell too far behind",
+                NET_AddrToString(observer->addr));
+        NET_Relay_SendConsoleMessage(observer,
+                                     "Disconnected: fell too far behind "
+                                     "the relay.");
+        NET_Conn_Disconnect(&observer->connection);
+        return;
+    }
+
+    while (observer->sendseq < recv_tic
+        && observer->sendseq - observer->acknowledged <= 40)
+    {
+        starttic = observer->sendseq;
+
+        if (starttic > (unsigned int) settings.extratics)
+        {
+            starttic -= settings.extratics;
+        }
+        else
+        {
+            starttic = 0;
+        }
+
+        NET_Relay_SendTics(observer, starttic, observer->sendseq);
+        ++observer->sendseq;
+    }
+
+    // Observers only acknowledge tics when they receive some, so if
+    // an acknowledgement is lost when we have stopped sending to wait
+    // for one, neither side would send anything more.  As in
+    // NET_SV_CheckDeadlock, send the last tic again to get things
+    // moving.
+
+    nowtime = I_GetTimeMS();
+
+    if (observer->acknowledged < observer->sendseq
+     && nowtime - observer->ack_time > 1000)
+    {
+        NET_Log("relay: no acknowledgement from %s since %d - deadlock?",
+                NET_AddrToString(observer->addr), observer->ack_time);
+        NET_Relay_SendTics(observer, observer->sendseq - 1,
+                           observer->sendseq - 1);
+        observer->ack_time = nowtime;
+    }
+}
+
+static void NET_Relay_RunObserver(relay_observer_t *observer)
+{
+    NET_Conn_Run(&observer->connection);
+
+    if (observer->connection.state == NET_CONN_STATE_DISCONNECTED)
+    {
+        NET_Log("relay: observer at %s disconnected",
+                NET_AddrToString(observer->addr));
+        observer->active = false;
+        free(observer->name);
+        NET_ReleaseAddress(observer->addr);
+        return;
+    }
+
+    if (ObserverConnected(observer) && relay_state == RELAY_IN_GAME)
+    {
+        NET_Relay_PumpObserver(observer);
+    }
+}
+
+void NET_Relay_Init(net_module_t *module, const char *server_address)
+{
+    relay_context = NET_NewContext();
+    module->InitServer();
+    NET_AddModule(relay_context, module);
+
+    server_addr = NET_ResolveAddress(relay_context, server_address);
+
+    if (server_addr == NULL)
+    {
+        I_Error("NET_Relay_Init: Unable to resolve server address '%s'",
+                server_address);
+    }
+
+    observers = NULL;
+    num_observers = 0;
+
+    relay_state = RELAY_FINDING_GAME;
+    server_send_time = I_GetTimeMS() - 1001;
+    relay_initialized = true;
+}
+
+void NET_Relay_Run(void)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int i;
+
+    if (!relay_initialized)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(relay_context, &addr, &packet))
+    {
+        if (addr == server_addr)
+        {
+            NET_Relay_ServerPacket(packet);
+        }
+        else
+        {
+            NET_Relay_ObserverPacket(packet, addr);
+        }
+
+        NET_FreePacket(packet);
+        NET_ReleaseAddress(addr);
+    }
+
+    NET_Relay_RunServer();
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (observers[i].active)
+        {
+            NET_Relay_RunObserver(&observers[i]);
+        }
+    }
+}
+
+int NET_Relay_Timeout(void)
+{
+    unsigned int nowtime;
+    unsigned int seq;
+    int timeout;
+    int i;
+
+    if (!relay_initialized)
+    {
+        return 0;
+    }
+
+    nowtime = I_GetTimeMS();
+    timeout = MAX_TIMEOUT;
+
+    // Timing checks made by NET_Relay_RunServer and the functions it
+    // calls; the +1s are because they only act once a period has
+    // strictly passed.
+
+    if (relay_state == RELAY_FINDING_GAME || relay_state == RELAY_CONNECTING)
+    {
+        NET_WakeBy(&timeout, nowtime, server_send_time + 1001);
+    }
+    else
+    {
+        NET_Conn_NextTimeout(&server_connection, &timeout);
+    }
+
+    if (relay_state == RELAY_IN_GAME)
+    {
+        if (need_to_acknowledge)
+        {
+            NET_WakeBy(&timeout, nowtime, gamedata_recv_time + 201);
+        }
+
+        for (i=0; i<BACKUPTICS; ++i)
+        {
+            seq = recv_tic + i;
+
+            if (HaveTic(seq))
+            {
+                continue;
+            }
+
+            if (resend_time[seq % BACKUPTICS] != 0)
+            {
+                NET_WakeBy(&timeout, nowtime,
+                           resend_time[seq % BACKUPTICS] + 301);
+            }
+            else if (i == 0)
+            {
+                NET_WakeBy(&timeout, nowtime, gamedata_recv_time + 1001);
+            }
+        }
+    }
+
+    for (i=0; i<num_observers; ++i)
+    {
+        if (!observers[i].active)
+        {
+            continue;
+        }
+
+        NET_Conn_NextTimeout(&observers[i].connection, &timeout);
+
+        if (relay_state == RELAY_IN_GAME
+         && observers[i].acknowledged < observers[i].sendseq)
+        {
+            NET_WakeBy(&timeout, nowtime, observers[i].ack_time + 1001);
+        }
+    }
+
+    return timeout;
+}
+
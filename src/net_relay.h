@@ -0,0 +1,38 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Observer relay: joins a game server as a single drone and passes
+// the game on to any number of drones connected to the relay.
+//
+
+#ifndef NET_RELAY_H
+#define NET_RELAY_H
+
+#include "net_defs.h"
+
+// Initialize the relay, listening with the given module, to relay
+// games from the server at the given address.
+
+void NET_Relay_Init(net_module_t *module, const char *server_address);
+
+// Run the relay: check for new packets received etc.
+
+void NET_Relay_Run(void);
+
+// Time in ms until NET_Relay_Run next needs to be called, if no
+// packets arrive in the meantime.
+
+int NET_Relay_Timeout(void);
+
+#endif /* #ifndef NET_RELAY_H */
+
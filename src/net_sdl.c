@@ -21,8 +21,10 @@
 
 #include "doomtype.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "m_argv.h"
 #include "m_misc.h"
+#include "net_addrtable.h"
 #include "net_defs.h"
 #include "net_io.h"
 #include "net_packet.h"
@@ -45,6 +47,7 @@ static boolean initted = false;
 static int port = DEFAULT_PORT;
 static UDPsocket udpsocket;
 static UDPpacket *recvpacket;
+static SDLNet_SocketSet socketset;
 
 typedef struct
 {
@@ -52,109 +55,61 @@ typedef struct
     IPaddress sdl_addr;
 } addrpair_t;
 
-static addrpair_t **addr_table;
-static int addr_table_size = -1;
+static net_addrtable_t addr_table;
+static boolean addr_table_initted = false;
 
-// Initializes the address table
-
-static void NET_SDL_InitAddrTable(void)
-{
-    addr_table_size = 16;
-
-    addr_table = Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
-                          PU_STATIC, 0);
-    memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
-}
-
-static boolean AddressesEqual(IPaddress *a, IPaddress *b)
-{
-    return a->host == b->host
-        && a->port == b->port;
-}
-
-// Finds an address by searching the table.  If the address is not found,
-// it is added to the table.
+// Finds an address by looking it up in the table.  If the address is
+// not found, it is added to the table.
 
 static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
 {
     addrpair_t *new_entry;
-    int empty_entry = -1;
-    int i;
-
-    if (addr_table_size < 0)
-    {
-        NET_SDL_InitAddrTable();
-    }
+    net_addr_t *result;
 
-    for (i=0; i<addr_table_size; ++i)
+    if (!addr_table_initted)
     {
-        if (addr_table[i] != NULL
-         && AddressesEqual(addr, &addr_table[i]->sdl_addr))
-        {
-            return &addr_table[i]->net_addr;
-        }
-
-        if (empty_entry < 0 && addr_table[i] == NULL)
-            empty_entry = i;
+        NET_AddrTable_Init(&addr_table);
+        addr_table_initted = true;
     }
 
-    // Was not found in list.  We need to add it.
+    result = NET_AddrTable_Find(&addr_table, addr->host, addr->port);
 
-    // Is there any space in the table? If not, increase the table size
-
-    if (empty_entry < 0)
+    if (result != NULL)
     {
-        addrpair_t **new_addr_table;
-        int new_addr_table_size;
-
-        // after reallocing, we will add this in as the first entry
-        // in the new block of memory
-
-        empty_entry = addr_table_size;
-        
-        // allocate a new array twice the size, init to 0 and copy 
-        // the existing table in.  replace the old table.
-
-        new_addr_table_size = addr_table_size * 2;
-        new_addr_table = Z_Malloc(sizeof(addrpair_t *) * new_addr_table_size,
-                                  PU_STATIC, 0);
-        memset(new_addr_table, 0, sizeof(addrpair_t *) * new_addr_table_size);
-        memcpy(new_addr_table, addr_table, 
-               sizeof(addrpair_t *) * addr_table_size);
-        Z_Free(addr_table);
-        addr_table = new_addr_table;
-        addr_table_size = new_addr_table_size;
+        return result;
     }
 
-    // Add a new entry
-    
+    // Was not found in the table.  We need to add it.
+
     new_entry = Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
 
     new_entry->sdl_addr = *addr;
     new_entry->net_addr.refcount = 0;
     new_entry->net_addr.handle = &new_entry->sdl_addr;
+    new_entry->net_addr.server_client = NULL;
     new_entry->net_addr.module = &net_sdl_module;
 
-    addr_table[empty_entry] = new_entry;
+    NET_AddrTable_Add(&addr_table, addr->host, addr->port,
+                      &new_entry->net_addr);
 
     return &new_entry->net_addr;
 }
 
 static void NET_SDL_FreeAddress(net_addr_t *addr)
 {
-    int i;
-    
-    for (i=0; i<addr_table_size; ++i)
+    IPaddress *ip;
+
+    ip = (IPaddress *) addr->handle;
+
+    if (!addr_table_initted
+     || !NET_AddrTable_Remove(&addr_table, ip->host, ip->port))
     {
-        if (addr == &addr_table[i]->net_addr)
-        {
-            Z_Free(addr_table[i]);
-            addr_table[i] = NULL;
-            return;
-        }
+        I_Error("NET_SDL_FreeAddress: Attempted to remove an unused address!");
     }
 
-    I_Error("NET_SDL_FreeAddress: Attempted to remove an unused address!");
+    // The net_addr_t is the first member of the addrpair_t.
+
+    Z_Free(addr);
 }
 
 static boolean NET_SDL_InitClient(void)
@@ -304,6 +259,45 @@ static boolean NET_SDL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
     return true;
 }
 
+// Block until a packet is waiting to be received, or until timeout
+// ms have passed.  Returns true if there is a packet.
+
+boolean NET_SDL_WaitForPacket(int timeout)
+{
+    int result;
+
+    if (!initted)
+    {
+        I_Sleep(timeout);
+        return false;
+    }
+
+    if (socketset == NULL)
+    {
+        socketset = SDLNet_AllocSocketSet(1);
+
+        if (socketset == NULL)
+        {
+            I_Error("NET_SDL_WaitForPacket: Unable to allocate socket set: %s",
+                    SDLNet_GetError());
+        }
+
+        SDLNet_UDP_AddSocket(socketset, udpsocket);
+    }
+
+    result = SDLNet_CheckSockets(socketset, timeout);
+
+    if (result < 0)
+    {
+        // Can happen if interrupted by a signal; just let the caller
+        // go round its loop again.
+
+        return false;
+    }
+
+    return result > 0;
+}
+
 void NET_SDL_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
 {
     IPaddress *ip;
@@ -426,6 +420,13 @@ net_addr_t *NET_NULL_ResolveAddress(const char *address)
 }
 
 
+boolean NET_SDL_WaitForPacket(int timeout)
+{
+    I_Sleep(timeout);
+    return false;
+}
+
+
 net_module_t net_sdl_module =
 {
     NET_NULL_InitClient,
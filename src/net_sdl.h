@@ -22,5 +22,7 @@
 
 extern net_module_t net_sdl_module;
 
+boolean NET_SDL_WaitForPacket(int timeout);
+
 #endif /* #ifndef NET_SDL_H */
 
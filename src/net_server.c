@@ -31,12 +31,14 @@
 #include "net_client.h"
 #include "net_common.h"
 #include "net_defs.h"
+#include "net_demo.h"
 #include "net_io.h"
 #include "net_loop.h"
 #include "net_packet.h"
 #include "net_query.h"
 #include "net_server.h"
 #include "net_sdl.h"
+#include "net_stats.h"
 #include "net_structrw.h"
 
 // How often to refresh our registration with the master server.
@@ -45,6 +47,12 @@
 // How often to re-resolve the address of the master server?
 #define MASTER_RESOLVE_PERIOD 8 * 60 * 60 /* 8 hours */
 
+// Longest time NET_SV_Timeout will ever ask to wait for, in ms.
+#define MAX_TIMEOUT 1000
+
+// How often to write out client statistics, with -netstats.
+#define STATS_PERIOD 10 /* seconds */
+
 typedef enum
 {
     // waiting for the game to be "launched" (key player to press the start
@@ -67,6 +75,10 @@ typedef struct
     boolean active;
     int player_number;
     net_addr_t *addr;
+
+    // Index of the session this client is in.
+
+    int session;
     net_connection_t connection;
     int last_send_time;
     char *name;
@@ -120,6 +132,10 @@ typedef struct
 
     int player_class;
 
+    // Network statistics (-netstats)
+
+    net_clientstats_t stats;
+
 } net_client_t;
 
 // structure used for the recv window
@@ -143,14 +159,61 @@ typedef struct
     net_ticdiff_t diff;
 } net_client_recv_t;
 
-static net_server_state_t server_state;
+// A session is one game, with its own set of clients.  A dedicated
+// server can host several sessions at once (-sessions), all on the
+// same socket; packets are routed to a session by their address.
+
+typedef struct
+{
+    net_server_state_t state;
+    net_client_t clients[MAXNETNODES];
+    net_client_t *players[NET_MAXPLAYERS];
+    unsigned int gamemode;
+    unsigned int gamemission;
+    net_gamesettings_t settings;
+
+    // receive window
+
+    unsigned int recvwindow_start;
+    net_client_recv_t recvwindow[BACKUPTICS][NET_MAXPLAYERS];
+
+    // Summary of the receive window for each player, so that it only
+    // has to be searched when something is due: the number of tics
+    // received, and when the earliest outstanding resend request
+    // times out (0 for none; may be early, but never late).
+
+    int recvcount[NET_MAXPLAYERS];
+    unsigned int resend_due[NET_MAXPLAYERS];
+
+    // Demo of the game being recorded (-recordgames)
+
+    net_demo_t *demo;
+
+    // When NET_SV_Run next needs to run this session, and its index
+    // in wake_heap, or -1 if it has no clients and nothing to do.
+
+    unsigned int wake_time;
+    int wake_index;
+} net_session_t;
+
 static boolean server_initialized = false;
-static net_client_t clients[MAXNETNODES];
-static net_client_t *sv_players[NET_MAXPLAYERS];
 static net_context_t *server_context;
-static unsigned int sv_gamemode;
-static unsigned int sv_gamemission;
-static net_gamesettings_t sv_settings;
+
+static net_session_t *sessions;
+static int num_sessions;
+
+// Sessions with clients, in a binary min-heap ordered by wake_time,
+// so that only the sessions that have something to do are looked at.
+// run_list holds the sessions that NET_SV_Run is running.
+
+static net_session_t **wake_heap;
+static int wake_heap_len;
+static net_session_t **run_list;
+
+// The session currently being worked on; everything below operates
+// on this one.
+
+static net_session_t *sv;
 
 // For registration with master server:
 
@@ -158,12 +221,131 @@ static net_addr_t *master_server = NULL;
 static unsigned int master_refresh_time;
 static unsigned int master_resolve_time;
 
-// receive window
+// Last time client statistics were written out.
+
+static unsigned int stats_time;
 
-static unsigned int recvwindow_start;
-static net_client_recv_t recvwindow[BACKUPTICS][NET_MAXPLAYERS];
+#define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(sv->recvwindow_start, (b))
 
-#define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
+// Set when a session could not do everything it had to do in one
+// go (it only generates one tic per client per run), so that it
+// needs to be run again immediately.
+
+static boolean run_again;
+
+static boolean WakesBefore(net_session_t *a, net_session_t *b)
+{
+    return (int) (a->wake_time - b->wake_time) < 0;
+}
+
+static void WakeHeapSet(int index, net_session_t *session)
+{
+    wake_heap[index] = session;
+    session->wake_index = index;
+}
+
+static void WakeHeapUp(int index)
+{
+    net_session_t *session;
+    int parent;
+
+    session = wake_heap[index];
+
+    while (index > 0)
+    {
+        parent = (index - 1) / 2;
+
+        if (!WakesBefore(session, wake_heap[parent]))
+        {
+            break;
+        }
+
+        WakeHeapSet(index, wake_heap[parent]);
+        index = parent;
+    }
+
+    WakeHeapSet(index, session);
+}
+
+static void WakeHeapDown(int index)
+{
+    net_session_t *session;
+    int child;
+
+    session = wake_heap[index];
+
+    for (;;)
+    {
+        child = index * 2 + 1;
+
+        if (child >= wake_heap_len)
+        {
+            break;
+        }
+
+        if (child + 1 < wake_heap_len
+         && WakesBefore(wake_heap[child + 1], wake_heap[child]))
+        {
+            ++child;
+        }
+
+        if (!WakesBefore(wake_heap[child], session))
+        {
+            break;
+        }
+
+        WakeHeapSet(index, wake_heap[child]);
+        index = child;
+    }
+
+    WakeHeapSet(index, session);
+}
+
+// Arrange for a session to be run at the given time.
+
+static void NET_SV_ScheduleSession(net_session_t *session, unsigned int when)
+{
+    session->wake_time = when;
+
+    if (session->wake_index < 0)
+    {
+        ++wake_heap_len;
+        WakeHeapSet(wake_heap_len - 1, session);
+    }
+
+    WakeHeapUp(session->wake_index);
+    WakeHeapDown(session->wake_index);
+}
+
+static void NET_SV_UnscheduleSession(net_session_t *session)
+{
+    int index;
+
+    index = session->wake_index;
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    session->wake_index = -1;
+    --wake_heap_len;
+
+    if (index < wake_heap_len)
+    {
+        WakeHeapSet(index, wake_heap[wake_heap_len]);
+        WakeHeapUp(index);
+        WakeHeapDown(wake_heap[index]->wake_index);
+    }
+}
+
+// Run a session on the next call to NET_SV_Run, after something has
+// happened to it.
+
+static void NET_SV_WakeSession(net_session_t *session)
+{
+    NET_SV_ScheduleSession(session, I_GetTimeMS());
+}
 
 static void NET_SV_DisconnectClient(net_client_t *client)
 {
@@ -216,9 +398,9 @@ static void NET_SV_BroadcastMessage(const char *s, ...)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            NET_SV_SendConsoleMessage(&clients[i], "%s", buf);
+            NET_SV_SendConsoleMessage(&sv->clients[i], "%s", buf);
         }
     }
 
@@ -237,24 +419,24 @@ static void NET_SV_AssignPlayers(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            if (!clients[i].drone)
+            if (!sv->clients[i].drone)
             {
-                sv_players[pl] = &clients[i];
-                sv_players[pl]->player_number = pl;
+                sv->players[pl] = &sv->clients[i];
+                sv->players[pl]->player_number = pl;
                 ++pl;
             }
             else
             {
-                clients[i].player_number = -1;
+                sv->clients[i].player_number = -1;
             }
         }
     }
 
     for (; pl<NET_MAXPLAYERS; ++pl)
     {
-        sv_players[pl] = NULL;
+        sv->players[pl] = NULL;
     }
 }
 
@@ -269,7 +451,7 @@ static int NET_SV_NumPlayers(void)
 
     for (i=0; i<NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
+        if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
         {
             result += 1;
         }
@@ -287,8 +469,8 @@ static int NET_SV_NumReadyPlayers(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i])
-         && !clients[i].drone && clients[i].ready)
+        if (ClientConnected(&sv->clients[i])
+         && !sv->clients[i].drone && sv->clients[i].ready)
         {
             ++result;
         }
@@ -305,9 +487,9 @@ static int NET_SV_MaxPlayers(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            return clients[i].max_players;
+            return sv->clients[i].max_players;
         }
     }
 
@@ -325,7 +507,7 @@ static int NET_SV_NumDrones(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && clients[i].drone)
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].drone)
         {
             result += 1;
         }
@@ -345,7 +527,7 @@ static int NET_SV_NumClients(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
             ++count;
         }
@@ -369,14 +551,14 @@ static net_client_t *NET_SV_Controller(void)
     {
         // Can't be controller?
 
-        if (!ClientConnected(&clients[i]) || clients[i].drone)
+        if (!ClientConnected(&sv->clients[i]) || sv->clients[i].drone)
         {
             continue;
         }
 
-        if (best == NULL || clients[i].connect_time < best->connect_time)
+        if (best == NULL || sv->clients[i].connect_time < best->connect_time)
         {
-            best = &clients[i];
+            best = &sv->clients[i];
         }
     }
 
@@ -421,10 +603,10 @@ static void NET_SV_SendWaitingData(net_client_t *client)
     for (i = 0; i < wait_data.num_players; ++i)
     {
         M_StringCopy(wait_data.player_names[i],
-                     sv_players[i]->name,
+                     sv->players[i]->name,
                      MAXPLAYERNAME);
         M_StringCopy(wait_data.player_addrs[i],
-                     NET_AddrToString(sv_players[i]->addr),
+                     NET_AddrToString(sv->players[i]->addr),
                      MAXPLAYERNAME);
     }
 
@@ -450,11 +632,11 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 
     for (i=0; i<MAXNETNODES; ++i) 
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            if (clients[i].acknowledged < lowtic)
+            if (sv->clients[i].acknowledged < lowtic)
             {
-                lowtic = clients[i].acknowledged;
+                lowtic = sv->clients[i].acknowledged;
             }
         }
     }
@@ -463,6 +645,32 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 }
 
 
+// Record the first tic in the recv window to the demo of the game.
+
+static void NET_SV_RecordTic(void)
+{
+    net_full_ticcmd_t cmd;
+    int i;
+
+    cmd.seq = sv->recvwindow_start;
+    cmd.latency = 0;
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        cmd.playeringame[i] = sv->players[i] != NULL
+                           && sv->recvwindow[0][i].active;
+        cmd.cmds[i] = sv->recvwindow[0][i].diff;
+    }
+
+    if (!NET_Demo_WriteTic(sv->demo, &cmd))
+    {
+        // A player has left the game.
+
+        NET_Demo_End(sv->demo);
+        sv->demo = NULL;
+    }
+}
+
 // Possibly advance the recv window if all connected clients have
 // used the data in the window
 
@@ -480,7 +688,7 @@ static void NET_SV_AdvanceWindow(void)
 
     // Advance the recv window until it catches up with lowtic
 
-    while (recvwindow_start < lowtic)
+    while (sv->recvwindow_start < lowtic)
     {
         boolean should_advance;
 
@@ -491,12 +699,12 @@ static void NET_SV_AdvanceWindow(void)
 
         for (i=0; i<NET_MAXPLAYERS; ++i)
         {
-            if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+            if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
             {
                 continue;
             }
 
-            if (!recvwindow[0][i].active)
+            if (!sv->recvwindow[0][i].active)
             {
                 should_advance = false;
                 break;
@@ -512,33 +720,112 @@ static void NET_SV_AdvanceWindow(void)
             break;
         }
         
+        if (sv->demo != NULL)
+        {
+            NET_SV_RecordTic();
+        }
+
+        for (i=0; i<NET_MAXPLAYERS; ++i)
+        {
+            if (sv->recvwindow[0][i].active)
+            {
+                --sv->recvcount[i];
+            }
+        }
+
         // Advance the window
 
-        memmove(recvwindow, recvwindow + 1,
-                sizeof(*recvwindow) * (BACKUPTICS - 1));
-        memset(&recvwindow[BACKUPTICS-1], 0, sizeof(*recvwindow));
-        ++recvwindow_start;
-        NET_Log("server: advanced receive window to %d", recvwindow_start);
+        memmove(sv->recvwindow, sv->recvwindow + 1,
+                sizeof(*sv->recvwindow) * (BACKUPTICS - 1));
+        memset(&sv->recvwindow[BACKUPTICS-1], 0, sizeof(*sv->recvwindow));
+        ++sv->recvwindow_start;
+        NET_Log("server: advanced receive window to %d", sv->recvwindow_start);
     }
 }
 
-// Given an address, find the corresponding client
+// Given an address, find the corresponding client, and make its
+// session the current one.
 
 static net_client_t *NET_SV_FindClient(net_addr_t *addr)
 {
+    net_client_t *client;
+
+    if (addr == NULL)
+    {
+        return NULL;
+    }
+
+    client = addr->server_client;
+
+    if (client == NULL || !client->active)
+    {
+        return NULL;
+    }
+
+    sv = &sessions[client->session];
+
+    return client;
+}
+
+// Choose the session that a new client joins, and make it the current
+// one: a game that is still waiting to be launched and has room for
+// the client, or failing that an empty session.  If there is neither,
+// the first session is chosen, which will then reject the client.
+// data is NULL for a query.
+
+static void NET_SV_ChooseSession(net_connect_data_t *data)
+{
+    net_session_t *empty;
     int i;
 
-    for (i=0; i<MAXNETNODES; ++i) 
+    empty = NULL;
+
+    for (i=0; i<num_sessions; ++i)
     {
-        if (clients[i].active && clients[i].addr == addr)
+        sv = &sessions[i];
+
+        if (sv->state != SERVER_WAITING_LAUNCH)
         {
-            // found the client
+            continue;
+        }
 
-            return &clients[i];
+        if (NET_SV_NumClients() == 0)
+        {
+            if (empty == NULL)
+            {
+                empty = sv;
+            }
+
+            continue;
+        }
+
+        NET_SV_AssignPlayers();
+
+        if (NET_SV_NumPlayers() == 0
+         || NET_SV_NumClients() >= MAXNETNODES)
+        {
+            continue;
         }
+
+        if (data != NULL
+         && (data->gamemode != sv->gamemode
+          || data->gamemission != sv->gamemission
+          || (!data->drone && NET_SV_NumPlayers() >= NET_SV_MaxPlayers())))
+        {
+            continue;
+        }
+
+        return;
     }
 
-    return NULL;
+    if (empty != NULL)
+    {
+        sv = empty;
+    }
+    else
+    {
+        sv = &sessions[0];
+    }
 }
 
 // send a rejection packet to a client
@@ -563,6 +850,8 @@ static void NET_SV_InitNewClient(net_client_t *client, net_addr_t *addr,
     client->connect_time = I_GetTimeMS();
     NET_Conn_InitServer(&client->connection, addr, protocol);
     client->addr = addr;
+    client->session = sv - sessions;
+    addr->server_client = client;
     NET_ReferenceAddress(addr);
     client->last_send_time = -1;
 
@@ -577,7 +866,12 @@ static void NET_SV_InitNewClient(net_client_t *client, net_addr_t *addr,
 
     memset(client->sendqueue, 0xff, sizeof(client->sendqueue));
 
-    NET_Log("server: initialized new client from %s", NET_AddrToString(addr));
+    NET_Stats_Init(&client->stats);
+
+    NET_Log("server: initialized new client from %s in session %d",
+            NET_AddrToString(addr), (int) (sv - sessions));
+
+    NET_SV_WakeSession(sv);
 }
 
 // parse a SYN from a client(initiating a connection)
@@ -674,11 +968,27 @@ static void NET_SV_ParseSYN(net_packet_t *packet, net_client_t *client,
 
     // At this point we have received a valid SYN.
 
+    if (client == NULL)
+    {
+        NET_SV_ChooseSession(&data);
+    }
+    else if (client->active
+          && client->connection.state != NET_CONN_STATE_DISCONNECTED)
+    {
+        // Client already connected: our reply must have been lost, but
+        // it is a reliable packet and will be resent.  This has to be
+        // checked first, as the game may have filled up or been
+        // launched since.
+
+        NET_Log("server: client is already initialized (duplicate SYN?)");
+        return;
+    }
+
     // Not accepting new connections?
-    if (server_state != SERVER_WAITING_LAUNCH)
+    if (sv->state != SERVER_WAITING_LAUNCH)
     {
         NET_Log("server: error: not in waiting launch state, server_state=%d",
-                server_state);
+                sv->state);
         NET_SV_SendReject(addr,
                           "Server is not currently accepting connections");
         return;
@@ -704,23 +1014,23 @@ static void NET_SV_ParseSYN(net_packet_t *packet, net_client_t *client,
     // Adopt the game mode and mission of the first connecting client:
     if (num_players == 0 && !data.drone)
     {
-        sv_gamemode = data.gamemode;
-        sv_gamemission = data.gamemission;
+        sv->gamemode = data.gamemode;
+        sv->gamemission = data.gamemission;
         NET_Log("server: new game, mode=%d, mission=%d",
-                sv_gamemode, sv_gamemission);
+                sv->gamemode, sv->gamemission);
     }
 
     // Check the connecting client is playing the same game as all
     // the other clients
-    if (data.gamemode != sv_gamemode || data.gamemission != sv_gamemission)
+    if (data.gamemode != sv->gamemode || data.gamemission != sv->gamemission)
     {
         char msg[128];
         NET_Log("server: wrong mode/mission, %d != %d || %d != %d",
-                data.gamemode, sv_gamemode, data.gamemission, sv_gamemission);
+                data.gamemode, sv->gamemode, data.gamemission, sv->gamemission);
         M_snprintf(msg, sizeof(msg),
                    "Game mismatch: server is %s (%s), client is %s (%s)",
-                   D_GameMissionString(sv_gamemission),
-                   D_GameModeString(sv_gamemode),
+                   D_GameMissionString(sv->gamemission),
+                   D_GameModeString(sv->gamemode),
                    D_GameMissionString(data.gamemission),
                    D_GameModeString(data.gamemode));
 
@@ -735,9 +1045,9 @@ static void NET_SV_ParseSYN(net_packet_t *packet, net_client_t *client,
 
         for (i=0; i<MAXNETNODES; ++i)
         {
-            if (!clients[i].active)
+            if (!sv->clients[i].active)
             {
-                client = &clients[i];
+                client = &sv->clients[i];
                 break;
             }
         }
@@ -758,13 +1068,6 @@ static void NET_SV_ParseSYN(net_packet_t *packet, net_client_t *client,
         }
     }
 
-    // Client already connected?
-    if (client->active)
-    {
-        NET_Log("server: client is already initialized (duplicate SYN?)");
-        return;
-    }
-
     // Activate, initialize connection
     NET_SV_InitNewClient(client, addr, protocol);
 
@@ -807,10 +1110,10 @@ static void NET_SV_ParseLaunch(net_packet_t *packet, net_client_t *client)
 
     // Can only launch when we are in the waiting state.
 
-    if (server_state != SERVER_WAITING_LAUNCH)
+    if (sv->state != SERVER_WAITING_LAUNCH)
     {
         NET_Log("server: error: not in waiting launch state, state=%d",
-                server_state);
+                sv->state);
         return;
     }
 
@@ -821,17 +1124,17 @@ static void NET_SV_ParseLaunch(net_packet_t *packet, net_client_t *client)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (!ClientConnected(&clients[i]))
+        if (!ClientConnected(&sv->clients[i]))
             continue;
 
-        launchpacket = NET_Conn_NewReliable(&clients[i].connection,
+        launchpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
                                             NET_PACKET_TYPE_LAUNCH);
         NET_WriteInt8(launchpacket, num_players);
     }
 
     // Now in launch state.
 
-    server_state = SERVER_WAITING_START;
+    sv->state = SERVER_WAITING_START;
 }
 
 // Transition to the in-game state and send all players the start game
@@ -850,29 +1153,29 @@ static void StartGame(void)
 
     // Check if anyone is recording a demo and set lowres_turn if so.
 
-    sv_settings.lowres_turn = false;
+    sv->settings.lowres_turn = false;
 
     for (i = 0; i < NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL && sv_players[i]->recording_lowres)
+        if (sv->players[i] != NULL && sv->players[i]->recording_lowres)
         {
-            sv_settings.lowres_turn = true;
+            sv->settings.lowres_turn = true;
         }
     }
 
-    sv_settings.num_players = NET_SV_NumPlayers();
+    sv->settings.num_players = NET_SV_NumPlayers();
 
     // Copy player classes:
 
     for (i = 0; i < NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL)
+        if (sv->players[i] != NULL)
         {
-            sv_settings.player_classes[i] = sv_players[i]->player_class;
+            sv->settings.player_classes[i] = sv->players[i]->player_class;
         }
         else
         {
-            sv_settings.player_classes[i] = 0;
+            sv->settings.player_classes[i] = 0;
         }
     }
 
@@ -882,25 +1185,40 @@ static void StartGame(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (!ClientConnected(&clients[i]))
+        if (!ClientConnected(&sv->clients[i]))
             continue;
 
-        clients[i].last_gamedata_time = nowtime;
+        sv->clients[i].last_gamedata_time = nowtime;
 
-        startpacket = NET_Conn_NewReliable(&clients[i].connection,
+        startpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
                                            NET_PACKET_TYPE_GAMESTART);
 
-        sv_settings.consoleplayer = clients[i].player_number;
+        sv->settings.consoleplayer = sv->clients[i].player_number;
 
-        NET_WriteSettings(startpacket, &sv_settings);
+        NET_WriteSettings(startpacket, &sv->settings);
     }
 
     // Change server state
     NET_Log("server: beginning game state");
-    server_state = SERVER_IN_GAME;
+    sv->state = SERVER_IN_GAME;
 
-    memset(recvwindow, 0, sizeof(recvwindow));
-    recvwindow_start = 0;
+    memset(sv->recvwindow, 0, sizeof(sv->recvwindow));
+    memset(sv->recvcount, 0, sizeof(sv->recvcount));
+    memset(sv->resend_due, 0, sizeof(sv->resend_due));
+    sv->recvwindow_start = 0;
+
+    if (NET_Demo_Enabled())
+    {
+        boolean playeringame[NET_MAXPLAYERS];
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            playeringame[i] = sv->players[i] != NULL;
+        }
+
+        sv->demo = NET_Demo_Start(&sv->settings, sv->gamemission,
+                                  playeringame);
+    }
 }
 
 // Returns true when all nodes have indicated readiness to start the game.
@@ -911,7 +1229,7 @@ static boolean AllNodesReady(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && !clients[i].ready)
+        if (ClientConnected(&sv->clients[i]) && !sv->clients[i].ready)
         {
             return false;
         }
@@ -943,9 +1261,9 @@ static void SendAllWaitingData(void)
 
     for (i = 0; i < MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && clients[i].ready)
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].ready)
         {
-            NET_SV_SendWaitingData(&clients[i]);
+            NET_SV_SendWaitingData(&sv->clients[i]);
         }
     }
 }
@@ -960,10 +1278,10 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
     // Can only start a game if we are in the waiting start state.
 
-    if (server_state != SERVER_WAITING_START)
+    if (sv->state != SERVER_WAITING_START)
     {
         NET_Log("server: error: not in waiting start state, server_state=%d",
-                server_state);
+                sv->state);
         return;
     }
 
@@ -978,13 +1296,13 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
         // Check the game settings are valid
 
-        if (!NET_ValidGameSettings(sv_gamemode, sv_gamemission, &settings))
+        if (!NET_ValidGameSettings(sv->gamemode, sv->gamemission, &settings))
         {
             NET_Log("server: error: invalid game settings");
             return;
         }
 
-        sv_settings = settings;
+        sv->settings = settings;
     }
 
     client->ready = true;
@@ -998,6 +1316,18 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
     SendAllWaitingData();
 }
 
+// Note that a resend request to the given player times out at the
+// given time.
+
+static void NET_SV_ResendDue(int player, unsigned int when)
+{
+    if (sv->resend_due[player] == 0
+     || (int) (when - sv->resend_due[player]) < 0)
+    {
+        sv->resend_due[player] = when;
+    }
+}
+
 // Send a resend request to a client
 
 static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
@@ -1020,13 +1350,15 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
     NET_Conn_SendPacket(&client->connection, packet);
     NET_FreePacket(packet);
 
+    client->stats.tics_requested += end - start + 1;
+
     // Store the time we send the resend request
 
     nowtime = I_GetTimeMS();
 
     for (i=start; i<=end; ++i)
     {
-        index = i - recvwindow_start;
+        index = i - sv->recvwindow_start;
 
         if (index >= BACKUPTICS)
         {
@@ -1035,10 +1367,12 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
             continue;
         }
         
-        recvobj = &recvwindow[index][client->player_number];
+        recvobj = &sv->recvwindow[index][client->player_number];
 
         recvobj->resend_time = nowtime;
     }
+
+    NET_SV_ResendDue(client->player_number, nowtime + 300);
 }
 
 // Check for expired resend requests
@@ -1053,6 +1387,19 @@ static void NET_SV_CheckResends(net_client_t *client)
     nowtime = I_GetTimeMS();
 
     player = client->player_number;
+
+    // Nothing to do until the earliest resend request times out.
+
+    if (sv->resend_due[player] == 0
+     || (int) (nowtime - sv->resend_due[player]) <= 0)
+    {
+        return;
+    }
+
+    // Work out the next time from scratch.  Requests sent below add
+    // themselves.
+
+    sv->resend_due[player] = 0;
     resend_start = -1;
     resend_end = -1;
 
@@ -1061,7 +1408,7 @@ static void NET_SV_CheckResends(net_client_t *client)
         net_client_recv_t *recvobj;
         boolean need_resend;
 
-        recvobj = &recvwindow[i][player];
+        recvobj = &sv->recvwindow[i][player];
 
         // if need_resend is true, this tic needs another retransmit
         // request (300ms timeout)
@@ -1070,6 +1417,11 @@ static void NET_SV_CheckResends(net_client_t *client)
                    && recvobj->resend_time != 0
                    && nowtime > recvobj->resend_time + 300;
 
+        if (!recvobj->active && recvobj->resend_time != 0 && !need_resend)
+        {
+            NET_SV_ResendDue(player, recvobj->resend_time + 300);
+        }
+
         if (need_resend)
         {
             // Start a new run of resend tics?
@@ -1084,12 +1436,12 @@ static void NET_SV_CheckResends(net_client_t *client)
             // End of a run of resend tics
             NET_Log("server: resend request to %s timed out for %d-%d (%d)",
                     NET_AddrToString(client->addr),
-                    recvwindow_start + resend_start,
-                    recvwindow_start + resend_end,
-                    &recvwindow[resend_start][player].resend_time);
+                    sv->recvwindow_start + resend_start,
+                    sv->recvwindow_start + resend_end,
+                    &sv->recvwindow[resend_start][player].resend_time);
             NET_SV_SendResendRequest(client, 
-                                     recvwindow_start + resend_start,
-                                     recvwindow_start + resend_end);
+                                     sv->recvwindow_start + resend_start,
+                                     sv->recvwindow_start + resend_end);
 
             resend_start = -1;
         }
@@ -1099,12 +1451,12 @@ static void NET_SV_CheckResends(net_client_t *client)
     {
         NET_Log("server: resend request to %s timed out for %d-%d (%d)",
                 NET_AddrToString(client->addr),
-                recvwindow_start + resend_start,
-                recvwindow_start + resend_end,
-                &recvwindow[resend_start][player].resend_time);
+                sv->recvwindow_start + resend_start,
+                sv->recvwindow_start + resend_end,
+                &sv->recvwindow[resend_start][player].resend_time);
         NET_SV_SendResendRequest(client,
-                                 recvwindow_start + resend_start,
-                                 recvwindow_start + resend_end);
+                                 sv->recvwindow_start + resend_start,
+                                 sv->recvwindow_start + resend_end);
     }
 }
 
@@ -1122,10 +1474,10 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     int resend_start, resend_end;
     int index;
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         NET_Log("server: error: not in game state: server_state=%d",
-                server_state);
+                sv->state);
         return;
     }
 
@@ -1165,12 +1517,12 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
         signed int latency;
 
         if (!NET_ReadSInt16(packet, &latency)
-         || !NET_ReadTiccmdDiff(packet, &diff, sv_settings.lowres_turn))
+         || !NET_ReadTiccmdDiff(packet, &diff, sv->settings.lowres_turn))
         {
             return;
         }
 
-        index = seq + i - recvwindow_start;
+        index = seq + i - sv->recvwindow_start;
 
         if (index < 0 || index >= BACKUPTICS)
         {
@@ -1179,7 +1531,14 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
             continue;
         }
 
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
+
+        if (!recvobj->active)
+        {
+            ++client->stats.tics_recv;
+            ++sv->recvcount[player];
+        }
+
         recvobj->active = true;
         recvobj->diff = diff;
         recvobj->latency = latency;
@@ -1194,6 +1553,11 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     {
         NET_Log("server: acknowledged up to %d", ackseq);
         client->acknowledged = ackseq;
+
+        if (ackseq <= client->sendseq)
+        {
+            NET_Stats_Acknowledged(&client->stats, ackseq, I_GetTimeMS());
+        }
     }
 
     // Has this been received out of sequence, ie. have we not received
@@ -1202,7 +1566,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 
     //printf("SV: %p: %i\n", client, seq);
 
-    resend_end = seq - recvwindow_start;
+    resend_end = seq - sv->recvwindow_start;
 
     if (resend_end <= 0)
         return;
@@ -1215,7 +1579,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     
     while (index >= 0)
     {
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
 
         if (recvobj->active)
         {
@@ -1239,11 +1603,11 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     if (resend_start < resend_end)
     {
         NET_Log("server: request resend for %d-%d before %d",
-                recvwindow_start + resend_start,
-                recvwindow_start + resend_end - 1, seq);
+                sv->recvwindow_start + resend_start,
+                sv->recvwindow_start + resend_end - 1, seq);
         NET_SV_SendResendRequest(client, 
-                                 recvwindow_start + resend_start, 
-                                 recvwindow_start + resend_end - 1);
+                                 sv->recvwindow_start + resend_start, 
+                                 sv->recvwindow_start + resend_end - 1);
     }
 }
 
@@ -1253,10 +1617,10 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 
     NET_Log("server: processing game data ack packet");
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         NET_Log("server: error: not in game state, server_state=%d",
-                server_state);
+                sv->state);
         return;
     }
 
@@ -1278,6 +1642,11 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
     {
         NET_Log("server: acknowledged up to %d", ackseq);
         client->acknowledged = ackseq;
+
+        if (ackseq <= client->sendseq)
+        {
+            NET_Stats_Acknowledged(&client->stats, ackseq, I_GetTimeMS());
+        }
     }
 }
 
@@ -1285,6 +1654,7 @@ static void NET_SV_SendTics(net_client_t *client,
                             unsigned int start, unsigned int end)
 {
     net_packet_t *packet;
+    net_ticstream_t stream;
     unsigned int i;
 
     packet = NET_NewPacket(500);
@@ -1298,6 +1668,9 @@ static void NET_SV_SendTics(net_client_t *client,
 
     // Write the tics
 
+    NET_TicStream_Init(&stream, packet, client->connection.protocol,
+                       sv->settings.lowres_turn);
+
     for (i=start; i<=end; ++i)
     {
         net_full_ticcmd_t *cmd;
@@ -1311,8 +1684,10 @@ static void NET_SV_SendTics(net_client_t *client,
 
         // Add command
        
-        NET_WriteFullTiccmd(packet, cmd, sv_settings.lowres_turn);
+        NET_TicStream_WriteTic(&stream, cmd);
     }
+
+    NET_TicStream_Finish(&stream);
     
     // Send packet
 
@@ -1367,6 +1742,7 @@ static void NET_SV_ParseResendRequest(net_packet_t *packet, net_client_t *client
     // Resend those tics
     NET_Log("server: resending tics %d-%d", start, last);
     NET_SV_SendTics(client, start, last);
+    client->stats.tics_resent += num_tics;
 }
 
 // Send a response back to the client
@@ -1383,7 +1759,7 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
 
     // Server state
 
-    querydata.server_state = server_state;
+    querydata.server_state = sv->state;
 
     // Number of players/maximum players
 
@@ -1392,8 +1768,8 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
 
     // Game mode/mission
 
-    querydata.gamemode = sv_gamemode;
-    querydata.gamemission = sv_gamemission;
+    querydata.gamemode = sv->gamemode;
+    querydata.gamemission = sv->gamemission;
 
     //!
     // @category net
@@ -1515,6 +1891,11 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
     }
     else if (packet_type == NET_PACKET_TYPE_QUERY)
     {
+        if (client == NULL)
+        {
+            NET_SV_ChooseSession(NULL);
+        }
+
         NET_SV_SendQueryResponse(addr);
     }
     else if (client == NULL)
@@ -1552,9 +1933,56 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
                 break;
         }
     }
+
+    // The packet may have given the client's session something to do.
+
+    if (client != NULL)
+    {
+        NET_SV_WakeSession(sv);
+    }
 }
 
 
+// Record stalls in the clients' stats.  When clients are held up by
+// NET_SV_PumpSendQueue, the stall is charged to the client(s) that
+// have acknowledged the least, rather than to everyone waiting on them.
+
+static void NET_SV_UpdateStalls(void)
+{
+    net_client_t *client;
+    unsigned int lowtic;
+    unsigned int nowtime;
+    boolean stalled;
+    int i;
+
+    lowtic = NET_SV_LatestAcknowledged();
+    nowtime = I_GetTimeMS();
+    stalled = false;
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        client = &sv->clients[i];
+
+        if (ClientConnected(client) && client->sendseq - lowtic > 40)
+        {
+            stalled = true;
+            break;
+        }
+    }
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        client = &sv->clients[i];
+
+        if (ClientConnected(client))
+        {
+            NET_Stats_Stalled(&client->stats,
+                              stalled && client->acknowledged == lowtic,
+                              nowtime);
+        }
+    }
+}
+
 static void NET_SV_PumpSendQueue(net_client_t *client)
 {
     net_full_ticcmd_t cmd;
@@ -1570,10 +1998,10 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     {
         return;
     }
-    
+
     // Work out the index into the receive window
    
-    recv_index = client->sendseq - recvwindow_start;
+    recv_index = client->sendseq - sv->recvwindow_start;
 
     if (recv_index < 0 || recv_index >= BACKUPTICS)
     {
@@ -1587,19 +2015,19 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     for (i=0; i<NET_MAXPLAYERS; ++i)
     {
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Client does not rely on itself for data
 
             continue;
         }
 
-        if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+        if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
         {
             continue;
         }
 
-        if (!recvwindow[recv_index][i].active)
+        if (!sv->recvwindow[recv_index][i].active)
         {
             // We do not have this player's ticcmd, so we cannot
             // generate a complete command yet.
@@ -1616,7 +2044,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     // and never stopping. Don't let the server get too far ahead
     // of the client.
 
-    if (num_players == 0 && client->sendseq > recvwindow_start + 10)
+    if (num_players == 0 && client->sendseq > sv->recvwindow_start + 10)
     {
         return;
     }
@@ -1633,7 +2061,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     {
         net_client_recv_t *recvobj;
 
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Not the player we are sending to
 
@@ -1641,7 +2069,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
             continue;
         }
         
-        if (sv_players[i] == NULL || !recvwindow[recv_index][i].active)
+        if (sv->players[i] == NULL || !sv->recvwindow[recv_index][i].active)
         {
             cmd.playeringame[i] = false;
             continue;
@@ -1649,7 +2077,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
         cmd.playeringame[i] = true;
 
-        recvobj = &recvwindow[recv_index][i];
+        recvobj = &sv->recvwindow[recv_index][i];
 
         cmd.cmds[i] = recvobj->diff;
 
@@ -1662,10 +2090,11 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     // Add into the queue
 
     client->sendqueue[client->sendseq % BACKUPTICS] = cmd;
+    NET_Stats_TicSent(&client->stats, client->sendseq, I_GetTimeMS());
 
     // Transmit the new tic to the client
 
-    starttic = client->sendseq - sv_settings.extratics;
+    starttic = client->sendseq - sv->settings.extratics;
     endtic = client->sendseq;
 
     if (starttic < 0)
@@ -1676,6 +2105,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     NET_SV_SendTics(client, starttic, endtic);
 
     ++client->sendseq;
+    run_again = true;
 }
 
 // Prevent against deadlock: resend requests are usually only
@@ -1712,18 +2142,19 @@ void NET_SV_CheckDeadlock(net_client_t *client)
 
         for (i=0; i<BACKUPTICS; ++i)
         {
-            if (!recvwindow[i][client->player_number].active)
+            if (!sv->recvwindow[i][client->player_number].active)
             {
                 NET_Log("server: deadlock: sending resend request for %d-%d",
-                        recvwindow_start + i, recvwindow_start + i + 5);
+                        sv->recvwindow_start + i, sv->recvwindow_start + i + 5);
 
                 // Found a tic we haven't received.  Send a resend request.
 
                 NET_SV_SendResendRequest(client,
-                                         recvwindow_start + i,
-                                         recvwindow_start + i + 5);
+                                         sv->recvwindow_start + i,
+                                         sv->recvwindow_start + i + 5);
 
                 client->last_gamedata_time = nowtime;
+                ++client->stats.deadlocks;
                 break;
             }
         }
@@ -1749,14 +2180,20 @@ static void NET_SV_GameEnded(void)
 {
     int i;
 
-    server_state = SERVER_WAITING_LAUNCH;
-    sv_gamemode = indetermined;
+    sv->state = SERVER_WAITING_LAUNCH;
+    sv->gamemode = indetermined;
+
+    if (sv->demo != NULL)
+    {
+        NET_Demo_End(sv->demo);
+        sv->demo = NULL;
+    }
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        if (sv->clients[i].active)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            NET_SV_DisconnectClient(&sv->clients[i]);
         }
     }
 }
@@ -1787,7 +2224,7 @@ static void NET_SV_RunClient(net_client_t *client)
         // If we were about to start a game, any player disconnecting
         // should cause an abort.
 
-        if (server_state == SERVER_WAITING_START && !client->drone)
+        if (sv->state == SERVER_WAITING_START && !client->drone)
         {
             NET_SV_BroadcastMessage("Game startup aborted because "
                                     "player '%s' disconnected.",
@@ -1795,7 +2232,14 @@ static void NET_SV_RunClient(net_client_t *client)
             NET_SV_GameEnded();
         }
 
+        NET_Stats_WriteRecord(&client->stats, &client->connection,
+                              "disconnect", (int) (sv - sessions),
+                              NET_AddrToString(client->addr),
+                              client->name, client->player_number);
+        NET_Stats_Flush();
+
         free(client->name);
+        client->addr->server_client = NULL;
         NET_ReleaseAddress(client->addr);
 
         // Are there any clients left connected?  If not, return the
@@ -1817,7 +2261,7 @@ static void NET_SV_RunClient(net_client_t *client)
         return;
     }
 
-    if (server_state == SERVER_WAITING_LAUNCH)
+    if (sv->state == SERVER_WAITING_LAUNCH)
     {
         // Waiting for the game to start
 
@@ -1831,7 +2275,7 @@ static void NET_SV_RunClient(net_client_t *client)
         }
     }
 
-    if (server_state == SERVER_IN_GAME)
+    if (sv->state == SERVER_IN_GAME)
     {
         NET_SV_PumpSendQueue(client);
         NET_SV_CheckDeadlock(client);
@@ -1850,24 +2294,90 @@ void NET_SV_AddModule(net_module_t *module)
 
 void NET_SV_Init(void)
 {
+    NET_SV_InitSessions(1);
+}
+
+// Initialize server to host up to the given number of games at once
+
+void NET_SV_InitSessions(int max_sessions)
+{
+    int s;
     int i;
+    int p;
 
     // initialize send/receive context
 
     server_context = NET_NewContext();
 
-    // no clients yet
-   
-    for (i=0; i<MAXNETNODES; ++i) 
+    // Sessions are allocated outside the zone, as with many of them
+    // they can be larger than the whole zone.
+
+    num_sessions = max_sessions;
+    sessions = calloc(num_sessions, sizeof(net_session_t));
+    wake_heap = calloc(num_sessions, sizeof(net_session_t *));
+    run_list = calloc(num_sessions, sizeof(net_session_t *));
+    wake_heap_len = 0;
+
+    if (sessions == NULL || wake_heap == NULL || run_list == NULL)
     {
-        clients[i].active = false;
+        I_Error("NET_SV_InitSessions: Unable to allocate %i sessions",
+                num_sessions);
     }
 
-    NET_SV_AssignPlayers();
+    for (s=0; s<num_sessions; ++s)
+    {
+        sv = &sessions[s];
+
+        // no clients yet
+
+        for (i=0; i<MAXNETNODES; ++i)
+        {
+            sv->clients[i].active = false;
+        }
+
+        NET_SV_AssignPlayers();
 
-    server_state = SERVER_WAITING_LAUNCH;
-    sv_gamemode = indetermined;
+        sv->state = SERVER_WAITING_LAUNCH;
+        sv->gamemode = indetermined;
+        sv->wake_index = -1;
+    }
+
+    sv = &sessions[0];
     server_initialized = true;
+
+    //!
+    // @category net
+    // @arg <file>
+    //
+    // When running a server, append network statistics for each
+    // client to the given file every 10 seconds, and when the client
+    // disconnects: round trip times, jitter, retransmissions, traffic
+    // and so on.  Each record is a JSON object on a line of its own.
+    //
+
+    p = M_CheckParmWithArgs("-netstats", 1);
+
+    if (p > 0)
+    {
+        NET_Stats_Open(myargv[p + 1]);
+        stats_time = I_GetTimeMS();
+    }
+
+    //!
+    // @category net
+    // @arg <dir>
+    //
+    // When running a server, record every game played on it as a
+    // demo in the given directory.  Only Doom games with up to four
+    // players can be recorded; recording stops if a player leaves.
+    //
+
+    p = M_CheckParmWithArgs("-recordgames", 1);
+
+    if (p > 0)
+    {
+        NET_Demo_Init(myargv[p + 1]);
+    }
 }
 
 static void UpdateMasterServer(void)
@@ -1927,44 +2437,45 @@ void NET_SV_RegisterWithMaster(void)
     }
 }
 
-// Run server code to check for new packets/send packets as the server
-// requires
+// Write out statistics for all clients in the current session
 
-void NET_SV_Run(void)
+static void NET_SV_WriteSessionStats(void)
 {
-    net_addr_t *addr;
-    net_packet_t *packet;
+    net_client_t *client;
     int i;
 
-    if (!server_initialized)
+    for (i=0; i<MAXNETNODES; ++i)
     {
-        return;
-    }
+        client = &sv->clients[i];
 
-    while (NET_RecvPacket(server_context, &addr, &packet))
-    {
-        NET_SV_Packet(packet, addr);
-        NET_FreePacket(packet);
-        NET_ReleaseAddress(addr);
+        if (ClientConnected(client))
+        {
+            NET_Stats_WriteRecord(&client->stats, &client->connection,
+                                  "periodic", (int) (sv - sessions),
+                                  NET_AddrToString(client->addr),
+                                  client->name, client->player_number);
+        }
     }
+}
 
-    if (master_server != NULL)
-    {
-        UpdateMasterServer();
-    }
+// Run the current session
+
+static void NET_SV_RunSession(void)
+{
+    int i;
 
     // "Run" any clients that may have things to do, independent of responses
     // to received packets
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        if (sv->clients[i].active)
         {
-            NET_SV_RunClient(&clients[i]);
+            NET_SV_RunClient(&sv->clients[i]);
         }
     }
 
-    switch (server_state)
+    switch (sv->state)
     {
         case SERVER_WAITING_LAUNCH:
             break;
@@ -1974,22 +2485,206 @@ void NET_SV_Run(void)
             break;
 
         case SERVER_IN_GAME:
+            NET_SV_UpdateStalls();
             NET_SV_AdvanceWindow();
 
             for (i = 0; i < NET_MAXPLAYERS; ++i)
             {
-                if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
+                if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
                 {
-                    NET_SV_CheckResends(sv_players[i]);
+                    NET_SV_CheckResends(sv->players[i]);
                 }
             }
             break;
     }
 }
 
-void NET_SV_Shutdown(void)
+// Shorten *timeout so that it expires by the time that the current
+// session next has something to do.  Mirrors the timing checks made
+// by NET_SV_RunSession and the functions it calls.  Returns false if
+// the session has no clients, and so nothing to do until one
+// connects.
+
+static boolean NET_SV_SessionTimeout(int *timeout, unsigned int nowtime)
 {
+    net_client_t *client;
+    boolean active;
+    int player;
     int i;
+
+    active = false;
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        client = &sv->clients[i];
+
+        if (!client->active)
+        {
+            continue;
+        }
+
+        active = true;
+
+        NET_Conn_NextTimeout(&client->connection, timeout);
+
+        if (!ClientConnected(client))
+        {
+            continue;
+        }
+
+        if (sv->state == SERVER_WAITING_LAUNCH)
+        {
+            if (client->last_send_time < 0)
+            {
+                *timeout = 0;
+            }
+            else
+            {
+                NET_WakeBy(timeout, nowtime, client->last_send_time + 1001);
+            }
+        }
+
+        if (sv->state == SERVER_IN_GAME && !client->drone)
+        {
+            player = client->player_number;
+
+            // NET_SV_CheckDeadlock only does something if there is
+            // a tic still to come from this client.
+
+            if (sv->recvcount[player] < BACKUPTICS)
+            {
+                NET_WakeBy(timeout, nowtime,
+                           client->last_gamedata_time + 1001);
+            }
+
+            // NET_SV_CheckResends
+
+            if (sv->resend_due[player] != 0)
+            {
+                NET_WakeBy(timeout, nowtime, sv->resend_due[player] + 1);
+            }
+        }
+    }
+
+    return active;
+}
+
+// Run server code to check for new packets/send packets as the server
+// requires
+
+void NET_SV_Run(void)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    unsigned int nowtime;
+    int num_run;
+    int timeout;
+    int s;
+
+    if (!server_initialized)
+    {
+        return;
+    }
+
+    while (NET_RecvPacket(server_context, &addr, &packet))
+    {
+        NET_SV_Packet(packet, addr);
+        NET_FreePacket(packet);
+        NET_ReleaseAddress(addr);
+    }
+
+    if (master_server != NULL)
+    {
+        UpdateMasterServer();
+    }
+
+    // Take every session that is due off the heap before running any
+    // of them, so that each is run at most once per call.
+
+    nowtime = I_GetTimeMS();
+    num_run = 0;
+
+    while (wake_heap_len > 0 && (int) (wake_heap[0]->wake_time - nowtime) <= 0)
+    {
+        run_list[num_run] = wake_heap[0];
+        ++num_run;
+        NET_SV_UnscheduleSession(wake_heap[0]);
+    }
+
+    for (s=0; s<num_run; ++s)
+    {
+        sv = run_list[s];
+        run_again = false;
+
+        NET_SV_RunSession();
+
+        nowtime = I_GetTimeMS();
+        timeout = MAX_TIMEOUT;
+
+        if (run_again)
+        {
+            NET_SV_ScheduleSession(sv, nowtime);
+        }
+        else if (NET_SV_SessionTimeout(&timeout, nowtime))
+        {
+            NET_SV_ScheduleSession(sv, nowtime + timeout);
+        }
+    }
+
+    if (NET_Stats_Enabled()
+     && I_GetTimeMS() - stats_time > STATS_PERIOD * 1000)
+    {
+        for (s=0; s<num_sessions; ++s)
+        {
+            sv = &sessions[s];
+            NET_SV_WriteSessionStats();
+        }
+
+        NET_Stats_Flush();
+        stats_time = I_GetTimeMS();
+    }
+}
+
+// Time in ms until NET_SV_Run next needs to be called, if no packets
+// arrive in the meantime.
+
+int NET_SV_Timeout(void)
+{
+    unsigned int nowtime;
+    int timeout;
+
+    if (!server_initialized)
+    {
+        return 0;
+    }
+
+    nowtime = I_GetTimeMS();
+    timeout = MAX_TIMEOUT;
+
+    if (master_server != NULL)
+    {
+        NET_WakeBy(&timeout, nowtime,
+                   master_refresh_time + MASTER_REFRESH_PERIOD * 1000 + 1);
+        NET_WakeBy(&timeout, nowtime,
+                   master_resolve_time + MASTER_RESOLVE_PERIOD * 1000 + 1);
+    }
+
+    if (NET_Stats_Enabled())
+    {
+        NET_WakeBy(&timeout, nowtime, stats_time + STATS_PERIOD * 1000 + 1);
+    }
+
+    if (wake_heap_len > 0)
+    {
+        NET_WakeBy(&timeout, nowtime, wake_heap[0]->wake_time);
+    }
+
+    return timeout;
+}
+
+void NET_SV_Shutdown(void)
+{
+    int s, i;
     boolean running;
     int start_time;
 
@@ -2002,11 +2697,15 @@ void NET_SV_Shutdown(void)
 
     // Disconnect all clients
     
-    for (i=0; i<MAXNETNODES; ++i)
+    for (s=0; s<num_sessions; ++s)
     {
-        if (clients[i].active)
+        for (i=0; i<MAXNETNODES; ++i)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            if (sessions[s].clients[i].active)
+            {
+                NET_SV_DisconnectClient(&sessions[s].clients[i]);
+                NET_SV_WakeSession(&sessions[s]);
+            }
         }
     }
 
@@ -2021,11 +2720,14 @@ void NET_SV_Shutdown(void)
 
         running = false;
 
-        for (i=0; i<MAXNETNODES; ++i)
+        for (s=0; s<num_sessions; ++s)
         {
-            if (clients[i].active)
+            for (i=0; i<MAXNETNODES; ++i)
             {
-                running = true;
+                if (sessions[s].clients[i].active)
+                {
+                    running = true;
+                }
             }
         }
 
@@ -21,10 +21,19 @@
 
 void NET_SV_Init(void);
 
+// As NET_SV_Init, but host up to the given number of games at once
+
+void NET_SV_InitSessions(int max_sessions);
+
 // run server: check for new packets received etc.
 
 void NET_SV_Run(void);
 
+// Time in ms until NET_SV_Run next needs to be called, if no packets
+// arrive in the meantime.
+
+int NET_SV_Timeout(void);
+
 // Shut down the server
 // Blocks until all clients disconnect, or until a 5 second timeout
 
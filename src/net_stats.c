@@ -0,0 +1,230 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Per-client network statistics kept by the server, and written out
+// as one JSON record per line.
+//
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_misc.h"
+#include "net_stats.h"
+
+static FILE *stats_file = NULL;
+
+static void CloseStats(void)
+{
+    fclose(stats_file);
+    stats_file = NULL;
+}
+
+void NET_Stats_Open(const char *filename)
+{
+    stats_file = M_fopen(filename, "a");
+
+    if (stats_file == NULL)
+    {
+        I_Error("NET_Stats_Open: Unable to open %s for writing", filename);
+    }
+
+    I_AtExit(CloseStats, true);
+}
+
+boolean NET_Stats_Enabled(void)
+{
+    return stats_file != NULL;
+}
+
+void NET_Stats_Init(net_clientstats_t *stats)
+{
+    memset(stats, 0, sizeof(net_clientstats_t));
+    stats->rtt_min = UINT_MAX;
+}
+
+void NET_Stats_TicSent(net_clientstats_t *stats, unsigned int seq,
+                       unsigned int nowtime)
+{
+    stats->send_time[seq % BACKUPTICS] = nowtime;
+    ++stats->tics_sent;
+}
+
+// Called when the client acknowledges everything before ackseq.  Only
+// the newest tic acknowledged gives a round trip time; the ones before
+// it were acknowledged late, as the acknowledgement is only sent with
+// the next packet from the client.
+
+void NET_Stats_Acknowledged(net_clientstats_t *stats, unsigned int ackseq,
+                            unsigned int nowtime)
+{
+    unsigned int rtt;
+    int bucket;
+    int diff;
+
+    if (ackseq == 0)
+    {
+        return;
+    }
+
+    rtt = nowtime - stats->send_time[(ackseq - 1) % BACKUPTICS];
+
+    for (bucket = 0;
+         bucket < NET_STATS_RTT_BUCKETS - 1 && (rtt >> (bucket + 1)) != 0;
+         ++bucket);
+
+    ++stats->rtt_hist[bucket];
+
+    if (stats->rtt_count > 0)
+    {
+        diff = (int) (rtt - stats->rtt_last);
+
+        if (diff < 0)
+        {
+            diff = -diff;
+        }
+
+        stats->jitter += (diff - stats->jitter) / 16;
+    }
+
+    ++stats->rtt_count;
+    stats->rtt_total += rtt;
+    stats->rtt_last = rtt;
+
+    if (rtt < stats->rtt_min)
+    {
+        stats->rtt_min = rtt;
+    }
+
+    if (rtt > stats->rtt_max)
+    {
+        stats->rtt_max = rtt;
+    }
+}
+
+void NET_Stats_Stalled(net_clientstats_t *stats, boolean stalled,
+                       unsigned int nowtime)
+{
+    if (stalled && !stats->stalled)
+    {
+        ++stats->stalls;
+        stats->stall_start = nowtime;
+    }
+    else if (!stalled && stats->stalled)
+    {
+        stats->stall_ms += nowtime - stats->stall_start;
+    }
+
+    stats->stalled = stalled;
+}
+
+static void WriteString(const char *s)
+{
+    fputc('"', stats_file);
+
+    for (; *s != '\0'; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fprintf(stats_file, "\\%c", *s);
+        }
+        else if ((unsigned char) *s < 0x20)
+        {
+            fprintf(stats_file, "\\u%04x", (unsigned char) *s);
+        }
+        else
+        {
+            fputc(*s, stats_file);
+        }
+    }
+
+    fputc('"', stats_file);
+}
+
+// Counters are totals since the client connected.
+
+void NET_Stats_WriteRecord(net_clientstats_t *stats, net_connection_t *conn,
+                           const char *event, int session, const char *addr,
+                           const char *name, int player)
+{
+    unsigned int stall_ms;
+    int i;
+
+    if (stats_file == NULL)
+    {
+        return;
+    }
+
+    stall_ms = stats->stall_ms;
+
+    if (stats->stalled)
+    {
+        stall_ms += I_GetTimeMS() - stats->stall_start;
+    }
+
+    fprintf(stats_file, "{\"time\":%ld,\"event\":", (long) time(NULL));
+    WriteString(event);
+    fprintf(stats_file, ",\"session\":%d,\"addr\":", session);
+    WriteString(addr);
+    fprintf(stats_file, ",\"name\":");
+    WriteString(name);
+    fprintf(stats_file, ",\"player\":%d", player);
+
+    fprintf(stats_file,
+            ",\"packets_sent\":%u,\"bytes_sent\":%u"
+            ",\"packets_recv\":%u,\"bytes_recv\":%u",
+            conn->packets_sent, conn->bytes_sent,
+            conn->packets_recv, conn->bytes_recv);
+
+    fprintf(stats_file,
+            ",\"tics_sent\":%u,\"tics_resent\":%u"
+            ",\"tics_recv\":%u,\"tics_requested\":%u",
+            stats->tics_sent, stats->tics_resent,
+            stats->tics_recv, stats->tics_requested);
+
+    fprintf(stats_file,
+            ",\"stalls\":%u,\"stall_ms\":%u,\"deadlocks\":%u",
+            stats->stalls, stall_ms, stats->deadlocks);
+
+    fprintf(stats_file, ",\"rtt_count\":%u", stats->rtt_count);
+
+    if (stats->rtt_count > 0)
+    {
+        fprintf(stats_file,
+                ",\"rtt_min\":%u,\"rtt_mean\":%u,\"rtt_max\":%u"
+                ",\"jitter\":%.1f",
+                stats->rtt_min, stats->rtt_total / stats->rtt_count,
+                stats->rtt_max, stats->jitter);
+    }
+
+    fprintf(stats_file, ",\"rtt_hist\":[");
+
+    for (i = 0; i < NET_STATS_RTT_BUCKETS; ++i)
+    {
+        fprintf(stats_file, i > 0 ? ",%u" : "%u", stats->rtt_hist[i]);
+    }
+
+    fprintf(stats_file, "]}\n");
+}
+
+void NET_Stats_Flush(void)
+{
+    if (stats_file != NULL)
+    {
+        fflush(stats_file);
+    }
+}
+
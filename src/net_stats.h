@@ -0,0 +1,94 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Per-client network statistics kept by the server, and written out
+// as one JSON record per line.
+//
+
+#ifndef NET_STATS_H
+#define NET_STATS_H
+
+#include "net_common.h"
+#include "net_defs.h"
+
+// Round trip times are counted in buckets of 0-1ms, 2-3ms, 4-7ms and
+// so on, up to 2048ms and over.
+
+#define NET_STATS_RTT_BUCKETS 12
+
+typedef struct
+{
+    // Time each tic in the send queue was first sent.
+
+    unsigned int send_time[BACKUPTICS];
+
+    // Round trip times, from sending a tic to its acknowledgement.
+
+    unsigned int rtt_count;
+    unsigned int rtt_total;
+    unsigned int rtt_min;
+    unsigned int rtt_max;
+    unsigned int rtt_last;
+    unsigned int rtt_hist[NET_STATS_RTT_BUCKETS];
+
+    // Smoothed variation in round trip time, as RFC 3550 does for
+    // interarrival jitter.
+
+    double jitter;
+
+    // Tics received, and tics that had to be asked for again.
+
+    unsigned int tics_recv;
+    unsigned int tics_requested;
+
+    // Tics sent, and tics that the client asked for again.
+
+    unsigned int tics_sent;
+    unsigned int tics_resent;
+
+    // Times that the send window filled up waiting for this client's
+    // acknowledgements, and how long for in total.
+
+    boolean stalled;
+    unsigned int stall_start;
+    unsigned int stalls;
+    unsigned int stall_ms;
+
+    // Times that NET_SV_CheckDeadlock had to step in.
+
+    unsigned int deadlocks;
+} net_clientstats_t;
+
+void NET_Stats_Init(net_clientstats_t *stats);
+void NET_Stats_TicSent(net_clientstats_t *stats, unsigned int seq,
+                       unsigned int nowtime);
+void NET_Stats_Acknowledged(net_clientstats_t *stats, unsigned int ackseq,
+                            unsigned int nowtime);
+void NET_Stats_Stalled(net_clientstats_t *stats, boolean stalled,
+                       unsigned int nowtime);
+
+// Open the file that records are written to.
+
+void NET_Stats_Open(const char *filename);
+boolean NET_Stats_Enabled(void);
+
+void NET_Stats_WriteRecord(net_clientstats_t *stats, net_connection_t *conn,
+                           const char *event, int session, const char *addr,
+                           const char *name, int player);
+
+// Flush records written so far out to the file.
+
+void NET_Stats_Flush(void);
+
+#endif /* #ifndef NET_STATS_H */
+
@@ -32,6 +32,7 @@ static struct
     const char *name;
 } protocol_names[] = {
     {NET_PROTOCOL_CHOCOLATE_DOOM_0, "CHOCOLATE_DOOM_0"},
+    {NET_PROTOCOL_CHOCOLATE_DOOM_PACKED, "CHOCOLATE_DOOM_PACKED"},
 };
 
 void NET_WriteConnectData(net_packet_t *packet, net_connect_data_t *data)
@@ -457,6 +458,524 @@ void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean l
     }
 }
 
+//
+// Tics in game data packets
+//
+// With NET_PROTOCOL_CHOCOLATE_DOOM_PACKED, the tics are written as a
+// stream of bits.  A tic that is the same as the one before it in the
+// packet takes a single bit, as does a player's ticcmd diff that is
+// the same as the previous player's in the same tic; most tics in a
+// game are one of the two, as the diffs are already relative to each
+// player's previous ticcmd.  Latency is sent as the change from the
+// previous tic.
+//
+
+static void WriteBits(net_ticstream_t *stream, unsigned int value, int bits)
+{
+    int i;
+
+    for (i = bits - 1; i >= 0; --i)
+    {
+        stream->bitbuf = (stream->bitbuf << 1) | ((value >> i) & 1);
+        ++stream->bitcount;
+
+        if (stream->bitcount == 8)
+        {
+            NET_WriteInt8(stream->packet, stream->bitbuf);
+            stream->bitbuf = 0;
+            stream->bitcount = 0;
+        }
+    }
+}
+
+static boolean ReadBits(net_ticstream_t *stream, unsigned int *value, int bits)
+{
+    int i;
+
+    *value = 0;
+
+    for (i = 0; i < bits; ++i)
+    {
+        if (stream->bitcount == 0)
+        {
+            if (!NET_ReadInt8(stream->packet, &stream->bitbuf))
+            {
+                return false;
+            }
+
+            stream->bitcount = 8;
+        }
+
+        --stream->bitcount;
+        *value = (*value << 1) | ((stream->bitbuf >> stream->bitcount) & 1);
+    }
+
+    return true;
+}
+
+// Signed values are written as Exp-Golomb codes, so that small values
+// take few bits: 0 takes one bit, -1 and 1 take three, and so on.
+
+static void WriteSignedBits(net_ticstream_t *stream, int value)
+{
+    unsigned int code;
+    int bits;
+
+    code = (value < 0 ? ((unsigned int) -value << 1) - 1
+                      : (unsigned int) value << 1) + 1;
+
+    for (bits = 1; (code >> bits) != 0; ++bits);
+
+    WriteBits(stream, 0, bits - 1);
+    WriteBits(stream, code, bits);
+}
+
+static boolean ReadSignedBits(net_ticstream_t *stream, int *value)
+{
+    unsigned int code, bit;
+    int zeros;
+
+    for (zeros = 0; ; ++zeros)
+    {
+        if (zeros > 24 || !ReadBits(stream, &bit, 1))
+        {
+            return false;
+        }
+
+        if (bit != 0)
+        {
+            break;
+        }
+    }
+
+    if (!ReadBits(stream, &code, zeros))
+    {
+        return false;
+    }
+
+    code = ((1 << zeros) | code) - 1;
+
+    if (code & 1)
+    {
+        *value = -(int) ((code + 1) >> 1);
+    }
+    else
+    {
+        *value = code >> 1;
+    }
+
+    return true;
+}
+
+static boolean TicdiffsEqual(net_ticdiff_t *a, net_ticdiff_t *b)
+{
+    if (a->diff != b->diff)
+        return false;
+
+    if ((a->diff & NET_TICDIFF_FORWARD)
+     && a->cmd.forwardmove != b->cmd.forwardmove)
+        return false;
+    if ((a->diff & NET_TICDIFF_SIDE)
+     && a->cmd.sidemove != b->cmd.sidemove)
+        return false;
+    if ((a->diff & NET_TICDIFF_TURN)
+     && a->cmd.angleturn != b->cmd.angleturn)
+        return false;
+    if ((a->diff & NET_TICDIFF_BUTTONS)
+     && a->cmd.buttons != b->cmd.buttons)
+        return false;
+    if ((a->diff & NET_TICDIFF_CONSISTANCY)
+     && a->cmd.consistancy != b->cmd.consistancy)
+        return false;
+    if ((a->diff & NET_TICDIFF_CHATCHAR)
+     && a->cmd.chatchar != b->cmd.chatchar)
+        return false;
+    if ((a->diff & NET_TICDIFF_RAVEN)
+     && (a->cmd.lookfly != b->cmd.lookfly || a->cmd.arti != b->cmd.arti))
+        return false;
+    if ((a->diff & NET_TICDIFF_STRIFE)
+     && (a->cmd.buttons2 != b->cmd.buttons2
+      || a->cmd.inventory != b->cmd.inventory))
+        return false;
+
+    return true;
+}
+
+static boolean FullTiccmdsEqual(net_full_ticcmd_t *a, net_full_ticcmd_t *b)
+{
+    int i;
+
+    if (a->latency != b->latency)
+    {
+        return false;
+    }
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (a->playeringame[i] != b->playeringame[i]
+         || (a->playeringame[i] && !TicdiffsEqual(&a->cmds[i], &b->cmds[i])))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void WritePackedTicdiff(net_ticstream_t *stream, net_ticdiff_t *diff)
+{
+    // Most diffs are empty.
+
+    if (diff->diff == 0)
+    {
+        WriteBits(stream, 0, 1);
+        return;
+    }
+
+    WriteBits(stream, 1, 1);
+    WriteBits(stream, diff->diff, 8);
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+        WriteBits(stream, diff->cmd.forwardmove & 0xff, 8);
+    if (diff->diff & NET_TICDIFF_SIDE)
+        WriteBits(stream, diff->cmd.sidemove & 0xff, 8);
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (stream->lowres_turn)
+        {
+            WriteBits(stream, (diff->cmd.angleturn / 256) & 0xff, 8);
+        }
+        else
+        {
+            WriteBits(stream, diff->cmd.angleturn & 0xffff, 16);
+        }
+    }
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+        WriteBits(stream, diff->cmd.buttons, 8);
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+        WriteBits(stream, diff->cmd.consistancy, 8);
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+        WriteBits(stream, diff->cmd.chatchar, 8);
+    if (diff->diff & NET_TICDIFF_RAVEN)
+    {
+        WriteBits(stream, diff->cmd.lookfly, 8);
+        WriteBits(stream, diff->cmd.arti, 8);
+    }
+    if (diff->diff & NET_TICDIFF_STRIFE)
+    {
+        WriteBits(stream, diff->cmd.buttons2, 8);
+        WriteBits(stream, diff->cmd.inventory & 0xffff, 16);
+    }
+}
+
+static boolean ReadPackedTicdiff(net_ticstream_t *stream, net_ticdiff_t *diff)
+{
+    unsigned int val;
+
+    memset(diff, 0, sizeof(net_ticdiff_t));
+
+    if (!ReadBits(stream, &val, 1))
+        return false;
+
+    if (val == 0)
+        return true;
+
+    if (!ReadBits(stream, &diff->diff, 8))
+        return false;
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.forwardmove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.sidemove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN)
+    {
+        if (stream->lowres_turn)
+        {
+            if (!ReadBits(stream, &val, 8))
+                return false;
+            diff->cmd.angleturn = (signed char) val * 256;
+        }
+        else
+        {
+            if (!ReadBits(stream, &val, 16))
+                return false;
+            diff->cmd.angleturn = (short) val;
+        }
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.buttons = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTANCY)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.consistancy = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.chatchar = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_RAVEN)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.lookfly = val;
+
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.arti = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_STRIFE)
+    {
+        if (!ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.buttons2 = val;
+
+        if (!ReadBits(stream, &val, 16))
+            return false;
+        diff->cmd.inventory = val;
+    }
+
+    return true;
+}
+
+static void WritePackedTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd)
+{
+    net_full_ticcmd_t *prev = &stream->prev;
+    net_ticdiff_t *last_diff;
+    unsigned int bitfield;
+    int i;
+
+    if (stream->num_tics > 0)
+    {
+        if (FullTiccmdsEqual(cmd, prev))
+        {
+            WriteBits(stream, 1, 1);
+            return;
+        }
+
+        WriteBits(stream, 0, 1);
+    }
+
+    WriteSignedBits(stream, cmd->latency - prev->latency);
+
+    bitfield = 0;
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (cmd->playeringame[i])
+        {
+            bitfield |= 1 << i;
+        }
+    }
+
+    if (stream->num_tics > 0)
+    {
+        if (!memcmp(cmd->playeringame, prev->playeringame,
+                    sizeof(cmd->playeringame)))
+        {
+            WriteBits(stream, 1, 1);
+        }
+        else
+        {
+            WriteBits(stream, 0, 1);
+            WriteBits(stream, bitfield, NET_MAXPLAYERS);
+        }
+    }
+    else
+    {
+        WriteBits(stream, bitfield, NET_MAXPLAYERS);
+    }
+
+    last_diff = NULL;
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (!cmd->playeringame[i])
+        {
+            continue;
+        }
+
+        if (last_diff != NULL)
+        {
+            if (TicdiffsEqual(&cmd->cmds[i], last_diff))
+            {
+                WriteBits(stream, 1, 1);
+                continue;
+            }
+
+            WriteBits(stream, 0, 1);
+        }
+
+        WritePackedTicdiff(stream, &cmd->cmds[i]);
+        last_diff = &cmd->cmds[i];
+    }
+}
+
+static boolean ReadPackedTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd)
+{
+    net_full_ticcmd_t *prev = &stream->prev;
+    net_ticdiff_t *last_diff;
+    unsigned int val;
+    int latency;
+    int i;
+
+    if (stream->num_tics > 0)
+    {
+        if (!ReadBits(stream, &val, 1))
+        {
+            return false;
+        }
+
+        if (val != 0)
+        {
+            cmd->latency = prev->latency;
+            memcpy(cmd->playeringame, prev->playeringame,
+                   sizeof(cmd->playeringame));
+            memcpy(cmd->cmds, prev->cmds, sizeof(cmd->cmds));
+            return true;
+        }
+    }
+
+    if (!ReadSignedBits(stream, &latency))
+    {
+        return false;
+    }
+
+    cmd->latency = prev->latency + latency;
+
+    val = 0;
+
+    if (stream->num_tics > 0 && !ReadBits(stream, &val, 1))
+    {
+        return false;
+    }
+
+    if (val != 0)
+    {
+        memcpy(cmd->playeringame, prev->playeringame,
+               sizeof(cmd->playeringame));
+    }
+    else
+    {
+        if (!ReadBits(stream, &val, NET_MAXPLAYERS))
+        {
+            return false;
+        }
+
+        for (i=0; i<NET_MAXPLAYERS; ++i)
+        {
+            cmd->playeringame[i] = (val & (1 << i)) != 0;
+        }
+    }
+
+    last_diff = NULL;
+
+    for (i=0; i<NET_MAXPLAYERS; ++i)
+    {
+        if (!cmd->playeringame[i])
+        {
+            continue;
+        }
+
+        if (last_diff != NULL)
+        {
+            if (!ReadBits(stream, &val, 1))
+            {
+                return false;
+            }
+
+            if (val != 0)
+            {
+                cmd->cmds[i] = *last_diff;
+                continue;
+            }
+        }
+
+        if (!ReadPackedTicdiff(stream, &cmd->cmds[i]))
+        {
+            return false;
+        }
+
+        last_diff = &cmd->cmds[i];
+    }
+
+    return true;
+}
+
+void NET_TicStream_Init(net_ticstream_t *stream, net_packet_t *packet,
+                        net_protocol_t protocol, boolean lowres_turn)
+{
+    memset(stream, 0, sizeof(net_ticstream_t));
+    stream->packet = packet;
+    stream->protocol = protocol;
+    stream->lowres_turn = lowres_turn;
+}
+
+boolean NET_TicStream_ReadTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd)
+{
+    if (stream->protocol != NET_PROTOCOL_CHOCOLATE_DOOM_PACKED)
+    {
+        return NET_ReadFullTiccmd(stream->packet, cmd, stream->lowres_turn);
+    }
+
+    if (!ReadPackedTic(stream, cmd))
+    {
+        return false;
+    }
+
+    stream->prev = *cmd;
+    ++stream->num_tics;
+
+    return true;
+}
+
+void NET_TicStream_WriteTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd)
+{
+    if (stream->protocol != NET_PROTOCOL_CHOCOLATE_DOOM_PACKED)
+    {
+        NET_WriteFullTiccmd(stream->packet, cmd, stream->lowres_turn);
+        return;
+    }
+
+    WritePackedTic(stream, cmd);
+    stream->prev = *cmd;
+    ++stream->num_tics;
+}
+
+// Write out any bits left over, padded to a whole byte.
+
+void NET_TicStream_Finish(net_ticstream_t *stream)
+{
+    if (stream->bitcount > 0)
+    {
+        NET_WriteInt8(stream->packet,
+                      stream->bitbuf << (8 - stream->bitcount));
+        stream->bitbuf = 0;
+        stream->bitcount = 0;
+    }
+}
+
 void NET_WriteWaitData(net_packet_t *packet, net_waitdata_t *data)
 {
     int i;
@@ -37,6 +37,27 @@ extern void NET_TiccmdPatch(ticcmd_t *src, net_ticdiff_t *diff, ticcmd_t *dest);
 boolean NET_ReadFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, boolean lowres_turn);
 
+// Tics in a game data packet, in the format of the protocol in use.
+// Each tic may be written relative to the one before it, so the tics
+// in a packet must be read and written in order with one stream.
+
+typedef struct
+{
+    net_packet_t *packet;
+    net_protocol_t protocol;
+    boolean lowres_turn;
+    unsigned int bitbuf;
+    int bitcount;
+    int num_tics;
+    net_full_ticcmd_t prev;
+} net_ticstream_t;
+
+void NET_TicStream_Init(net_ticstream_t *stream, net_packet_t *packet,
+                        net_protocol_t protocol, boolean lowres_turn);
+boolean NET_TicStream_ReadTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd);
+void NET_TicStream_WriteTic(net_ticstream_t *stream, net_full_ticcmd_t *cmd);
+void NET_TicStream_Finish(net_ticstream_t *stream);
+
 boolean NET_ReadSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 void NET_WriteSHA1Sum(net_packet_t *packet, sha1_digest_t digest);
 
@@ -0,0 +1,284 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Checks that game data packets written with each protocol read
+//     back the same, using made up games, and compares the sizes of
+//     the packets.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "net_packet.h"
+#include "net_structrw.h"
+#include "z_zone.h"
+
+#define NUM_TICS 20000
+#define NUM_PACKETS 100000
+#define MAX_PACKET_TICS 8
+
+static net_full_ticcmd_t tics[NUM_TICS];
+
+void *Z_Malloc2(int size, int tag, void *ptr, const char *file, int line)
+{
+    return malloc(size);
+}
+
+void Z_Free(void *ptr)
+{
+    free(ptr);
+}
+
+void I_Error(const char *error, ...)
+{
+    va_list args;
+
+    va_start(args, error);
+    vfprintf(stderr, error, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+
+    exit(1);
+}
+
+boolean M_StringCopy(char *dest, const char *src, size_t dest_size)
+{
+    snprintf(dest, dest_size, "%s", src);
+    return strlen(src) < dest_size;
+}
+
+// Players keep doing the same thing for a while: standing still,
+// running, or turning, as they would in a real game.
+
+static void MakeGame(int num_players, boolean lowres_turn)
+{
+    ticcmd_t last[NET_MAXPLAYERS];
+    ticcmd_t cmd;
+    int latency;
+    int t, i;
+
+    memset(last, 0, sizeof(last));
+    latency = 50;
+
+    for (t = 0; t < NUM_TICS; ++t)
+    {
+        if (rand() % 20 == 0)
+        {
+            latency += rand() % 21 - 10;
+        }
+
+        tics[t].seq = t;
+        tics[t].latency = latency;
+
+        for (i = 0; i < NET_MAXPLAYERS; ++i)
+        {
+            tics[t].playeringame[i] = i < num_players
+                                   && (i != 1 || t < NUM_TICS / 2);
+
+            if (!tics[t].playeringame[i])
+            {
+                continue;
+            }
+
+            cmd = last[i];
+            cmd.chatchar = 0;
+            cmd.arti = 0;
+            cmd.inventory = 0;
+
+            if (rand() % 10 == 0)
+            {
+                cmd.forwardmove = rand() % 101 - 50;
+                cmd.sidemove = rand() % 3 == 0 ? rand() % 81 - 40 : 0;
+                cmd.angleturn = rand() % 2 == 0 ? 0 : rand() % 4096 - 2048;
+                cmd.buttons = rand() % 4 == 0 ? rand() % 256 : 0;
+            }
+
+            if (lowres_turn)
+            {
+                cmd.angleturn &= 0xff00;
+            }
+
+            if (rand() % 35 == 0)
+            {
+                cmd.consistancy = rand() % 256;
+            }
+
+            if (rand() % 200 == 0)
+            {
+                cmd.chatchar = 'a' + rand() % 26;
+            }
+
+            if (rand() % 100 == 0)
+            {
+                cmd.lookfly = rand() % 256;
+                cmd.arti = rand() % 256;
+            }
+
+            if (rand() % 100 == 0)
+            {
+                cmd.buttons2 = rand() % 256;
+                cmd.inventory = rand() % 65536;
+            }
+
+            NET_TiccmdDiff(&last[i], &cmd, &tics[t].cmds[i]);
+            last[i] = cmd;
+        }
+    }
+}
+
+static boolean SameTic(net_full_ticcmd_t *a, net_full_ticcmd_t *b)
+{
+    ticcmd_t base, cmd1, cmd2;
+    int i;
+
+    if (a->latency != b->latency
+     || memcmp(a->playeringame, b->playeringame, sizeof(a->playeringame)))
+    {
+        return false;
+    }
+
+    // Only the fields in the diff are sent, so compare the results of
+    // applying the diffs.
+
+    memset(&base, 0x55, sizeof(base));
+
+    for (i = 0; i < NET_MAXPLAYERS; ++i)
+    {
+        if (a->playeringame[i])
+        {
+            NET_TiccmdPatch(&base, &a->cmds[i], &cmd1);
+            NET_TiccmdPatch(&base, &b->cmds[i], &cmd2);
+
+            if (memcmp(&cmd1, &cmd2, sizeof(ticcmd_t)))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static net_packet_t *WritePacket(net_protocol_t protocol, boolean lowres_turn,
+                                 int start, int num_tics)
+{
+    net_ticstream_t stream;
+    net_packet_t *packet;
+    int i;
+
+    packet = NET_NewPacket(100);
+    NET_TicStream_Init(&stream, packet, protocol, lowres_turn);
+
+    for (i = start; i < start + num_tics; ++i)
+    {
+        NET_TicStream_WriteTic(&stream, &tics[i]);
+    }
+
+    NET_TicStream_Finish(&stream);
+
+    return packet;
+}
+
+static boolean ReadPacket(net_packet_t *packet, net_protocol_t protocol,
+                          boolean lowres_turn, int start, int num_tics)
+{
+    net_ticstream_t stream;
+    net_full_ticcmd_t cmd;
+    int i;
+
+    packet->pos = 0;
+    NET_TicStream_Init(&stream, packet, protocol, lowres_turn);
+
+    for (i = start; i < start + num_tics; ++i)
+    {
+        if (!NET_TicStream_ReadTic(&stream, &cmd) || !SameTic(&cmd, &tics[i]))
+        {
+            return false;
+        }
+    }
+
+    return packet->pos == packet->len;
+}
+
+static boolean CheckGame(int num_players, boolean lowres_turn)
+{
+    net_packet_t *packet;
+    size_t size[NET_NUM_PROTOCOLS];
+    int start, num_tics;
+    int protocol;
+    int i;
+
+    MakeGame(num_players, lowres_turn);
+    memset(size, 0, sizeof(size));
+
+    for (i = 0; i < NUM_PACKETS; ++i)
+    {
+        // Mostly packets of two tics, as with the default -extratics,
+        // and some longer ones, as when tics are resent.
+
+        num_tics = rand() % 4 == 0 ? 1 + rand() % MAX_PACKET_TICS : 2;
+        start = rand() % (NUM_TICS - num_tics);
+
+        for (protocol = 0; protocol < NET_NUM_PROTOCOLS; ++protocol)
+        {
+            packet = WritePacket(protocol, lowres_turn, start, num_tics);
+            size[protocol] += packet->len;
+
+            if (!ReadPacket(packet, protocol, lowres_turn, start, num_tics))
+            {
+                printf("%i players%s: protocol %i: tics %i-%i read back "
+                       "wrong\n", num_players, lowres_turn ? ", lowres" : "",
+                       protocol, start, start + num_tics - 1);
+                return false;
+            }
+
+            // Cut short packets must not be read past the end.
+
+            packet->len = rand() % (packet->len + 1);
+            ReadPacket(packet, protocol, lowres_turn, start, num_tics);
+
+            NET_FreePacket(packet);
+        }
+    }
+
+    printf("%i players%s:", num_players, lowres_turn ? ", lowres" : "");
+
+    for (protocol = 0; protocol < NET_NUM_PROTOCOLS; ++protocol)
+    {
+        printf(" %.1f", (double) size[protocol] / NUM_PACKETS);
+    }
+
+    printf(" bytes per packet\n");
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_players;
+
+    srand(1);
+
+    for (num_players = 1; num_players <= NET_MAXPLAYERS; num_players *= 2)
+    {
+        if (!CheckGame(num_players, false) || !CheckGame(num_players, true))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
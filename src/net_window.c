@@ -0,0 +1,521 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Client side of the game data exchange with the server.  This is
+// used by the game's client (net_client.c), and by the load generator,
+// which runs many clients at once.
+//
+
+#include <string.h>
+
+#include "i_timer.h"
+#include "net_io.h"
+#include "net_packet.h"
+#include "net_structrw.h"
+#include "net_window.h"
+
+#define NET_Window_ExpandTicNum(w, b) NET_ExpandTicNum((w)->recvwindow_start, (b))
+
+void NET_Window_Init(net_window_t *window, net_connection_t *connection,
+                     net_gamesettings_t *settings)
+{
+    window->connection = connection;
+    window->settings = settings;
+
+    // Start from a ticcmd of all zeros
+
+    memset(&window->last_ticcmd, 0, sizeof(ticcmd_t));
+
+    // Clear the receive window
+
+    memset(window->recvwindow, 0, sizeof(window->recvwindow));
+    window->recvwindow_start = 0;
+
+    // Clear the send queue
+
+    memset(window->send_queue, 0, sizeof(window->send_queue));
+
+    window->need_to_acknowledge = false;
+    window->gamedata_recv_time = I_GetTimeMS();
+    window->last_latency = 0;
+    window->resend_requests = 0;
+}
+
+// Called when a packet is received from the server containing game
+// data, with the last tic in the packet.
+
+static void UpdateLatency(net_window_t *window, unsigned int seq,
+                          unsigned int remote_latency)
+{
+    net_window_send_t *sendobj;
+    int latency;
+
+    sendobj = &window->send_queue[seq % BACKUPTICS];
+
+    if (seq == sendobj->seq)
+    {
+        latency = I_GetTimeMS() - sendobj->time;
+    }
+    else if (seq > sendobj->seq)
+    {
+        // We have received the ticcmd from the server before we have
+        // even sent ours
+
+        latency = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    window->last_latency = latency;
+
+    if (window->ClockSync != NULL)
+    {
+        window->ClockSync(window, latency, remote_latency);
+    }
+}
+
+static void SendGameDataACK(net_window_t *window)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
+    NET_WriteInt8(packet, window->recvwindow_start & 0xff);
+
+    NET_Conn_SendPacket(window->connection, packet);
+
+    NET_FreePacket(packet);
+
+    window->need_to_acknowledge = false;
+}
+
+static void SendTics(net_window_t *window, int start, int end)
+{
+    net_packet_t *packet;
+    int i;
+
+    if (start < 0)
+        start = 0;
+
+    // Build a new packet to send to the server
+
+    packet = NET_NewPacket(512);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
+
+    // Write the start tic and number of tics.  Send only the low byte
+    // of start - it can be inferred by the server.
+
+    NET_WriteInt8(packet, window->recvwindow_start & 0xff);
+    NET_WriteInt8(packet, start & 0xff);
+    NET_WriteInt8(packet, end - start + 1);
+
+    // Add the tics.
+
+    for (i=start; i<=end; ++i)
+    {
+        net_window_send_t *sendobj;
+
+        sendobj = &window->send_queue[i % BACKUPTICS];
+
+        NET_WriteInt16(packet, window->last_latency);
+
+        NET_WriteTiccmdDiff(packet, &sendobj->cmd,
+                            window->settings->lowres_turn);
+    }
+
+    // Send the packet
+
+    NET_Conn_SendPacket(window->connection, packet);
+
+    // All done!
+
+    NET_FreePacket(packet);
+
+    // Acknowledgement has been sent as part of the packet
+
+    window->need_to_acknowledge = false;
+}
+
+void NET_Window_SendTiccmd(net_window_t *window, ticcmd_t *ticcmd,
+                           int maketic)
+{
+    net_ticdiff_t diff;
+    net_window_send_t *sendobj;
+    int starttic, endtic;
+
+    // Calculate the difference to the last ticcmd
+
+    NET_TiccmdDiff(&window->last_ticcmd, ticcmd, &diff);
+
+    // Store in the send queue
+
+    sendobj = &window->send_queue[maketic % BACKUPTICS];
+    sendobj->active = true;
+    sendobj->seq = maketic;
+    sendobj->time = I_GetTimeMS();
+    sendobj->cmd = diff;
+
+    window->last_ticcmd = *ticcmd;
+
+    // Send to server.
+
+    starttic = maketic - window->settings->extratics;
+    endtic = maketic;
+
+    if (starttic < 0)
+        starttic = 0;
+
+    NET_Log("client: generated tic %d, sending %d-%d",
+            maketic, starttic, endtic);
+    SendTics(window, starttic, endtic);
+}
+
+static void SendResendRequest(net_window_t *window, int start, int end)
+{
+    net_packet_t *packet;
+    unsigned int nowtime;
+    int i;
+
+    packet = NET_NewPacket(64);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_RESEND);
+    NET_WriteInt32(packet, start);
+    NET_WriteInt8(packet, end - start + 1);
+    NET_Conn_SendPacket(window->connection, packet);
+    NET_FreePacket(packet);
+
+    ++window->resend_requests;
+
+    nowtime = I_GetTimeMS();
+
+    // Save the time we sent the resend request
+
+    for (i=start; i<=end; ++i)
+    {
+        int index;
+
+        index = i - window->recvwindow_start;
+
+        if (index < 0 || index >= BACKUPTICS)
+            continue;
+
+        window->recvwindow[index].resend_time = nowtime;
+    }
+}
+
+// Check for expired resend requests
+
+static void CheckResends(net_window_t *window)
+{
+    int i;
+    int resend_start, resend_end;
+    unsigned int nowtime;
+    boolean maybe_deadlocked;
+
+    nowtime = I_GetTimeMS();
+    maybe_deadlocked = nowtime - window->gamedata_recv_time > 1000;
+
+    resend_start = -1;
+    resend_end = -1;
+
+    for (i=0; i<BACKUPTICS; ++i)
+    {
+        net_window_recv_t *recvobj;
+        boolean need_resend;
+
+        recvobj = &window->recvwindow[i];
+
+        // if need_resend is true, this tic needs another retransmit
+        // request (300ms timeout)
+
+        need_resend = !recvobj->active
+                   && recvobj->resend_time != 0
+                   && nowtime > recvobj->resend_time + 300;
+
+        // if no game data has been received in a long time, we may be in
+        // a deadlock scenario where tics from the server have been lost, so
+        // we've stopped generating any more, so the server isn't sending us
+        // any, so we don't get any to trigger a resend request. So force the
+        // first few tics in the receive window to be requested.
+        if (i == 0 && !recvobj->active && recvobj->resend_time == 0
+         && maybe_deadlocked)
+        {
+            need_resend = true;
+        }
+
+        if (need_resend)
+        {
+            // Start a new run of resend tics?
+
+            if (resend_start < 0)
+            {
+                resend_start = i;
+            }
+
+            resend_end = i;
+        }
+        else if (resend_start >= 0)
+        {
+            // End of a run of resend tics
+            NET_Log("client: resend request timed out for %d-%d (%d)",
+                    window->recvwindow_start + resend_start,
+                    window->recvwindow_start + resend_end,
+                    window->recvwindow[resend_start].resend_time);
+            SendResendRequest(window,
+                              window->recvwindow_start + resend_start,
+                              window->recvwindow_start + resend_end);
+            resend_start = -1;
+        }
+    }
+
+    if (resend_start >= 0)
+    {
+        NET_Log("client: resend request timed out for %d-%d (%d)",
+                window->recvwindow_start + resend_start,
+                window->recvwindow_start + resend_end,
+                window->recvwindow[resend_start].resend_time);
+        SendResendRequest(window,
+                          window->recvwindow_start + resend_start,
+                          window->recvwindow_start + resend_end);
+    }
+
+    // We have received some data from the server and not acknowledged
+    // it yet.  Normally this gets acknowledged when we send our game
+    // data, but if the client is a drone we need to do this.
+
+    if (window->need_to_acknowledge
+     && nowtime - window->gamedata_recv_time > 200)
+    {
+        NET_Log("client: no game data received since %d: triggering ack",
+                window->gamedata_recv_time);
+        SendGameDataACK(window);
+    }
+}
+
+// Parsing of NET_PACKET_TYPE_GAMEDATA packets
+// (packets containing the actual ticcmd data)
+
+void NET_Window_ParseGameData(net_window_t *window, net_packet_t *packet)
+{
+    net_window_recv_t *recvobj;
+    net_ticstream_t stream;
+    unsigned int seq, num_tics;
+    unsigned int nowtime;
+    int resend_start, resend_end;
+    size_t i;
+    int index;
+
+    NET_Log("client: processing game data packet");
+
+    // Read header
+    if (!NET_ReadInt8(packet, &seq)
+     || !NET_ReadInt8(packet, &num_tics))
+    {
+        NET_Log("client: error: failed to read header");
+        return;
+    }
+
+    nowtime = I_GetTimeMS();
+
+    // Whatever happens, we now need to send an acknowledgement of our
+    // current receive point.
+
+    if (!window->need_to_acknowledge)
+    {
+        window->need_to_acknowledge = true;
+        window->gamedata_recv_time = nowtime;
+    }
+
+    // Expand byte value into the full tic number
+    seq = NET_Window_ExpandTicNum(window, seq);
+    NET_Log("client: got game data, seq=%d, num_tics=%d", seq, num_tics);
+
+    NET_TicStream_Init(&stream, packet, window->connection->protocol,
+                       window->settings->lowres_turn);
+
+    for (i=0; i<num_tics; ++i)
+    {
+        net_full_ticcmd_t cmd;
+
+        index = seq - window->recvwindow_start + i;
+
+        if (!NET_TicStream_ReadTic(&stream, &cmd))
+        {
+            NET_Log("client: error: failed to read ticcmd %d", i);
+            return;
+        }
+
+        if (index < 0 || index >= BACKUPTICS)
+        {
+            // Out of range of the recv window
+
+            continue;
+        }
+
+        // Store in the receive window
+
+        recvobj = &window->recvwindow[index];
+
+        recvobj->active = true;
+        recvobj->cmd = cmd;
+        NET_Log("client: stored tic %d in receive window", seq + i);
+
+        // If a packet is lost or arrives out of order, we might get
+        // the tic in the next packet instead (because of extratic).
+        // If that's the case then the latency for receiving that tic
+        // now will be bogus. So we only use the last tic in the packet
+        // to trigger a clock sync update.
+        if (i == num_tics - 1)
+        {
+            UpdateLatency(window, seq + i, cmd.latency);
+        }
+    }
+
+    // Has this been received out of sequence, ie. have we not received
+    // all tics before the first tic in this packet?  If so, send a
+    // resend request.
+
+    resend_end = seq - window->recvwindow_start;
+
+    if (resend_end <= 0)
+        return;
+
+    if (resend_end >= BACKUPTICS)
+        resend_end = BACKUPTICS - 1;
+
+    index = resend_end - 1;
+    resend_start = resend_end;
+
+    while (index >= 0)
+    {
+        recvobj = &window->recvwindow[index];
+
+        if (recvobj->active)
+        {
+            // ended our run of unreceived tics
+
+            break;
+        }
+
+        if (recvobj->resend_time != 0)
+        {
+            // Already sent a resend request for this tic
+
+            break;
+        }
+
+        resend_start = index;
+        --index;
+    }
+
+    // Possibly send a resend request
+    if (resend_start < resend_end)
+    {
+        NET_Log("client: request resend for %d-%d before %d",
+                window->recvwindow_start + resend_start,
+                window->recvwindow_start + resend_end - 1, seq);
+        SendResendRequest(window, window->recvwindow_start + resend_start,
+                          window->recvwindow_start + resend_end - 1);
+    }
+}
+
+// Parse a resend request from the server due to a dropped packet
+
+boolean NET_Window_ParseResendRequest(net_window_t *window,
+                                      net_packet_t *packet)
+{
+    net_window_send_t *send_queue;
+    unsigned int start;
+    unsigned int end;
+    unsigned int num_tics;
+
+    if (!NET_ReadInt32(packet, &start)
+     || !NET_ReadInt8(packet, &num_tics))
+    {
+        NET_Log("client: error: couldn't read start and num_tics");
+        return false;
+    }
+
+    end = start + num_tics - 1;
+
+    NET_Log("client: resend request: start=%d, num_tics=%d", start, num_tics);
+
+    // Check we have the tics being requested.  If not, reduce the
+    // window of tics to only what we have.
+
+    send_queue = window->send_queue;
+
+    while (start <= end
+        && (!send_queue[start % BACKUPTICS].active
+         || send_queue[start % BACKUPTICS].seq != start))
+    {
+        ++start;
+    }
+
+    while (start <= end
+        && (!send_queue[end % BACKUPTICS].active
+         || send_queue[end % BACKUPTICS].seq != end))
+    {
+        --end;
+    }
+
+    // Resend those tics
+    if (start <= end)
+    {
+        NET_Log("client: resending %d-%d", start, end);
+        SendTics(window, start, end);
+        return true;
+    }
+    else
+    {
+        NET_Log("client: don't have the tics to resend");
+        return false;
+    }
+}
+
+// Advance the receive window
+
+static void AdvanceWindow(net_window_t *window)
+{
+    while (window->recvwindow[0].active)
+    {
+        window->RunTic(window, &window->recvwindow[0].cmd,
+                       window->recvwindow_start);
+
+        // Advance the window
+
+        memmove(window->recvwindow, window->recvwindow + 1,
+                sizeof(net_window_recv_t) * (BACKUPTICS - 1));
+        memset(&window->recvwindow[BACKUPTICS-1], 0,
+               sizeof(net_window_recv_t));
+
+        ++window->recvwindow_start;
+
+        NET_Log("client: advanced receive window to %d",
+                window->recvwindow_start);
+    }
+}
+
+void NET_Window_Run(net_window_t *window)
+{
+    // Possibly advance the receive window
+
+    AdvanceWindow(window);
+
+    // Check if our resend requests have timed out
+
+    CheckResends(window);
+}
+
@@ -0,0 +1,142 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Client side of the game data exchange with the server: the queue
+// of ticcmds sent to the server, and the window of tics received
+// back, with acknowledgements and resend requests.
+//
+
+#ifndef NET_WINDOW_H
+#define NET_WINDOW_H
+
+#include "d_ticcmd.h"
+#include "net_common.h"
+#include "net_defs.h"
+
+// Type of structure used in the receive window
+
+typedef struct
+{
+    // Whether this tic has been received yet
+
+    boolean active;
+
+    // Last time we sent a resend request for this tic
+
+    unsigned int resend_time;
+
+    // Tic data from server
+
+    net_full_ticcmd_t cmd;
+
+} net_window_recv_t;
+
+// Type of structure used in the send window
+
+typedef struct
+{
+    // Whether this slot is active yet
+
+    boolean active;
+
+    // The tic number
+
+    unsigned int seq;
+
+    // Time the command was generated
+
+    unsigned int time;
+
+    // Ticcmd diff
+
+    net_ticdiff_t cmd;
+} net_window_send_t;
+
+typedef struct net_window_s net_window_t;
+
+struct net_window_s
+{
+    // Connection to the server, and the settings of the game.
+
+    net_connection_t *connection;
+    net_gamesettings_t *settings;
+
+    // Called for each tic, in order, as the receive window moves
+    // past it.
+
+    void (*RunTic)(net_window_t *window, net_full_ticcmd_t *cmd,
+                   unsigned int seq);
+
+    // Called with our latency for the last tic in each game data
+    // packet, and the latency of the worst other player, as sent by
+    // the server.  May be NULL.
+
+    void (*ClockSync)(net_window_t *window, int latency, int remote_latency);
+
+    void *user_data;
+
+    // The last ticcmd constructed
+
+    ticcmd_t last_ticcmd;
+
+    // Buffer of ticcmd diffs being sent to the server
+
+    net_window_send_t send_queue[BACKUPTICS];
+
+    // Receive window
+
+    int recvwindow_start;
+    net_window_recv_t recvwindow[BACKUPTICS];
+
+    // Whether we need to send an acknowledgement and
+    // when gamedata was last received.
+
+    boolean need_to_acknowledge;
+    unsigned int gamedata_recv_time;
+
+    // The latency (time between when we sent our command and we got
+    // all the other players' commands from the server) for the last
+    // tic we received.  We include this latency in tics we send to
+    // the server so that they can adjust to us.
+
+    int last_latency;
+
+    // Number of resend requests sent to the server.
+
+    unsigned int resend_requests;
+};
+
+// Start a new game.  The callbacks and user_data are left as they are.
+
+void NET_Window_Init(net_window_t *window, net_connection_t *connection,
+                     net_gamesettings_t *settings);
+
+// Add a new ticcmd to the send queue, and send it to the server.
+
+void NET_Window_SendTiccmd(net_window_t *window, ticcmd_t *ticcmd,
+                           int maketic);
+
+void NET_Window_ParseGameData(net_window_t *window, net_packet_t *packet);
+
+// Returns true if any of the tics asked for were resent.
+
+boolean NET_Window_ParseResendRequest(net_window_t *window,
+                                      net_packet_t *packet);
+
+// Advance the receive window, and send any acknowledgements and resend
+// requests that are due.
+
+void NET_Window_Run(net_window_t *window);
+
+#endif /* #ifndef NET_WINDOW_H */
+
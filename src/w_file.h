@@ -37,6 +37,12 @@ typedef struct
     // provided buffer.  Returns the number of bytes read.
     size_t (*Read)(wad_file_t *file, unsigned int offset,
                    void *buffer, size_t buffer_len);
+
+    // Hint that the specified range of the file will be read soon,
+    // so that the OS can start reading it in the background.  May be
+    // NULL if the class has no way to do this.
+    void (*Prefetch)(wad_file_t *file, unsigned int offset,
+                     size_t buffer_len);
 } wad_file_class_t;
 
 
@@ -83,4 +89,9 @@ void W_CloseFile(wad_file_t *wad);
 size_t W_Read(wad_file_t *wad, unsigned int offset,
               void *buffer, size_t buffer_len);
 
+// Hint that the specified range of the file will be read soon.  This
+// does not block and does nothing if the file class cannot prefetch.
+
+void W_Prefetch(wad_file_t *wad, unsigned int offset, size_t buffer_len);
+
 #endif /* #ifndef __W_FILE__ */
@@ -22,6 +22,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <string.h>
@@ -43,15 +44,17 @@ static void MapFile(posix_wad_file_t *wad, const char *filename)
     int protection;
     int flags;
 
-    // Mapped area can be read and written to.  Ideally
-    // this should be read-only, as none of the Doom code should 
-    // change the WAD files after being read.  However, there may
-    // be code lurking in the source that does.
+    // Mapped area can be read and written to.  None of the Doom code
+    // should change lumps in place (anything that needs to, such as
+    // P_LoadBlockMap, reads its own copy with W_ReadLump), but there
+    // may be code lurking in the source that does.
 
     protection = PROT_READ|PROT_WRITE;
 
     // Writes to the mapped area result in private changes that are
-    // *not* written to disk.
+    // *not* written to disk.  Only the pages actually written are
+    // copied; the rest stay shared with the page cache, and so with
+    // any other processes that have the same WAD open.
 
     flags = MAP_PRIVATE;
 
@@ -67,6 +70,15 @@ static void MapFile(posix_wad_file_t *wad, const char *filename)
     else
     {
         wad->wad.mapped = result;
+
+#ifdef MADV_RANDOM
+        // Lumps are looked up through the directory and read in no
+        // particular order, so readahead around each page fault mostly
+        // pulls in data that is never used.  W_CacheLumpNum asks for
+        // whole lumps with MADV_WILLNEED instead.
+
+        madvise(result, wad->wad.length, MADV_RANDOM);
+#endif
     }
 }
 
@@ -163,12 +175,41 @@ size_t W_POSIX_Read(wad_file_t *wad, unsigned int offset,
     return bytes_read;
 }
 
+static void W_POSIX_Prefetch(wad_file_t *wad, unsigned int offset,
+                             size_t buffer_len)
+{
+    posix_wad_file_t *posix_wad;
+    uintptr_t start, end;
+    long pagesize;
+
+    posix_wad = (posix_wad_file_t *) wad;
+
+    if (posix_wad->wad.mapped == NULL)
+    {
+#ifdef HAVE_POSIX_FADVISE
+        posix_fadvise(posix_wad->handle, offset, buffer_len,
+                      POSIX_FADV_WILLNEED);
+#endif
+        return;
+    }
+
+    // madvise() needs a page aligned address.
+
+    pagesize = sysconf(_SC_PAGESIZE);
+    start = (uintptr_t) (posix_wad->wad.mapped + offset);
+    end = start + buffer_len;
+    start &= ~(uintptr_t) (pagesize - 1);
+
+    madvise((void *) start, end - start, MADV_WILLNEED);
+}
+
 
 wad_file_class_t posix_wad_file = 
 {
     W_POSIX_OpenFile,
     W_POSIX_CloseFile,
     W_POSIX_Read,
+    W_POSIX_Prefetch,
 };
 
 
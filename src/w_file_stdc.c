@@ -18,6 +18,12 @@
 
 #include <stdio.h>
 
+#include "config.h"
+
+#ifdef HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
 #include "m_misc.h"
 #include "w_file.h"
 #include "z_zone.h"
@@ -85,12 +91,34 @@ size_t W_StdC_Read(wad_file_t *wad, unsigned int offset,
     return result;
 }
 
+#ifdef HAVE_POSIX_FADVISE
+
+// Ask the kernel to start reading the range into the page cache.
+
+static void W_StdC_Prefetch(wad_file_t *wad, unsigned int offset,
+                            size_t buffer_len)
+{
+    stdc_wad_file_t *stdc_wad;
+
+    stdc_wad = (stdc_wad_file_t *) wad;
+
+    posix_fadvise(fileno(stdc_wad->fstream), offset, buffer_len,
+                  POSIX_FADV_WILLNEED);
+}
+
+#endif
+
 
 wad_file_class_t stdc_wad_file = 
 {
     W_StdC_OpenFile,
     W_StdC_CloseFile,
     W_StdC_Read,
+#ifdef HAVE_POSIX_FADVISE
+    W_StdC_Prefetch,
+#else
+    NULL,
+#endif
 };
 
 
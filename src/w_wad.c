@@ -111,10 +111,13 @@ wad_file_t *W_AddFile (const char *filename)
     filelump_t *filerover;
     lumpinfo_t *filelumps;
     int numfilelumps;
+    boolean is_reload;
 
     // If the filename begins with a ~, it indicates that we should use the
     // reload hack.
-    if (filename[0] == '~')
+    is_reload = filename[0] == '~';
+
+    if (is_reload)
     {
         if (reloadname != NULL)
         {
@@ -131,8 +134,18 @@ wad_file_t *W_AddFile (const char *filename)
         ++filename;
     }
 
-    // Open the file and add to directory
-    wad_file = W_OpenFile(filename);
+    // Open the file and add to directory.  The reload file is being
+    // edited while we run, so it is never memory-mapped: a mapping
+    // would see the file change (or be truncated) under it.
+
+    if (is_reload)
+    {
+        wad_file = stdc_wad_file.OpenFile(filename);
+    }
+    else
+    {
+        wad_file = W_OpenFile(filename);
+    }
 
     if (wad_file == NULL)
     {
@@ -232,7 +245,7 @@ wad_file_t *W_AddFile (const char *filename)
 
     // If this is the reload file, we need to save some details about the
     // file so that we can close it later on when we do a reload.
-    if (reloadname)
+    if (is_reload)
     {
         reloadhandle = wad_file;
         reloadlumps = filelumps;
@@ -369,6 +382,17 @@ void W_ReadLump(lumpindex_t lump, void *dest)
 
 
 
+// Lumps are read as arrays of structures, so a lump can only be used
+// straight from a mapping if it starts on a suitable boundary.  The
+// mapping itself is page aligned; most WAD tools align lumps, but
+// nothing requires it, so misaligned lumps are copied instead.
+
+static boolean W_LumpIsMapped(lumpinfo_t *lump)
+{
+    return lump->wad_file->mapped != NULL
+        && (lump->position & (sizeof(int) - 1)) == 0;
+}
+
 //
 // W_CacheLumpNum
 //
@@ -380,6 +404,10 @@ void W_ReadLump(lumpindex_t lump, void *dest)
 // PU_STATIC, it should be released back using W_ReleaseLumpNum
 // when no longer needed (do not use Z_ChangeTag).
 //
+// WAD files are usually memory-mapped, in which case the returned
+// pointer is usually into the mapping rather than a copy.  Code that
+// needs to modify a lump should read its own copy with W_ReadLump.
+//
 
 void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
 {
@@ -398,11 +426,22 @@ void *W_CacheLumpNum(lumpindex_t lumpnum, int tag)
     // region.  If the lump is in an ordinary file, we may already
     // have it cached; otherwise, load it into memory.
 
-    if (lump->wad_file->mapped != NULL)
+    if (W_LumpIsMapped(lump))
     {
         // Memory mapped file, return from the mmapped region.
 
         result = lump->wad_file->mapped + lump->position;
+
+        // Non-purgable lumps (level data, sounds, demos) are about to
+        // be read from end to end, so have the whole lump read in at
+        // once rather than a page at a time.  Purgable lumps are
+        // mostly patches drawn every frame; they are hinted when the
+        // level is precached instead.
+
+        if (tag < PU_PURGELEVEL)
+        {
+            W_Prefetch(lump->wad_file, lump->position, lump->size);
+        }
     }
     else if (lump->cache != NULL)
     {
@@ -454,7 +493,7 @@ void W_ReleaseLumpNum(lumpindex_t lumpnum)
 
     lump = lumpinfo[lumpnum];
 
-    if (lump->wad_file->mapped != NULL)
+    if (W_LumpIsMapped(lump))
     {
         // Memory-mapped file, so nothing needs to be done here.
     }
@@ -469,6 +508,31 @@ void W_ReleaseLumpName(const char *name)
     W_ReleaseLumpNum(W_GetNumForName(name));
 }
 
+//
+// W_PrefetchLumpNum
+//
+// Hint that a lump will be loaded soon, so that the OS can read it
+// into the page cache in the background.  Does nothing if the lump
+// is already cached.
+//
+
+void W_PrefetchLumpNum(lumpindex_t lumpnum)
+{
+    lumpinfo_t *lump;
+
+    if ((unsigned)lumpnum >= numlumps)
+    {
+        I_Error ("W_PrefetchLumpNum: %i >= numlumps", lumpnum);
+    }
+
+    lump = lumpinfo[lumpnum];
+
+    if (lump->cache == NULL && lump->size > 0)
+    {
+        W_Prefetch(lump->wad_file, lump->position, lump->size);
+    }
+}
+
 #if 0
 
 //
@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include "z_zone.h"
+#include "z_profile.h"
 #include "i_system.h"
 #include "doomtype.h"
 
@@ -39,12 +40,18 @@ struct memblock_s
     void **user;
     memblock_t *prev;
     memblock_t *next;
+    int site;   // from Z_ProfileAlloc, or -1
 };
 
 // Linked list of allocated blocks for each tag type
  
 static memblock_t *allocated_blocks[PU_NUM_TAGS];
 
+// Cached blocks thrown out by ClearCache to make room.
+
+static unsigned int purges;
+static unsigned int purgedbytes;
+
 #ifdef TESTING
 
 static int test_malloced = 0;
@@ -136,6 +143,8 @@ void Z_Init (void)
 {
     memset(allocated_blocks, 0, sizeof(allocated_blocks));
     printf("zone memory: Using native C allocator.\n");
+
+    Z_ProfileInit();
 }
 
 
@@ -161,6 +170,7 @@ void Z_Free (void* ptr)
     }
 
     Z_RemoveBlock(block);
+    Z_ProfileFree(block->site, block->size);
 
     // Free back to system
 
@@ -215,8 +225,11 @@ static boolean ClearCache(int size)
         next_block = block->prev;
 
         Z_RemoveBlock(block);
+        Z_ProfileFree(block->site, block->size);
 
         remaining -= block->size;
+        purges++;
+        purgedbytes += block->size;
 
         if (block->user)
         {
@@ -236,7 +249,7 @@ static boolean ClearCache(int size)
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
 //
 
-void *Z_Malloc(int size, int tag, void *user)
+void *Z_Malloc2(int size, int tag, void *user, const char *file, int line)
 {
     memblock_t *newblock;
     unsigned char *data;
@@ -279,6 +292,7 @@ void *Z_Malloc(int size, int tag, void *user)
     newblock->size = size;
 
     Z_InsertBlock(newblock);
+    newblock->site = Z_ProfileAlloc(file, line, newblock->size);
 
     data = (unsigned char *) newblock;
     result = data + sizeof(memblock_t);
@@ -293,6 +307,19 @@ void *Z_Malloc(int size, int tag, void *user)
 
 
 
+//
+// Z_PoolMalloc
+// The native allocator keeps per-tag block lists already, so pooled
+// objects are just ordinary blocks.
+//
+
+void *Z_PoolMalloc2(int size, int tag, const char *file, int line)
+{
+    return Z_Malloc2(size, tag, NULL, file, line);
+}
+
+
+
 //
 // Z_FreeTags
 //
@@ -318,7 +345,8 @@ void Z_FreeTags(int lowtag, int hightag)
             {
                 *block->user = NULL;
             }
-            
+
+            Z_ProfileFree(block->site, block->size);
             free(block);
 
             // Jump to the next in the chain
@@ -504,3 +532,35 @@ unsigned int Z_ZoneSize(void)
     return 0;
 }
 
+//
+// Z_GetStats
+// The system allocator's free space is unknown, so only the
+// per-tag usage and the cache purges are reported.  No high-water
+// marks are kept; the peaks are just the current usage.
+//
+
+void Z_GetStats(zonestats_t *stats)
+{
+    memblock_t *block;
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    stats->purges = purges;
+    stats->purgedbytes = purgedbytes;
+
+    for (i = 0; i < PU_NUM_TAGS; ++i)
+    {
+        for (block = allocated_blocks[i]; block != NULL; block = block->next)
+        {
+            stats->tagbytes[i] += block->size;
+        }
+
+        stats->tagpeak[i] = stats->tagbytes[i];
+        stats->usedpeak += stats->tagbytes[i];
+    }
+}
+
+void Z_ResetPeak(void)
+{
+}
@@ -0,0 +1,250 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Zone allocation profiling by call site (-zoneprofile), shared by
+// the zone and native allocators.
+//
+// Each allocated block remembers the index of the call site that
+// allocated it, and the totals for each call site are kept in a
+// small open-addressed hash table.  Call sites beyond MAXSITES go
+// unrecorded.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "doomtype.h"
+#include "m_argv.h"
+#include "z_profile.h"
+#include "z_zone.h"
+
+#define MAXSITES 1024
+
+static zonesite_t sites[MAXSITES];
+static boolean profiling;
+static time_t profile_interval;
+static time_t profile_lasttime;
+
+void Z_ProfileInit(void)
+{
+    int p;
+
+    //!
+    // @arg <secs>
+    // @category obscure
+    //
+    // Profile zone memory allocations by call site, and print a summary
+    // of the heap every <secs> seconds. If telemetry is enabled, the
+    // summary is also sent as a telemetry event.
+    //
+
+    p = M_CheckParmWithArgs("-zoneprofile", 1);
+
+    if (p > 0)
+    {
+        profiling = true;
+        profile_interval = atoi(myargv[p + 1]);
+        profile_lasttime = time(NULL);
+    }
+}
+
+int Z_ProfileAlloc(const char *file, int line, int size)
+{
+    zonesite_t *site;
+    unsigned int hash;
+    int i, index;
+
+    if (!profiling)
+    {
+        return -1;
+    }
+
+    hash = (unsigned int) line * 31;
+
+    for (i = 0; file[i] != '\0'; ++i)
+    {
+        hash = hash * 33 + (byte) file[i];
+    }
+
+    for (i = 0; i < MAXSITES; ++i)
+    {
+        index = (hash + i) & (MAXSITES - 1);
+        site = &sites[index];
+
+        if (site->file == NULL)
+        {
+            site->file = file;
+            site->line = line;
+            break;
+        }
+
+        if (site->line == line
+         && (site->file == file || !strcmp(site->file, file)))
+        {
+            break;
+        }
+    }
+
+    if (i == MAXSITES)
+    {
+        return -1;
+    }
+
+    site->allocs++;
+    site->bytes += size;
+
+    if (site->bytes > site->peakbytes)
+    {
+        site->peakbytes = site->bytes;
+    }
+
+    return index;
+}
+
+void Z_ProfileFree(int site, int size)
+{
+    if (site < 0)
+    {
+        return;
+    }
+
+    sites[site].frees++;
+    sites[site].bytes -= size;
+}
+
+static int CompareSites(const void *a, const void *b)
+{
+    const zonesite_t *sa = a, *sb = b;
+
+    if (sa->peakbytes != sb->peakbytes)
+    {
+        return sa->peakbytes < sb->peakbytes ? 1 : -1;
+    }
+
+    return sb->allocs < sa->allocs ? -1 : sb->allocs > sa->allocs;
+}
+
+//
+// Z_GetSites
+// Copy out up to maxsites call sites, largest peak usage first.
+// Returns the number copied, which is zero unless -zoneprofile is used.
+//
+
+int Z_GetSites(zonesite_t *result, int maxsites)
+{
+    zonesite_t sorted[MAXSITES];
+    int count;
+    int i;
+
+    count = 0;
+
+    for (i = 0; i < MAXSITES; ++i)
+    {
+        if (sites[i].file != NULL)
+        {
+            sorted[count++] = sites[i];
+        }
+    }
+
+    qsort(sorted, count, sizeof(zonesite_t), CompareSites);
+
+    if (count > maxsites)
+    {
+        count = maxsites;
+    }
+
+    memcpy(result, sorted, count * sizeof(zonesite_t));
+
+    return count;
+}
+
+//
+// Z_ProfileDue
+// Returns true once every -zoneprofile interval.  Only whole seconds
+// are needed, so this does not depend on the timer code, which the
+// standalone tools that use the zone API do not link.
+//
+
+boolean Z_ProfileDue(void)
+{
+    time_t now;
+
+    if (!profiling)
+    {
+        return false;
+    }
+
+    now = time(NULL);
+
+    if (now - profile_lasttime < profile_interval)
+    {
+        return false;
+    }
+
+    profile_lasttime = now;
+
+    return true;
+}
+
+//
+// Z_DumpProfile
+// Print the allocator's statistics and the busiest call sites.  The
+// native allocator does not know the size of the heap, so it has no
+// fragmentation line.
+//
+
+void Z_DumpProfile(FILE *f)
+{
+    zonestats_t stats;
+    zonesite_t top[16];
+    int count;
+    int i;
+
+    Z_GetStats(&stats);
+
+    if (stats.size != 0)
+    {
+        fprintf(f, "zone: %u bytes, %u free in %u blocks, largest free %u "
+                   "(%u%% fragmented)\n",
+                stats.size, stats.freebytes, stats.freeblocks,
+                stats.largestfree,
+                stats.freebytes == 0 ? 0 :
+                    100 - (unsigned int) ((100ULL * stats.largestfree)
+                                          / stats.freebytes));
+    }
+
+    fprintf(f, "zone: %u purges, %u bytes purged\n",
+            stats.purges, stats.purgedbytes);
+
+    for (i = 0; i < PU_NUM_TAGS; ++i)
+    {
+        if (i == PU_FREE || (stats.tagbytes[i] == 0 && stats.tagpeak[i] == 0))
+        {
+            continue;
+        }
+
+        fprintf(f, "zone: tag %i: %u bytes, %u high-water\n",
+                i, stats.tagbytes[i], stats.tagpeak[i]);
+    }
+
+    count = Z_GetSites(top, arrlen(top));
+
+    for (i = 0; i < count; ++i)
+    {
+        fprintf(f, "zone: %s:%i: %u allocs, %u frees, %u bytes, "
+                   "%u high-water\n",
+                top[i].file, top[i].line, top[i].allocs, top[i].frees,
+                top[i].bytes, top[i].peakbytes);
+    }
+}
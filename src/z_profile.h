@@ -0,0 +1,34 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// Zone allocation profiling by call site (-zoneprofile), shared by
+// the zone and native allocators.  Only the allocators use this
+// header; everything else goes through z_zone.h.
+//
+
+#ifndef Z_PROFILE_H
+#define Z_PROFILE_H
+
+// Check the command line for -zoneprofile.  Called from Z_Init.
+
+void Z_ProfileInit(void);
+
+// Charge size bytes to the call site file:line.  Returns the site's
+// index, which the allocator keeps in the block to pass back to
+// Z_ProfileFree, or -1 if the allocation is not being tracked.
+
+int Z_ProfileAlloc(const char *file, int line, int size);
+
+void Z_ProfileFree(int site, int size);
+
+#endif /* #ifndef Z_PROFILE_H */
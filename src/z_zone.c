@@ -16,12 +16,14 @@
 //	Zone Memory Allocation. Neat.
 //
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "doomtype.h"
 #include "i_system.h"
 #include "m_argv.h"
 
+#include "z_profile.h"
 #include "z_zone.h"
 
 
@@ -42,11 +44,16 @@
 typedef struct memblock_s
 {
     int			size;	// including the header and possibly tiny fragments
+    int			site;	// from Z_ProfileAlloc, or -1
     void**		user;
     int			tag;	// PU_FREE if this is free
     int			id;	// should be ZONEID
     struct memblock_s*	next;
     struct memblock_s*	prev;
+
+    // chain of allocated blocks with the same tag
+    struct memblock_s*	tagnext;
+    struct memblock_s*	tagprev;
 } memblock_t;
 
 
@@ -67,6 +74,109 @@ typedef struct
 static memzone_t *mainzone;
 static boolean zero_on_free;
 static boolean scan_on_free;
+static boolean print_stats;
+
+// Allocated blocks are also chained by tag, so that Z_FreeTags only
+//  has to visit the blocks it frees rather than the whole heap.
+// The bytes held by each tag, and the most ever held since the tag
+//  was last freed, are kept alongside.
+
+static memblock_t *tagblocks[PU_NUM_TAGS];
+static int tagbytes[PU_NUM_TAGS];
+static int tagpeak[PU_NUM_TAGS];
+static int usedbytes;
+static int usedpeak;
+
+// Purgable blocks thrown out by Z_Malloc to make room.
+static unsigned int purges;
+static unsigned int purgedbytes;
+
+
+//
+// SIZE-CLASS POOLS
+//
+// Mobjs and special thinkers are allocated and freed constantly
+//  while a level runs.  Rather than walking the zone with the rover
+//  for each of them, they are carved from larger slab blocks, with
+//  a free list for each size class.
+// A pooled object carries a memblock_t header with POOLID rather
+//  than ZONEID, so Z_Free can tell the two apart.  The slabs are
+//  ordinary zone blocks, so Z_FreeTags releases them whole.
+// Each slab starts with a pointer to the pool's previous slab, so
+//  that the objects still live when the slabs go can be found.
+//
+
+#define POOLID			0x1d4a12
+#define POOL_GRANULARITY	16
+#define POOL_MAXSIZE		512
+#define POOL_NUMCLASSES		(POOL_MAXSIZE / POOL_GRANULARITY)
+#define POOL_SLABSIZE		(32 * 1024)
+#define POOL_SLABHEADER		sizeof(byte *)
+
+typedef struct
+{
+    int		tag;
+    int		size;		// object size, including the header
+
+    // freed objects, linked through their next pointers
+    memblock_t*	freelist;
+
+    // unused space at the end of the current slab
+    byte*	slab;
+    int		slableft;
+
+    // most recent slab first
+    byte*	slabs;
+
+} mempool_t;
+
+// One set of size classes for each of PU_LEVEL and PU_LEVSPEC.
+static mempool_t pools[2][POOL_NUMCLASSES];
+static boolean use_pools;
+
+
+//
+// Z_LinkTag
+// Add an allocated block to the chain for its tag.
+//
+static void Z_LinkTag(memblock_t *block)
+{
+    block->tagprev = NULL;
+    block->tagnext = tagblocks[block->tag];
+
+    if (block->tagnext != NULL)
+        block->tagnext->tagprev = block;
+
+    tagblocks[block->tag] = block;
+
+    tagbytes[block->tag] += block->size;
+
+    if (tagbytes[block->tag] > tagpeak[block->tag])
+        tagpeak[block->tag] = tagbytes[block->tag];
+
+    usedbytes += block->size;
+
+    if (usedbytes > usedpeak)
+        usedpeak = usedbytes;
+}
+
+//
+// Z_UnlinkTag
+// Remove an allocated block from the chain for its tag.
+//
+static void Z_UnlinkTag(memblock_t *block)
+{
+    if (block->tagprev != NULL)
+        block->tagprev->tagnext = block->tagnext;
+    else
+        tagblocks[block->tag] = block->tagnext;
+
+    if (block->tagnext != NULL)
+        block->tagnext->tagprev = block->tagprev;
+
+    tagbytes[block->tag] -= block->size;
+    usedbytes -= block->size;
+}
 
 
 //
@@ -95,6 +205,70 @@ void Z_ClearZone (memzone_t* zone)
 
 
 
+//
+// Z_ProfilePoolFree
+// Objects still live when their level ends are never passed to
+// Z_Free, so with -zoneprofile their call sites are credited here,
+// before the slabs are freed.
+//
+static void Z_ProfilePoolFree(mempool_t *pool)
+{
+    memblock_t*	block;
+    byte*	slab;
+    byte*	p;
+    byte*	end;
+
+    for (slab = pool->slabs; slab != NULL; slab = *(byte **) slab)
+    {
+	// Only the current slab has an unused tail.
+	if (slab == pool->slabs)
+	    end = pool->slab;
+	else
+	    end = slab + POOL_SLABHEADER
+		+ (POOL_SLABSIZE - POOL_SLABHEADER) / pool->size * pool->size;
+
+	for (p = slab + POOL_SLABHEADER; p < end; p += pool->size)
+	{
+	    block = (memblock_t *) p;
+
+	    if (block->id == POOLID)
+		Z_ProfileFree(block->site, block->size);
+	}
+    }
+}
+
+//
+// Z_ClearPools
+// Forget the slabs and free lists of the pools for the given tags.
+// Called when the slabs themselves are about to be freed.
+//
+static void Z_ClearPools(int lowtag, int hightag)
+{
+    mempool_t*	pool;
+    int		tag;
+    int		i;
+
+    for (tag = PU_LEVEL; tag <= PU_LEVSPEC; ++tag)
+    {
+	if (tag < lowtag || tag > hightag)
+	    continue;
+
+	for (i = 0; i < POOL_NUMCLASSES; ++i)
+	{
+	    pool = &pools[tag - PU_LEVEL][i];
+	    Z_ProfilePoolFree(pool);
+	    pool->tag = tag;
+	    pool->size = sizeof(memblock_t) + (i + 1) * POOL_GRANULARITY;
+	    pool->freelist = NULL;
+	    pool->slab = NULL;
+	    pool->slableft = 0;
+	    pool->slabs = NULL;
+	}
+    }
+}
+
+
+
 //
 // Z_Init
 //
@@ -133,6 +307,25 @@ void Z_Init (void)
     // heap is scanned to look for remaining pointers to the freed block.
     //
     scan_on_free = M_ParmExists("-zonescan");
+
+    //!
+    // @category obscure
+    //
+    // Print the high-water mark of each tag's zone usage whenever a
+    // level's memory is freed.
+    //
+
+    print_stats = M_ParmExists("-zonestats");
+
+    Z_ProfileInit();
+
+    // [Deliberately undocumented]
+    // Zone memory debugging flag. If set, mobjs and thinkers are allocated
+    // directly from the zone rather than from the size-class pools.
+    //
+    use_pools = !M_ParmExists("-nozonepool");
+
+    Z_ClearPools(PU_LEVEL, PU_LEVSPEC);
 }
 
 // Scan the zone heap for pointers within the specified range, and warn about
@@ -172,6 +365,39 @@ static void ScanForBlock(void *start, void *end)
     }
 }
 
+//
+// Z_PoolFree
+// Return a pooled object to the free list of its size class.
+//
+static void Z_PoolFree (memblock_t* block)
+{
+    mempool_t*		pool;
+    void*		ptr;
+
+    pool = (mempool_t *) block->user;
+    ptr = (byte *) block + sizeof(memblock_t);
+
+    Z_ProfileFree(block->site, block->size);
+
+    block->tag = PU_FREE;
+    block->user = NULL;
+    block->id = 0;
+
+    if (zero_on_free)
+    {
+        memset(ptr, 0, block->size - sizeof(memblock_t));
+    }
+    if (scan_on_free)
+    {
+        ScanForBlock(ptr,
+                     (byte *) ptr + block->size - sizeof(memblock_t));
+    }
+
+    block->prev = NULL;
+    block->next = pool->freelist;
+    pool->freelist = block;
+}
+
 //
 // Z_Free
 //
@@ -182,9 +408,18 @@ void Z_Free (void* ptr)
 
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 
+    if (block->id == POOLID)
+    {
+        Z_PoolFree(block);
+        return;
+    }
+
     if (block->id != ZONEID)
 	I_Error ("Z_Free: freed a pointer without ZONEID");
 
+    Z_UnlinkTag(block);
+    Z_ProfileFree(block->site, block->size);
+
     if (block->tag != PU_FREE && block->user != NULL)
     {
     	// clear the user's mark
@@ -246,10 +481,12 @@ void Z_Free (void* ptr)
 
 
 void*
-Z_Malloc
+Z_Malloc2
 ( int		size,
   int		tag,
-  void*		user )
+  void*		user,
+  const char*	file,
+  int		line )
 {
     int		extra;
     memblock_t*	start;
@@ -297,6 +534,8 @@ Z_Malloc
             else
             {
                 // free the rover block (adding the size to base)
+                purges++;
+                purgedbytes += rover->size;
 
                 // the rover can be the base block
                 base = base->prev;
@@ -337,6 +576,8 @@ Z_Malloc
 
     base->user = user;
     base->tag = tag;
+    Z_LinkTag(base);
+    base->site = Z_ProfileAlloc(file, line, base->size);
 
     result  = (void *) ((byte *)base + sizeof(memblock_t));
 
@@ -363,23 +604,84 @@ Z_FreeTags
 ( int		lowtag,
   int		hightag )
 {
+    int		tag;
+
+    // The pool slabs are freed below along with everything else.
+    Z_ClearPools(lowtag, hightag);
+
+    for (tag = lowtag; tag <= hightag; ++tag)
+    {
+	if (tag < 0 || tag >= PU_NUM_TAGS || tag == PU_FREE)
+	    continue;
+
+	if (print_stats)
+	    printf ("Z_FreeTags: tag %i: %i bytes in use, "
+		    "%i bytes high-water\n",
+		    tag, tagbytes[tag], tagpeak[tag]);
+
+	// Blocks coalesce the same whatever order they are freed in,
+	// so the zone ends up exactly as a walk of the heap leaves it.
+	while (tagblocks[tag] != NULL)
+	    Z_Free ((byte *)tagblocks[tag] + sizeof(memblock_t));
+
+	tagpeak[tag] = 0;
+    }
+}
+
+
+
+//
+// Z_PoolMalloc
+// Allocate a small object that lives until it is freed or its level
+// ends.  PU_LEVEL and PU_LEVSPEC objects come from the size-class
+// pools; anything else falls back to Z_Malloc.  Pooled objects can
+// be passed to Z_Free, but not to Z_ChangeTag or Z_ChangeUser.
+//
+void *Z_PoolMalloc2(int size, int tag, const char *file, int line)
+{
+    mempool_t*	pool;
     memblock_t*	block;
-    memblock_t*	next;
-	
-    for (block = mainzone->blocklist.next ;
-	 block != &mainzone->blocklist ;
-	 block = next)
+
+    if (!use_pools || size > POOL_MAXSIZE
+     || (tag != PU_LEVEL && tag != PU_LEVSPEC))
     {
-	// get link before freeing
-	next = block->next;
+        return Z_Malloc2(size, tag, NULL, file, line);
+    }
 
-	// free block?
-	if (block->tag == PU_FREE)
-	    continue;
-	
-	if (block->tag >= lowtag && block->tag <= hightag)
-	    Z_Free ( (byte *)block+sizeof(memblock_t));
+    pool = &pools[tag - PU_LEVEL][size <= 0 ? 0 : (size - 1) / POOL_GRANULARITY];
+
+    if (pool->freelist != NULL)
+    {
+        block = pool->freelist;
+        pool->freelist = block->next;
     }
+    else
+    {
+        if (pool->slableft < pool->size)
+        {
+            // The tail of the old slab is too small; start a new one.
+            // With -zoneprofile, the objects in the slab are charged
+            // to their callers, and the slab itself to this line.
+            pool->slab = Z_Malloc(POOL_SLABSIZE, tag, NULL);
+            *(byte **) pool->slab = pool->slabs;
+            pool->slabs = pool->slab;
+            pool->slab += POOL_SLABHEADER;
+            pool->slableft = POOL_SLABSIZE - POOL_SLABHEADER;
+        }
+
+        block = (memblock_t *) pool->slab;
+        pool->slab += pool->size;
+        pool->slableft -= pool->size;
+    }
+
+    block->size = pool->size;
+    block->user = (void **) pool;
+    block->tag = tag;
+    block->id = POOLID;
+    block->site = Z_ProfileAlloc(file, line, block->size);
+    block->next = block->prev = NULL;
+
+    return (byte *) block + sizeof(memblock_t);
 }
 
 
@@ -504,7 +806,9 @@ void Z_ChangeTag2(void *ptr, int tag, const char *file, int line)
         I_Error("%s:%i: Z_ChangeTag: an owner is required "
                 "for purgable blocks", file, line);
 
+    Z_UnlinkTag(block);
     block->tag = tag;
+    Z_LinkTag(block);
 }
 
 void Z_ChangeUser(void *ptr, void **user)
@@ -550,3 +854,51 @@ unsigned int Z_ZoneSize(void)
     return mainzone->size;
 }
 
+
+//
+// Z_GetStats
+// Summarise the state of the heap.
+//
+void Z_GetStats(zonestats_t *stats)
+{
+    memblock_t*		block;
+    unsigned int	size;
+    int			i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    stats->size = mainzone->size;
+    stats->purges = purges;
+    stats->purgedbytes = purgedbytes;
+    stats->usedpeak = usedpeak;
+
+    for (i = 0; i < PU_NUM_TAGS; ++i)
+    {
+        stats->tagbytes[i] = tagbytes[i];
+        stats->tagpeak[i] = tagpeak[i];
+    }
+
+    for (block = mainzone->blocklist.next;
+         block != &mainzone->blocklist;
+         block = block->next)
+    {
+        if (block->tag != PU_FREE)
+            continue;
+
+        size = block->size;
+        stats->freebytes += size;
+        stats->freeblocks++;
+
+        if (size > stats->largestfree)
+            stats->largestfree = size;
+    }
+}
+
+//
+// Z_ResetPeak
+// Start a new high-water mark for Z_GetStats' usedpeak.
+//
+void Z_ResetPeak(void)
+{
+    usedpeak = usedbytes;
+}
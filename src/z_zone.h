@@ -26,6 +26,8 @@
 
 #include <stdio.h>
 
+#include "doomtype.h"
+
 //
 // ZONE MEMORY
 // PU - purge tags.
@@ -50,8 +52,39 @@ enum
 };
         
 
+//
+// Zone statistics, see Z_GetStats.
+//
+typedef struct
+{
+    unsigned int size;          // bytes managed by the allocator
+    unsigned int freebytes;     // bytes in free blocks
+    unsigned int freeblocks;    // number of free blocks
+    unsigned int largestfree;   // largest single free block
+    unsigned int purges;        // purgable blocks evicted to make room
+    unsigned int purgedbytes;
+    unsigned int usedpeak;      // most bytes allocated at once,
+                                // since the last Z_ResetPeak
+    unsigned int tagbytes[PU_NUM_TAGS];
+    unsigned int tagpeak[PU_NUM_TAGS];
+} zonestats_t;
+
+//
+// Allocations attributed to one call site, with -zoneprofile.
+//
+typedef struct
+{
+    const char *file;
+    int line;
+    unsigned int allocs;
+    unsigned int frees;
+    unsigned int bytes;         // bytes currently held
+    unsigned int peakbytes;
+} zonesite_t;
+
 void	Z_Init (void);
-void*	Z_Malloc (int size, int tag, void *ptr);
+void*	Z_Malloc2 (int size, int tag, void *ptr, const char *file, int line);
+void*   Z_PoolMalloc2 (int size, int tag, const char *file, int line);
 void    Z_Free (void *ptr);
 void    Z_FreeTags (int lowtag, int hightag);
 void    Z_DumpHeap (int lowtag, int hightag);
@@ -61,6 +94,11 @@ void    Z_ChangeTag2 (void *ptr, int tag, const char *file, int line);
 void    Z_ChangeUser(void *ptr, void **user);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
+void    Z_GetStats (zonestats_t *stats);
+void    Z_ResetPeak (void);
+int     Z_GetSites (zonesite_t *sites, int maxsites);
+boolean Z_ProfileDue (void);
+void    Z_DumpProfile (FILE *f);
 
 //
 // This is used to get the local FILE:LINE info from CPP
@@ -69,5 +107,11 @@ unsigned int Z_ZoneSize(void);
 #define Z_ChangeTag(p,t)                                       \
     Z_ChangeTag2((p), (t), __FILE__, __LINE__)
 
+#define Z_Malloc(s,t,u)                                        \
+    Z_Malloc2((s), (t), (u), __FILE__, __LINE__)
+
+#define Z_PoolMalloc(s,t)                                      \
+    Z_PoolMalloc2((s), (t), __FILE__, __LINE__)
+
 
 #endif
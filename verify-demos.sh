@@ -0,0 +1,81 @@
+#!/bin/sh
+#
+# Play back demos in parallel and check that they stay in sync, by
+# comparing a hash of the game state at every tic against hashes
+# recorded earlier with a known good build.
+#
+# usage: verify-demos.sh [-j jobs] [-record] doom-binary demo.lmp...
+#
+# The hashes for foo.lmp are kept in foo.hash.  With -record they are
+# (re)written, otherwise each demo is checked against them; for a demo
+# that desyncs, the first tic that differs is reported.  Each demo runs
+# in its own process (with -simbench, so without drawing or sound);
+# by default as many at once as there are CPUs.  Extra engine options,
+# such as -iwad or -file, can be given in $DOOM_ARGS.
+#
+
+usage() {
+	echo "usage: $0 [-j jobs] [-record] doom-binary demo.lmp..." >&2
+	exit 2
+}
+
+# Worker: play one demo and report the result on one line.
+
+if [ "$1" = "--worker" ]; then
+	mode="$2"; doom="$3"; logdir="$4"; demo="$5"
+	hash="${demo%.*}.hash"
+	log="$logdir/$(basename "$demo").log"
+
+	if [ "$mode" = "record" ]; then
+		hashopt="-hashrecord"
+	elif [ -f "$hash" ]; then
+		hashopt="-hashcheck"
+	else
+		echo "MISSING $demo: no $hash (use -record)"
+		exit 1
+	fi
+
+	# $DOOM_ARGS is split on whitespace on purpose.
+	if SDL_VIDEODRIVER=dummy SDL_AUDIODRIVER=dummy \
+	   "$doom" $DOOM_ARGS -simbench /dev/null "$demo" \
+	           $hashopt "$hash" > "$log" 2>&1; then
+		echo "OK $demo"
+		exit 0
+	fi
+
+	reason="$(grep -e 'Desync' -e 'Error' "$log" | head -n 1)"
+	echo "FAIL $demo: ${reason:-exited with an error, see $log}"
+	exit 1
+fi
+
+jobs="$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)"
+mode=check
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-j)      [ $# -ge 2 ] || usage; jobs="$2"; shift 2 ;;
+	-record) mode=record; shift ;;
+	-*)      usage ;;
+	*)       break ;;
+	esac
+done
+
+[ $# -ge 2 ] || usage
+
+doom="$1"
+shift
+
+logdir="$(mktemp -d "${TMPDIR:-/tmp}/verify-demos.XXXXXX")" || exit 1
+results="$logdir/results"
+
+for demo in "$@"; do
+	printf '%s\0' "$demo"
+done | xargs -0 -n 1 -P "$jobs" "$0" --worker "$mode" "$doom" "$logdir" \
+	| tee "$results"
+
+total=$#
+failed=$(grep -c -v '^OK ' "$results")
+
+echo "$((total - failed)) of $total demos OK; logs in $logdir"
+
+[ "$failed" -eq 0 ]